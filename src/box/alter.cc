@@ -951,6 +951,137 @@ ModifyIndex::~ModifyIndex()
 		key_def_delete(new_key_def);
 }
 
+/**
+ * A secondary key of a live memtx space is built online: the
+ * primary key is scanned in batches of INDEX_BUILD_BATCH tuples,
+ * with a yield after each batch, so that a large space doesn't
+ * freeze the instance until it's indexed. The on_replace trigger
+ * is installed before the scan, and applies the changes made
+ * concurrently only to the part of the space which is scanned
+ * already, the rest of them is picked up by the scan itself.
+ * The index becomes visible at commit of the alter, as usual.
+ *
+ * DDL is serialized by schema_lock, so there is at most one
+ * index being built this way at a time. The lock is held across
+ * the yields of the build, so box.snapshot() waits until the
+ * build is over.
+ */
+enum { INDEX_BUILD_BATCH = 4096 };
+
+static struct {
+	/** The index being built, NULL if none. */
+	Index *index;
+	/** The primary key of the space. */
+	Index *pk;
+	/** The last scanned tuple, NULL if none is scanned yet. */
+	struct tuple *last;
+	/** The key of the last scanned tuple to resume the scan. */
+	char *key;
+	size_t key_size;
+} index_build;
+
+/**
+ * Check if a change of a tuple in the old space must be
+ * applied to the new index, i.e. the tuple is scanned already.
+ */
+static bool
+index_build_is_scanned(Index *new_index, struct tuple *tuple)
+{
+	if (index_build.index != new_index)
+		return true; /* The scan is complete. */
+	return index_build.last != NULL &&
+		tuple_compare(tuple, index_build.last,
+			      index_build.pk->key_def) <= 0;
+}
+
+static void
+index_build_end()
+{
+	if (index_build.last != NULL)
+		tuple_unref(index_build.last);
+	index_build.last = NULL;
+	index_build.index = NULL;
+	index_build.pk = NULL;
+}
+
+/**
+ * Let other fibers run in the middle of an online build and
+ * resume the scan after the last scanned tuple.
+ */
+static void
+index_build_yield(struct iterator *it, struct tuple *last)
+{
+	Index *pk = index_build.pk;
+	tuple_ref(last);
+	if (index_build.last != NULL)
+		tuple_unref(index_build.last);
+	index_build.last = last;
+
+	fiber_sleep(0);
+	fiber_testcancel();
+
+	size_t used = region_used(&fiber()->gc);
+	uint32_t key_size;
+	const char *key = tuple_extract_key(last, pk->key_def, &key_size);
+	if (key_size > index_build.key_size) {
+		char *buf = (char *) realloc(index_build.key, key_size);
+		if (buf == NULL) {
+			region_truncate(&fiber()->gc, used);
+			tnt_raise(OutOfMemory, key_size, "realloc",
+				  "index build key");
+		}
+		index_build.key = buf;
+		index_build.key_size = key_size;
+	}
+	memcpy(index_build.key, key, key_size);
+	region_truncate(&fiber()->gc, used);
+	pk->initIterator(it, ITER_GT, index_build.key,
+			 pk->key_def->part_count);
+}
+
+/**
+ * The new index of AddIndex, shared with the triggers of the
+ * transactions which change the space while the index is being
+ * built or the alter is being written to the WAL. These
+ * transactions may end after the index is gone: if the build
+ * fails, the index is deleted right away, while a transaction
+ * which changed the space during a yield of the build may
+ * still be waiting for the WAL. So the triggers reference the
+ * index through this object, which lives until the last of
+ * them is done.
+ */
+struct add_index_ref {
+	/**
+	 * The new index, NULL if it's deleted without being
+	 * committed.
+	 */
+	Index *index;
+	/** AddIndex and the transactions having the triggers. */
+	int refs;
+};
+
+static struct add_index_ref *
+add_index_ref_new(Index *index)
+{
+	struct add_index_ref *ref = (struct add_index_ref *)
+		malloc(sizeof(*ref));
+	if (ref == NULL) {
+		tnt_raise(OutOfMemory, sizeof(*ref), "malloc",
+			  "struct add_index_ref");
+	}
+	ref->index = index;
+	ref->refs = 1;
+	return ref;
+}
+
+static void
+add_index_ref_unref(struct add_index_ref *ref)
+{
+	assert(ref->refs > 0);
+	if (--ref->refs == 0)
+		free(ref);
+}
+
 /**
  * Add to index trigger -- invoked on any change in the old space,
  * while the AddIndex tuple is being written to the WAL. The job
@@ -971,9 +1102,12 @@ public:
 	/** New index key_def. */
 	struct key_def *new_key_def;
 	struct trigger *on_replace;
+	/** The new index, as seen by the triggers of on_replace. */
+	struct add_index_ref *ref;
 	virtual void prepare(struct alter_space *alter);
 	virtual void alter_def(struct alter_space *alter);
 	virtual void alter(struct alter_space *alter);
+	virtual void commit(struct alter_space *alter);
 	virtual ~AddIndex();
 };
 
@@ -992,6 +1126,9 @@ key_def_change_require_index_rebuid(struct key_def *old_key_def,
 			 new_key_def->part_count) != 0) {
 		return true;
 	}
+	if (old_key_def->type == TREE &&
+	    old_key_def->opts.hint != new_key_def->opts.hint)
+		return true;
 	if (old_key_def->type == RTREE) {
 		if (old_key_def->opts.dimension != new_key_def->opts.dimension
 		    || old_key_def->opts.distance != new_key_def->opts.distance)
@@ -1050,15 +1187,33 @@ static void
 on_rollback_in_old_space(struct trigger *trigger, void *event)
 {
 	struct txn *txn = (struct txn *) event;
-	Index *new_index = (Index *) trigger->data;
-	/* Remove the failed tuple from the new index. */
+	struct add_index_ref *ref = (struct add_index_ref *) trigger->data;
+	Index *new_index = ref->index;
+	/* Remove the failed tuple from the new index, if it's alive. */
 	struct txn_stmt *stmt;
 	stailq_foreach_entry(stmt, &txn->stmts, next) {
+		if (new_index == NULL)
+			break;
 		if (stmt->space->def.id != new_index->key_def->space_id)
 			continue;
+		if (! index_build_is_scanned(new_index, stmt->new_tuple ?
+					     stmt->new_tuple :
+					     stmt->old_tuple))
+			continue;
 		new_index->replace(stmt->new_tuple, stmt->old_tuple,
 				   DUP_INSERT);
 	}
+	add_index_ref_unref(ref);
+}
+
+/**
+ * A trigger invoked on commit of a change in old space while
+ * the record about alter is being written to the WAL.
+ */
+static void
+on_commit_in_old_space(struct trigger *trigger, void * /* event */)
+{
+	add_index_ref_unref((struct add_index_ref *) trigger->data);
 }
 
 /**
@@ -1070,20 +1225,32 @@ on_replace_in_old_space(struct trigger *trigger, void *event)
 {
 	struct txn *txn = (struct txn *) event;
 	struct txn_stmt *stmt = txn_current_stmt(txn);
-	Index *new_index = (Index *) trigger->data;
+	struct add_index_ref *ref = (struct add_index_ref *) trigger->data;
+	Index *new_index = ref->index;
+	assert(new_index != NULL);
 	/*
 	 * First set a rollback trigger, then do replace, since
 	 * creating the trigger may fail.
 	 */
 	struct trigger *on_rollback =
-		txn_alter_trigger_new(on_rollback_in_old_space, new_index);
+		txn_alter_trigger_new(on_rollback_in_old_space, ref);
+	struct trigger *on_commit =
+		txn_alter_trigger_new(on_commit_in_old_space, ref);
 	/*
 	 * In a multi-statement transaction the same space
 	 * may be modified many times, but we need only one
 	 * on_rollback trigger.
 	 */
 	txn_init_triggers(txn);
-	trigger_add_unique(&txn->on_rollback, on_rollback);
+	if (trigger_add_unique(&txn->on_rollback, on_rollback)) {
+		/* Either trigger drops the reference. */
+		trigger_add(&txn->on_commit, on_commit);
+		ref->refs++;
+	}
+	/* An unscanned tuple is picked up by the online build. */
+	if (! index_build_is_scanned(new_index, stmt->new_tuple ?
+				     stmt->new_tuple : stmt->old_tuple))
+		return;
 	/* Put the tuple into the new index. */
 	(void) new_index->replace(stmt->old_tuple, stmt->new_tuple,
 				  DUP_INSERT);
@@ -1141,6 +1308,29 @@ AddIndex::alter(struct alter_space *alter)
 	IteratorGuard guard(it);
 	pk->initIterator(it, ITER_ALL, NULL, 0);
 
+	ref = add_index_ref_new(new_index);
+	struct trigger *trigger =
+		txn_alter_trigger_new(on_replace_in_old_space, ref);
+	/*
+	 * Build the key online if the scan can be resumed in
+	 * primary key order after a yield.
+	 */
+	bool is_online = new_key_def->iid != 0 &&
+		pk->key_def->type == TREE &&
+		strcmp(engine->name, "memtx") == 0 &&
+		!space_is_system(alter->old_space);
+	auto build_guard = make_scoped_guard([=] {
+		if (is_online)
+			index_build_end();
+	});
+	if (is_online) {
+		assert(index_build.index == NULL);
+		index_build.index = new_index;
+		index_build.pk = pk;
+		on_replace = trigger;
+		trigger_add(&alter->old_space->on_replace, on_replace);
+	}
+
 	/*
 	 * The index has to be built tuple by tuple, since
 	 * there is no guarantee that all tuples satisfy
@@ -1151,6 +1341,7 @@ AddIndex::alter(struct alter_space *alter)
 	/* Build the new index. */
 	struct tuple *tuple;
 	struct tuple_format *format = alter->new_space->format;
+	uint64_t n_scanned = 0;
 	while ((tuple = it->next(it))) {
 		/*
 		 * Check that the tuple is OK according to the
@@ -1164,10 +1355,27 @@ AddIndex::alter(struct alter_space *alter)
 			new_index->replace(NULL, tuple, DUP_INSERT);
 		assert(old_tuple == NULL); /* Guaranteed by DUP_INSERT. */
 		(void) old_tuple;
+		if (is_online && ++n_scanned % INDEX_BUILD_BATCH == 0)
+			index_build_yield(it, tuple);
+	}
+	if (! is_online) {
+		on_replace = trigger;
+		trigger_add(&alter->old_space->on_replace, on_replace);
+	}
+}
+
+void
+AddIndex::commit(struct alter_space * /* alter */)
+{
+	/*
+	 * The index lives on in the new space, and the triggers
+	 * of the changes written to the WAL after the alter may
+	 * still use it.
+	 */
+	if (ref != NULL) {
+		add_index_ref_unref(ref);
+		ref = NULL;
 	}
-	on_replace = txn_alter_trigger_new(on_replace_in_old_space,
-					   new_index);
-	trigger_add(&alter->old_space->on_replace, on_replace);
 }
 
 AddIndex::~AddIndex()
@@ -1179,6 +1387,11 @@ AddIndex::~AddIndex()
 	 */
 	if (on_replace)
 		trigger_clear(on_replace);
+	/* The index is deleted along with the new space. */
+	if (ref != NULL) {
+		ref->index = NULL;
+		add_index_ref_unref(ref);
+	}
 	if (new_key_def)
 		key_def_delete(new_key_def);
 }
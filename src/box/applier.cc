@@ -47,11 +47,20 @@
 #include "trigger.h"
 #include "xrow_io.h"
 #include "error.h"
+#include "ipc.h"
+#include "txn.h"
 
 /* TODO: add configuration options */
 static const int RECONNECT_DELAY = 1;
 static const int CONNECT_TIMEOUT = 30;
 
+enum {
+	/** How many rows may be read ahead of the applied ones. */
+	APPLIER_QUEUE_MAX = 1024,
+	/** How many rows may be applied in one transaction. */
+	APPLIER_BATCH_MAX = 256,
+};
+
 STRS(applier_state, applier_STATE);
 
 static inline void
@@ -243,6 +252,117 @@ finish:
 	applier_set_state(applier, APPLIER_CONNECTED);
 }
 
+/**
+ * A row read ahead from the master, with a copy of its body,
+ * since the input buffer is reused for the next rows.
+ */
+struct applier_row {
+	struct ipc_msg base;
+	struct xrow_header row;
+	char body[0];
+};
+
+static void
+applier_row_delete(struct ipc_msg *msg)
+{
+	free(msg);
+}
+
+static struct applier_row *
+applier_row_new(const struct xrow_header *row)
+{
+	assert(row->bodycnt <= 1);
+	size_t body_len = row->bodycnt > 0 ? row->body[0].iov_len : 0;
+	struct applier_row *entry = (struct applier_row *)
+		malloc(sizeof(*entry) + body_len);
+	if (entry == NULL) {
+		tnt_raise(OutOfMemory, sizeof(*entry) + body_len,
+			  "malloc", "struct applier_row");
+	}
+	entry->base.destroy = applier_row_delete;
+	entry->row = *row;
+	if (body_len > 0) {
+		memcpy(entry->body, row->body[0].iov_base, body_len);
+		entry->row.body[0].iov_base = entry->body;
+	}
+	return entry;
+}
+
+/**
+ * Read rows from the master into the queue, until the queue
+ * is full. On error, close the queue to wake up the applier.
+ */
+static int
+applier_reader_f(va_list ap)
+{
+	struct applier *applier = va_arg(ap, struct applier *);
+	struct ipc_channel *queue = va_arg(ap, struct ipc_channel *);
+	struct iobuf *iobuf = applier->iobuf;
+	int rc = 0;
+	try {
+		while (true) {
+			struct xrow_header row;
+			coio_read_xrow(&applier->io, &iobuf->in, &row);
+			applier->last_row_time = ev_now(loop());
+			struct applier_row *entry = applier_row_new(&row);
+			iobuf_reset(iobuf);
+			if (ipc_channel_put_msg_timeout(queue, &entry->base,
+						TIMEOUT_INFINITY) != 0) {
+				applier_row_delete(&entry->base);
+				diag_raise();
+			}
+		}
+	} catch (Exception *) {
+		rc = -1;
+	}
+	ipc_channel_close(queue);
+	return rc;
+}
+
+/**
+ * Stop the reader fiber, keeping the error being raised in
+ * the current fiber, since fiber_join() would replace it.
+ */
+static void
+applier_stop_reader(struct fiber *reader)
+{
+	struct diag diag;
+	diag_create(&diag);
+	diag_move(&fiber()->diag, &diag);
+	fiber_cancel(reader);
+	fiber_join(reader);
+	diag_move(&diag, &fiber()->diag);
+}
+
+/**
+ * Apply a batch of rows in one transaction, so that they get
+ * to WAL in a single request. The subscribe stream may commit
+ * the transaction and begin a new one in the middle of the
+ * batch if a row can't join it (e.g. DDL or another engine).
+ */
+static void
+applier_apply_batch(struct applier *applier, struct applier_row **batch,
+		    int count)
+{
+	auto batch_guard = make_scoped_guard([=] {
+		for (int i = 0; i < count; i++)
+			applier_row_delete(&batch[i]->base);
+	});
+	txn_begin(false);
+	auto txn_guard = make_scoped_guard([] { txn_rollback(); });
+	for (int i = 0; i < count; i++) {
+		struct xrow_header *row = &batch[i]->row;
+		applier->lag = ev_now(loop()) - row->tm;
+		if (iproto_type_is_error(row->type))
+			xrow_decode_error(row);  /* error */
+		xstream_write(applier->subscribe_stream, row);
+	}
+	struct txn *txn = in_txn();
+	if (txn != NULL)
+		txn_commit(txn);
+	txn_guard.is_active = false;
+}
+
 /**
  * Execute and process SUBSCRIBE request (follow updates from a master).
  */
@@ -310,19 +430,53 @@ applier_subscribe(struct applier *applier)
 	 */
 
 	/*
-	 * Process a stream of rows from the binary log.
+	 * Process a stream of rows from the binary log. Rows
+	 * are read ahead by a separate fiber, so that the network
+	 * is read while the previous rows are being written to
+	 * WAL.
 	 */
+	struct ipc_channel *queue = ipc_channel_new(APPLIER_QUEUE_MAX);
+	if (queue == NULL)
+		diag_raise();
+	auto queue_guard = make_scoped_guard([=] {
+		/* Destroys all rows left in the queue. */
+		ipc_channel_delete(queue);
+	});
+	struct fiber *reader = fiber_new_xc("applier_reader",
+					    applier_reader_f);
+	fiber_set_joinable(reader, true);
+	fiber_start(reader, applier, queue);
+	auto reader_guard = make_scoped_guard([&] {
+		if (reader != NULL)
+			applier_stop_reader(reader);
+	});
+
+	struct applier_row *batch[APPLIER_BATCH_MAX];
 	while (true) {
-		coio_read_xrow(coio, &iobuf->in, &row);
-		applier->lag = ev_now(loop()) - row.tm;
-		applier->last_row_time = ev_now(loop());
-
-		if (iproto_type_is_error(row.type))
-			xrow_decode_error(&row);  /* error */
-		xstream_write(applier->subscribe_stream, &row);
-
-		iobuf_reset(iobuf);
-		fiber_gc();
+		struct ipc_msg *msg;
+		if (ipc_channel_get_msg_timeout(queue, &msg,
+						TIMEOUT_INFINITY) != 0) {
+			if (reader != NULL && ipc_channel_is_closed(queue)) {
+				/* The reader has failed, raise its error. */
+				fiber_join(reader);
+				reader = NULL;
+				if (diag_is_empty(&fiber()->diag))
+					tnt_raise(ChannelIsClosed);
+			}
+			diag_raise();
+		}
+		/*
+		 * Take the rows which are already there, without
+		 * yielding, so that no other applier can apply
+		 * the same rows while the batch is being built.
+		 */
+		int count = 0;
+		do {
+			batch[count++] = (struct applier_row *) msg;
+		} while (count < APPLIER_BATCH_MAX &&
+			 ! ipc_channel_is_empty(queue) &&
+			 ipc_channel_get_msg_timeout(queue, &msg, 0) == 0);
+		applier_apply_batch(applier, batch, count);
 	}
 }
 
@@ -189,18 +189,24 @@ box_is_ro(void)
 	return is_ro;
 }
 
-static inline void
-apply_row(struct xstream *stream, struct xrow_header *row)
+static inline struct request *
+row_decode_request(struct xrow_header *row)
 {
 	assert(row->bodycnt == 1); /* always 1 for read */
-	(void) stream;
 	struct request *request;
 	request = region_alloc_object_xc(&fiber()->gc, struct request);
 	request_create(request, row->type);
 	request_decode(request, (const char *) row->body[0].iov_base,
 		row->body[0].iov_len);
 	request->header = row;
-	process_rw(request, NULL);
+	return request;
+}
+
+static inline void
+apply_row(struct xstream *stream, struct xrow_header *row)
+{
+	(void) stream;
+	process_rw(row_decode_request(row), NULL);
 }
 
 struct wal_stream {
@@ -261,14 +267,40 @@ apply_initial_join_row(struct xstream *stream, struct xrow_header *row)
 	space->handler->applySnapshotRow(space, request);
 }
 
+/**
+ * Apply a row received from a master. The applier groups rows
+ * in a transaction, so that they are written to WAL in one
+ * request. A row which can't be a part of a multi-statement
+ * transaction - DDL, or a row of another engine - commits the
+ * rows applied so far first.
+ */
 static void
 apply_subscribe_row(struct xstream *stream, struct xrow_header *row)
 {
+	(void) stream;
 	/* Check lsn */
 	int64_t current_lsn = vclock_get(&recovery->vclock, row->server_id);
 	if (row->lsn <= current_lsn)
 		return;
-	apply_row(stream, row);
+	struct request *request = row_decode_request(row);
+	struct txn *txn = in_txn();
+	if (txn != NULL) {
+		struct space *space = space_cache_find(request->space_id);
+		bool is_system = space_is_system(space);
+		if (is_system || (txn->engine != NULL &&
+				  txn->engine != space->handler->engine)) {
+			txn_commit(txn);
+			/* The commit has freed the fiber region. */
+			request = row_decode_request(row);
+			if (is_system) {
+				process_rw(request, NULL);
+				txn_begin(false);
+				return;
+			}
+			txn_begin(false);
+		}
+	}
+	process_rw(request, NULL);
 }
 
 /* {{{ configuration bindings */
@@ -285,6 +317,16 @@ box_check_logger(const char *logger)
 	}
 }
 
+static void
+box_check_logger_overflow(const char *logger_overflow)
+{
+	if (strcmp(logger_overflow, "block") != 0 &&
+	    strcmp(logger_overflow, "drop") != 0) {
+		tnt_raise(ClientError, ER_CFG, "logger_overflow",
+			  "expected 'block' or 'drop'");
+	}
+}
+
 static void
 box_check_uri(const char *source, const char *option_name)
 {
@@ -319,6 +361,18 @@ box_check_wal_mode(const char *mode_name)
 	return (enum wal_mode) mode;
 }
 
+static enum xlog_compression
+box_check_compression(const char *option_name)
+{
+	const char *name = cfg_gets(option_name);
+	assert(name != NULL); /* checked in Lua */
+	int compression = strindex(xlog_compression_STRS, name,
+				   XLOG_COMPRESSION_MAX);
+	if (compression == XLOG_COMPRESSION_MAX)
+		tnt_raise(ClientError, ER_CFG, option_name, name);
+	return (enum xlog_compression) compression;
+}
+
 static void
 box_check_readahead(int readahead)
 {
@@ -341,16 +395,111 @@ box_check_rows_per_wal(int64_t rows_per_wal)
 	return rows_per_wal;
 }
 
+static int64_t
+box_check_wal_max_size(int64_t wal_max_size)
+{
+	if (wal_max_size <= 0) {
+		tnt_raise(ClientError, ER_CFG, "wal_max_size",
+			  "the value must be greater than zero");
+	}
+	return wal_max_size;
+}
+
+static int64_t
+box_check_wal_tail_size(int64_t wal_tail_size)
+{
+	if (wal_tail_size < 0) {
+		tnt_raise(ClientError, ER_CFG, "wal_tail_size",
+			  "the value must not be negative");
+	}
+	return wal_tail_size;
+}
+
+static int
+box_check_index_build_threads(int index_build_threads)
+{
+	enum { INDEX_BUILD_THREADS_MAX = 128 };
+	if (index_build_threads < 1 ||
+	    index_build_threads > INDEX_BUILD_THREADS_MAX) {
+		tnt_raise(ClientError, ER_CFG, "index_build_threads",
+			  "specified value is out of bounds");
+	}
+	return index_build_threads;
+}
+
+static int
+box_check_snap_threads(int snap_threads)
+{
+	enum { SNAP_THREADS_MAX = 128 };
+	if (snap_threads < 1 || snap_threads > SNAP_THREADS_MAX) {
+		tnt_raise(ClientError, ER_CFG, "snap_threads",
+			  "specified value is out of bounds");
+	}
+	return snap_threads;
+}
+
+static double
+box_check_wal_group_commit_delay(double delay)
+{
+	if (delay < 0) {
+		tnt_raise(ClientError, ER_CFG, "wal_group_commit_delay",
+			  "the value must not be negative");
+	}
+	return delay;
+}
+
+static int
+box_check_iproto_call_max(int call_max)
+{
+	if (call_max < 0) {
+		tnt_raise(ClientError, ER_CFG, "iproto_call_max",
+			  "the value must not be negative");
+	}
+	return call_max;
+}
+
+static int
+box_check_iproto_connection_msg_max(int msg_max)
+{
+	if (msg_max < 0) {
+		tnt_raise(ClientError, ER_CFG, "iproto_connection_msg_max",
+			  "the value must not be negative");
+	}
+	return msg_max;
+}
+
+static int
+box_check_iproto_threads(int iproto_threads)
+{
+	if (iproto_threads < 1 || iproto_threads > IPROTO_THREADS_MAX) {
+		tnt_raise(ClientError, ER_CFG, "iproto_threads",
+			  "specified value is out of bounds");
+	}
+	return iproto_threads;
+}
+
 void
 box_check_config()
 {
 	box_check_logger(cfg_gets("logger"));
+	box_check_logger_overflow(cfg_gets("logger_overflow"));
 	box_check_uri(cfg_gets("listen"), "listen");
 	box_check_replication_source();
 	box_check_readahead(cfg_geti("readahead"));
 	box_check_rows_per_wal(cfg_geti64("rows_per_wal"));
+	box_check_wal_max_size(cfg_geti64("wal_max_size"));
+	box_check_wal_tail_size(cfg_geti64("wal_tail_size"));
 	box_check_wal_mode(cfg_gets("wal_mode"));
+	box_check_compression("snap_compression");
+	box_check_compression("wal_compression");
 	box_check_slab_alloc_minimal(cfg_geti64("slab_alloc_minimal"));
+	box_check_index_build_threads(cfg_geti("index_build_threads"));
+	box_check_snap_threads(cfg_geti("snap_threads"));
+	box_check_iproto_threads(cfg_geti("iproto_threads"));
+	box_check_iproto_call_max(cfg_geti("iproto_call_max"));
+	box_check_iproto_connection_msg_max(
+		cfg_geti("iproto_connection_msg_max"));
+	box_check_wal_group_commit_delay(cfg_getd("wal_group_commit_delay"));
 }
 
 /*
@@ -459,6 +608,24 @@ box_set_snap_io_rate_limit(void)
 		memtx->setSnapIoRateLimit(cfg_getd("snap_io_rate_limit"));
 }
 
+extern "C" void
+box_set_snap_threads(void)
+{
+	int snap_threads = box_check_snap_threads(cfg_geti("snap_threads"));
+	MemtxEngine *memtx = (MemtxEngine *) engine_find("memtx");
+	if (memtx)
+		memtx->setSnapThreads(snap_threads);
+}
+
+extern "C" void
+box_set_wal_group_commit_delay(void)
+{
+	double delay = box_check_wal_group_commit_delay(
+		cfg_getd("wal_group_commit_delay"));
+	if (wal != NULL)
+		wal_set_group_commit_delay(wal, delay);
+}
+
 extern "C" void
 box_set_too_long_threshold(void)
 {
@@ -1217,6 +1384,9 @@ engine_init()
 	MemtxEngine *memtx = new MemtxEngine(cfg_gets("snap_dir"),
 					     cfg_geti("panic_on_snap_error"),
 					     cfg_geti("panic_on_wal_error"));
+	memtx->setBuildThreads(cfg_geti("index_build_threads"));
+	memtx->setSnapCompression(box_check_compression("snap_compression"));
+	memtx->setSnapThreads(cfg_geti("snap_threads"));
 	engine_register(memtx);
 
 	SysviewEngine *sysview = new SysviewEngine();
@@ -1381,7 +1551,9 @@ box_init(void)
 		/* Start network */
 		assert(!tt_uuid_is_nil(&SERVER_UUID));
 		port_init();
-		iproto_init();
+		iproto_init(cfg_geti("iproto_threads"),
+			    cfg_geti("iproto_call_max"),
+			    cfg_geti("iproto_connection_msg_max"));
 		box_set_listen();
 		recovery_finalize(recovery, &wal_stream.base);
 
@@ -1398,7 +1570,9 @@ box_init(void)
 		/* Start network */
 		tt_uuid_create(&SERVER_UUID);
 		port_init();
-		iproto_init();
+		iproto_init(cfg_geti("iproto_threads"),
+			    cfg_geti("iproto_call_max"),
+			    cfg_geti("iproto_connection_msg_max"));
 		box_set_listen();
 		box_sync_replication_source();
 
@@ -1408,10 +1582,16 @@ box_init(void)
 	fiber_gc();
 
 	int64_t rows_per_wal = box_check_rows_per_wal(cfg_geti64("rows_per_wal"));
+	int64_t wal_tail_size =
+		box_check_wal_tail_size(cfg_geti64("wal_tail_size"));
 	enum wal_mode wal_mode = box_check_wal_mode(cfg_gets("wal_mode"));
 	if (wal_mode != WAL_NONE) {
 		wal_writer_start(wal_mode, cfg_gets("wal_dir"), &SERVER_UUID,
-				 &recovery->vclock, rows_per_wal);
+				 &recovery->vclock, rows_per_wal,
+				 cfg_geti64("wal_max_size"),
+				 cfg_geti("wal_prealloc"),
+				 wal_tail_size,
+				 box_check_compression("wal_compression"));
 	}
 
 	rmean_cleanup(rmean_box);
@@ -109,9 +109,11 @@ void box_set_replication_source(void);
 void box_set_log_level(void);
 void box_set_io_collect_interval(void);
 void box_set_snap_io_rate_limit(void);
+void box_set_snap_threads(void);
 void box_set_too_long_threshold(void);
 void box_set_readahead(void);
 void box_set_panic_on_wal_error(void);
+void box_set_wal_group_commit_delay(void);
 
 #if defined(__cplusplus)
 }
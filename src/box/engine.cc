@@ -46,6 +46,7 @@ RLIST_HEAD(engines);
 
 Engine::Engine(const char *engine_name)
 	:name(engine_name),
+	 flags(0),
 	 link(RLIST_HEAD_INITIALIZER(link))
 {}
 
@@ -40,6 +40,11 @@ struct relay;
 enum engine_flags {
 	ENGINE_CAN_BE_TEMPORARY = 1,
 	ENGINE_AUTO_CHECK_UPDATE = 2,
+	/**
+	 * Reads never yield, so select results can be encoded
+	 * straight into the output buffer (struct port_obuf).
+	 */
+	ENGINE_CAN_STREAM = 4,
 };
 
 extern struct rlist engines;
@@ -226,6 +231,12 @@ engine_can_be_temporary(uint32_t flags)
 	return flags & ENGINE_CAN_BE_TEMPORARY;
 }
 
+static inline bool
+engine_can_stream(uint32_t flags)
+{
+	return flags & ENGINE_CAN_STREAM;
+}
+
 static inline uint32_t
 engine_id(Handler *space)
 {
@@ -36,6 +36,7 @@
 
 #include <msgpuck.h>
 #include "third_party/base64.h"
+#include "third_party/pmatomic.h"
 
 #include "main.h"
 #include "fiber.h"
@@ -56,13 +57,42 @@
 #include "session.h"
 #include "xrow.h"
 #include "schema.h" /* sc_version */
+#include "space.h"
 #include "cluster.h" /* server_uuid */
 #include "iproto_constants.h"
 #include "rmean.h"
+#include "histogram.h"
+#include "clock.h"
 
 /* The number of iproto messages in flight */
 enum { IPROTO_MSG_MAX = 768 };
 
+/**
+ * The number of messages of a single connection in flight,
+ * box.cfg.iproto_connection_msg_max, 0 if unlimited. A client
+ * which pipelines more requests is not read from until some
+ * of them are complete, so that it can't take all of
+ * IPROTO_MSG_MAX and stall the other connections. Set before
+ * the network threads are started and never changed.
+ */
+static int iproto_connection_msg_max;
+
+/**
+ * The number of CALL and EVAL requests of a network thread
+ * in tx, box.cfg.iproto_call_max, 0 if unlimited. These may
+ * run for long, so the rest of them wait in the network thread
+ * and are passed to tx as the running ones complete, while
+ * short requests go to tx right away. Set before the network
+ * threads are started and never changed.
+ */
+static int iproto_call_max;
+
+/**
+ * Tuples of at least this size are sent to the client right
+ * from the tuple memory, see struct iproto_tuple_ref.
+ */
+enum { IPROTO_TUPLE_REF_MIN = 16384 };
+
 /* {{{ iproto_msg - declaration */
 
 /**
@@ -94,6 +124,16 @@ struct iproto_msg: public cmsg
 	size_t len;
 	/** End of write position in the output buffer */
 	struct obuf_svp write_end;
+	/**
+	 * When the request was parsed, and then when tx started
+	 * to process it, in nanoseconds. Used for latency
+	 * statistics.
+	 */
+	uint64_t start;
+	/** Large tuples of the reply, see struct iproto_tuple_ref. */
+	struct stailq refs;
+	/** The total size of the tuple data sent by reference. */
+	uint32_t refs_size;
 	/**
 	 * Used in "connect" msgs, true if connect trigger failed
 	 * and the connection must be closed.
@@ -101,7 +141,8 @@ struct iproto_msg: public cmsg
 	bool close_connection;
 };
 
-static struct mempool iproto_msg_pool;
+/** Messages are allocated and freed only in their net thread. */
+static __thread struct mempool iproto_msg_pool;
 
 static struct iproto_msg *
 iproto_msg_new(struct iproto_connection *con)
@@ -109,6 +150,8 @@ iproto_msg_new(struct iproto_connection *con)
 	struct iproto_msg *msg =
 		(struct iproto_msg *) mempool_alloc_xc(&iproto_msg_pool);
 	msg->connection = con;
+	stailq_create(&msg->refs);
+	msg->refs_size = 0;
 	return msg;
 }
 
@@ -129,11 +172,65 @@ struct IprotoMsgGuard {
 
 /* }}} */
 
+/* {{{ iproto_tuple_ref - declaration */
+
+/**
+ * A large tuple in a reply, which is written to the socket
+ * from the tuple memory rather than copied to the output
+ * buffer. The tuple is referenced in tx until the network
+ * thread sends it, then the reference travels back to tx to
+ * be released.
+ *
+ * The data is sent at the buffer position saved in the
+ * reference, before the buffer contents which follow it.
+ * The last byte of the tuple is copied to the buffer, so that
+ * an iobuf with a reference pending always has output to
+ * flush, and is neither recycled nor rotated until all of
+ * its tuples are sent.
+ */
+struct iproto_tuple_ref: public cmsg
+{
+	struct tuple *tuple;
+	/** The output buffer position to send the tuple at. */
+	struct obuf_svp svp;
+	/** How much of the tuple data is already sent. */
+	uint32_t sent;
+};
+
+/** References are allocated and freed only in tx. */
+static struct mempool iproto_tuple_ref_pool;
+
+static void
+tx_release_tuple_ref(struct cmsg *m)
+{
+	struct iproto_tuple_ref *ref = (struct iproto_tuple_ref *) m;
+	tuple_unref(ref->tuple);
+	mempool_free(&iproto_tuple_ref_pool, ref);
+}
+
+/** A sent reference goes to tx to be released. */
+static const struct cmsg_hop tuple_ref_route[] = {
+	{ tx_release_tuple_ref, NULL },
+};
+
+/** Release all references of a list, in tx. */
+static void
+tx_release_tuple_refs(struct stailq *refs)
+{
+	while (! stailq_empty(refs)) {
+		tx_release_tuple_ref(stailq_shift_entry(refs, struct cmsg,
+							fifo));
+	}
+}
+
+/* }}} */
+
 /* {{{ iproto connection and requests */
 
 /**
- * A single global queue for all requests in all connections. All
- * requests from all connections are processed concurrently.
+ * A network thread. Each thread has a queue of requests to tx
+ * for all requests in all its connections. All requests from
+ * all connections are processed concurrently.
  * Is also used as a queue for just established connections and to
  * execute disconnect triggers. A few notes about these triggers:
  * - they need to be run in a fiber
@@ -141,15 +238,51 @@ struct IprotoMsgGuard {
  *   failure must lead to connection close.
  * - on_connect trigger must be processed before any other
  *   request on this connection.
+ * Message routes are per thread as well, since they name the
+ * pipe a reply goes back through.
  */
-static struct cpipe tx_pipe;
-static struct cpipe net_pipe;
-static struct cbus net_tx_bus;
+struct iproto_thread {
+	/** Ordinal number of the thread, 0 accepts connections. */
+	int id;
+	struct cord cord;
+	/** Requests from this thread to tx. */
+	struct cpipe tx_pipe;
+	/** Replies from tx to this thread. */
+	struct cpipe net_pipe;
+	struct cbus net_tx_bus;
+	/** Network statistics, also published in rmean_net. */
+	struct rmean *rmean;
+	struct cmsg_hop disconnect_route[2];
+	struct cmsg_hop misc_route[2];
+	struct cmsg_hop select_route[2];
+	struct cmsg_hop process1_route[2];
+	struct cmsg_hop sync_route[2];
+	struct cmsg_hop connect_route[2];
+	const struct cmsg_hop *dml_route[IPROTO_TYPE_STAT_MAX];
+	/**
+	 * Sockets accepted by thread 0 on behalf of this
+	 * thread, protected by accept_mutex.
+	 */
+	struct stailq accept_queue;
+	pthread_mutex_t accept_mutex;
+	/** Wakes the thread up to pick up accept_queue. */
+	struct ev_async accept_async;
+	/** CALL and EVAL requests waiting for their turn. */
+	struct stailq call_queue;
+	/** The number of CALL and EVAL requests in tx. */
+	int n_call;
+};
+
+static struct iproto_thread *iproto_threads;
+int iproto_thread_count;
+/** The thread the current cord serves, NULL in tx. */
+static __thread struct iproto_thread *iproto_thread;
 /* A pointer to the transaction processor cord. */
 struct cord *tx_cord;
 
-struct rmean *rmean_net;
-struct rmean *rmean_net_tx_bus;
+/** Statistics of each network thread and its bus. */
+struct rmean *rmean_net[IPROTO_THREADS_MAX];
+struct rmean *rmean_net_tx_bus[IPROTO_THREADS_MAX];
 
 enum rmean_net_name {
 	IPROTO_SENT,
@@ -159,6 +292,46 @@ enum rmean_net_name {
 
 const char *rmean_net_strings[IPROTO_LAST] = { "SENT", "RECEIVED" };
 
+/**
+ * Request latency, in microseconds, by request type:
+ * - net: from parsing a request to the start of its processing
+ *   in tx, including the wait in the network thread queues,
+ * - tx: processing of a request in tx, including the wait for
+ *   the WAL,
+ * - flush: from the moment a reply is ready in the network
+ *   thread with no other output pending to the moment all
+ *   output of the connection is written.
+ * net and tx are collected in tx, flush in each network
+ * thread.
+ */
+struct histogram *iproto_net_latency[IPROTO_TYPE_STAT_MAX];
+struct histogram *iproto_tx_latency[IPROTO_TYPE_STAT_MAX];
+struct histogram *iproto_flush_latency[IPROTO_THREADS_MAX][IPROTO_TYPE_STAT_MAX];
+
+static void
+iproto_latency_create(struct histogram **hist)
+{
+	static const int64_t buckets[] = {
+		1, 2, 5, 10, 20, 50, 100, 200, 500, 1000, 2000, 5000,
+		10000, 20000, 50000, 100000, 200000, 500000, 1000000,
+		2000000, 5000000, 10000000,
+	};
+	for (int type = 0; type < IPROTO_TYPE_STAT_MAX; type++) {
+		hist[type] = histogram_new(buckets, lengthof(buckets));
+		if (hist[type] == NULL)
+			panic("failed to allocate iproto histograms");
+	}
+}
+
+/** Account the time since @a start of a request of @a type. */
+static inline void
+iproto_latency_collect(struct histogram **hist, uint32_t type,
+		       uint64_t start, uint64_t now)
+{
+	if (type < IPROTO_TYPE_STAT_MAX)
+		histogram_collect(hist[type], (now - start) / 1000);
+}
+
 /** Context of a single client connection. */
 struct iproto_connection
 {
@@ -189,9 +362,27 @@ struct iproto_connection
 	ev_loop *loop;
 	/* Pre-allocated disconnect msg. */
 	struct iproto_msg *disconnect;
+	/** The number of requests in flight. */
+	int n_msg;
+	/**
+	 * Set if input is stopped because there are too many
+	 * requests in flight, see iproto_connection_msg_max.
+	 */
+	bool is_throttled;
+	/**
+	 * Tuples to send from iobuf[0] and iobuf[1], in the
+	 * order of their positions in the output buffer.
+	 */
+	struct stailq refs[2];
+	/**
+	 * When the oldest reply not yet written became ready,
+	 * 0 if there is no output pending, and its type.
+	 */
+	uint64_t flush_start;
+	uint32_t flush_type;
 };
 
-static struct mempool iproto_connection_pool;
+static __thread struct mempool iproto_connection_pool;
 
 /**
  * A connection is idle when the client is gone
@@ -215,6 +406,39 @@ iproto_connection_is_idle(struct iproto_connection *con)
 		ibuf_used(&con->iobuf[1]->in) == 0;
 }
 
+/** Too many requests of the connection are in flight. */
+static inline bool
+iproto_connection_is_throttled(struct iproto_connection *con)
+{
+	return iproto_connection_msg_max > 0 &&
+	       con->n_msg >= iproto_connection_msg_max;
+}
+
+/**
+ * Account a request of the connection put in flight or
+ * complete. The count is mirrored in the session for
+ * box.session.requests(), which is read in tx, while the
+ * connection is owned by the network thread. The session
+ * outlives the requests: it is destroyed only when the
+ * connection is idle.
+ */
+static inline void
+iproto_connection_update_n_msg(struct iproto_connection *con, int delta)
+{
+	assert(con->session != NULL);
+	con->n_msg += delta;
+	pm_atomic_fetch_add_explicit(&con->session->n_requests, delta,
+				     pm_memory_order_relaxed);
+}
+
+/** Get the list of tuples to send from an iobuf. */
+static inline struct stailq *
+iproto_connection_refs(struct iproto_connection *con, struct iobuf *iobuf)
+{
+	assert(iobuf == con->iobuf[0] || iobuf == con->iobuf[1]);
+	return &con->refs[iobuf == con->iobuf[1]];
+}
+
 static void
 iproto_connection_on_input(ev_loop * /* loop */, struct ev_io *watcher,
 			   int /* revents */);
@@ -271,6 +495,9 @@ tx_process_disconnect(struct cmsg *m)
 		session_destroy(con->session);
 		con->session = NULL; /* safety */
 	}
+	/* The tuples which the client didn't read. */
+	tx_release_tuple_refs(&con->refs[0]);
+	tx_release_tuple_refs(&con->refs[1]);
 	/*
 	 * Got to be done in iproto thread since
 	 * that's where the memory is allocated.
@@ -292,48 +519,9 @@ net_finish_disconnect(struct cmsg *m)
 	iproto_msg_delete(msg);
 }
 
-static const struct cmsg_hop disconnect_route[] = {
-	{ tx_process_disconnect, &net_pipe },
-	{ net_finish_disconnect, NULL },
-};
-
-static const struct cmsg_hop misc_route[] = {
-	{ tx_process_misc, &net_pipe },
-	{ net_send_msg, NULL },
-};
-
-static const struct cmsg_hop select_route[] = {
-	{ tx_process_select, &net_pipe },
-	{ net_send_msg, NULL },
-};
-
-static const struct cmsg_hop process1_route[] = {
-	{ tx_process1, &net_pipe },
-	{ net_send_msg, NULL },
-};
-
-static const struct cmsg_hop *dml_route[IPROTO_TYPE_STAT_MAX] = {
-	NULL,                                   /* IPROTO_OK */
-	select_route,                           /* IPROTO_SELECT */
-	process1_route,                         /* IPROTO_INSERT */
-	process1_route,                         /* IPROTO_REPLACE */
-	process1_route,                         /* IPROTO_UPDATE */
-	process1_route,                         /* IPROTO_DELETE */
-	misc_route,                             /* IPROTO_CALL */
-	misc_route,                             /* IPROTO_AUTH */
-	misc_route,                             /* IPROTO_EVAL */
-	process1_route                          /* IPROTO_UPSERT */
-};
-
-static const struct cmsg_hop sync_route[] = {
-	{ tx_process_join_subscribe, &net_pipe },
-	{ net_end_join_subscribe, NULL },
-};
-
 static struct iproto_connection *
-iproto_connection_new(const char *name, int fd)
+iproto_connection_new(int fd)
 {
-	(void) name;
 	struct iproto_connection *con = (struct iproto_connection *)
 		mempool_alloc_xc(&iproto_connection_pool);
 	con->input.data = con->output.data = con;
@@ -344,9 +532,14 @@ iproto_connection_new(const char *name, int fd)
 	con->iobuf[1] = iobuf_new_mt(&tx_cord->slabc);
 	con->parse_size = 0;
 	con->session = NULL;
+	con->n_msg = 0;
+	con->is_throttled = false;
+	stailq_create(&con->refs[0]);
+	stailq_create(&con->refs[1]);
+	con->flush_start = 0;
 	/* It may be very awkward to allocate at close. */
 	con->disconnect = iproto_msg_new(con);
-	cmsg_init(con->disconnect, disconnect_route);
+	cmsg_init(con->disconnect, iproto_thread->disconnect_route);
 	return con;
 }
 
@@ -391,7 +584,7 @@ iproto_connection_close(struct iproto_connection *con)
 		assert(con->disconnect != NULL);
 		struct iproto_msg *msg = con->disconnect;
 		con->disconnect = NULL;
-		cpipe_push(&tx_pipe, msg);
+		cpipe_push(&iproto_thread->tx_pipe, msg);
 	}
 }
 
@@ -481,19 +674,48 @@ iproto_connection_input_iobuf(struct iproto_connection *con)
 	}
 	/*
 	 * Rotate buffers. Not strictly necessary, but
-	 * helps preserve response order.
+	 * helps preserve response order. The idle buffer
+	 * has no tuples to send.
 	 */
+	assert(stailq_empty(&con->refs[1]));
+	stailq_concat(&con->refs[1], &con->refs[0]);
 	con->iobuf[1] = oldbuf;
 	con->iobuf[0] = newbuf;
 	return newbuf;
 }
 
+static inline bool
+iproto_type_is_call(uint32_t type)
+{
+	return type == IPROTO_CALL || type == IPROTO_EVAL;
+}
+
+/**
+ * Pass a request to tx. A CALL or EVAL waits in the thread
+ * if there are too many of them in tx already.
+ */
+static inline void
+iproto_push_msg(struct iproto_msg *msg)
+{
+	if (iproto_type_is_call(msg->header.type)) {
+		if (iproto_call_max > 0 &&
+		    iproto_thread->n_call >= iproto_call_max) {
+			stailq_add_tail_entry(&iproto_thread->call_queue,
+					      msg, fifo);
+			return;
+		}
+		iproto_thread->n_call++;
+	}
+	cpipe_push_input(&iproto_thread->tx_pipe, msg);
+}
+
 /** Enqueue all requests which were read up. */
 static inline void
 iproto_enqueue_batch(struct iproto_connection *con, struct ibuf *in)
 {
 	bool stop_input = false;
-	while (con->parse_size && stop_input == false) {
+	while (con->parse_size && stop_input == false &&
+	       !iproto_connection_is_throttled(con)) {
 		const char *reqstart = in->wpos - con->parse_size;
 		const char *pos = reqstart;
 		/* Read request length. */
@@ -509,6 +731,7 @@ iproto_enqueue_batch(struct iproto_connection *con, struct ibuf *in)
 			break;
 		struct iproto_msg *msg = iproto_msg_new(con);
 		msg->iobuf = con->iobuf[0];
+		msg->start = clock_monotonic64();
 		IprotoMsgGuard guard(msg);
 
 		xrow_header_decode(&msg->header, &pos, reqend);
@@ -542,15 +765,15 @@ iproto_enqueue_batch(struct iproto_connection *con, struct ibuf *in)
 			request_decode(&msg->request,
 				       (const char *) msg->header.body[0].iov_base,
 				       msg->header.body[0].iov_len);
-			assert(msg->header.type < sizeof(dml_route)/sizeof(*dml_route));
-			cmsg_init(msg, dml_route[msg->header.type]);
+			assert(msg->header.type < IPROTO_TYPE_STAT_MAX);
+			cmsg_init(msg, iproto_thread->dml_route[msg->header.type]);
 			break;
 		case IPROTO_PING:
-			cmsg_init(msg, misc_route);
+			cmsg_init(msg, iproto_thread->misc_route);
 			break;
 		case IPROTO_JOIN:
 		case IPROTO_SUBSCRIBE:
-			cmsg_init(msg, sync_route);
+			cmsg_init(msg, iproto_thread->sync_route);
 			stop_input = true;
 			break;
 		default:
@@ -558,7 +781,8 @@ iproto_enqueue_batch(struct iproto_connection *con, struct ibuf *in)
 				  (uint32_t) msg->header.type);
 			break;
 		}
-		cpipe_push_input(&tx_pipe, guard.release());
+		iproto_push_msg(guard.release());
+		iproto_connection_update_n_msg(con, 1);
 		/* Request is parsed */
 		assert(reqend > reqstart);
 		assert(con->parse_size >= (size_t) (reqend - reqstart));
@@ -580,6 +804,10 @@ iproto_enqueue_batch(struct iproto_connection *con, struct ibuf *in)
 		 */
 		ev_io_stop(con->loop, &con->output);
 		ev_io_stop(con->loop, &con->input);
+	} else if (iproto_connection_is_throttled(con)) {
+		/* Resumed by net_send_msg(). */
+		con->is_throttled = true;
+		ev_io_stop(con->loop, &con->input);
 	} else {
 		/*
 		 * Keep reading input, as long as the socket
@@ -587,7 +815,7 @@ iproto_enqueue_batch(struct iproto_connection *con, struct ibuf *in)
 		 */
 		ev_feed_event(con->loop, &con->input, EV_READ);
 	}
-	cpipe_flush_input(&tx_pipe);
+	cpipe_flush_input(&iproto_thread->tx_pipe);
 }
 
 static void
@@ -600,6 +828,12 @@ iproto_connection_on_input(ev_loop *loop, struct ev_io *watcher,
 	assert(fd >= 0);
 
 	try {
+		if (iproto_connection_is_throttled(con)) {
+			/* Resumed by net_send_msg(). */
+			con->is_throttled = true;
+			ev_io_stop(loop, &con->input);
+			return;
+		}
 		/* Ensure we have sufficient space for the next round.  */
 		struct iobuf *iobuf;
 		if ((mempool_count(&iproto_msg_pool) > IPROTO_MSG_MAX &&
@@ -624,7 +858,7 @@ iproto_connection_on_input(ev_loop *loop, struct ev_io *watcher,
 			return;
 		}
 		/* Count statistics */
-		rmean_collect(rmean_net, IPROTO_RECEIVED, nrd);
+		rmean_collect(iproto_thread->rmean, IPROTO_RECEIVED, nrd);
 
 		/* Update the read position and connection state. */
 		in->wpos += nrd;
@@ -657,6 +891,31 @@ iproto_connection_output_iobuf(struct iproto_connection *con)
 	return NULL;
 }
 
+/**
+ * write() a tuple sent by reference to the socket. Pass the
+ * reference to tx when the tuple is sent.
+ */
+static int
+iproto_flush_tuple_ref(struct stailq *refs, struct iproto_connection *con)
+{
+	struct iproto_tuple_ref *ref = (struct iproto_tuple_ref *)
+		stailq_first_entry(refs, struct cmsg, fifo);
+	/* The last byte is in the output buffer. */
+	uint32_t size = ref->tuple->bsize - 1;
+	ssize_t nwr = sio_write(con->output.fd, ref->tuple->data + ref->sent,
+				size - ref->sent);
+	if (nwr <= 0)
+		return -1;
+	rmean_collect(iproto_thread->rmean, IPROTO_SENT, nwr);
+	ref->sent += nwr;
+	if (ref->sent < size)
+		return -1;
+	stailq_shift(refs);
+	cmsg_init(ref, tuple_ref_route);
+	cpipe_push(&iproto_thread->tx_pipe, ref);
+	return 0;
+}
+
 /** writev() to the socket and handle the result. */
 
 static int
@@ -665,6 +924,18 @@ iproto_flush(struct iobuf *iobuf, struct iproto_connection *con)
 	int fd = con->output.fd;
 	struct obuf_svp *begin = &iobuf->out.wpos;
 	struct obuf_svp *end = &iobuf->out.wend;
+	struct stailq *refs = iproto_connection_refs(con, iobuf);
+	bool is_ref = false;
+	if (! stailq_empty(refs)) {
+		struct iproto_tuple_ref *ref = (struct iproto_tuple_ref *)
+			stailq_first_entry(refs, struct cmsg, fifo);
+		if (ref->svp.used == begin->used)
+			return iproto_flush_tuple_ref(refs, con);
+		/* Write the buffer up to the tuple. */
+		assert(ref->svp.used < end->used);
+		end = &ref->svp;
+		is_ref = true;
+	}
 	assert(begin->used < end->used);
 	struct iovec iov[SMALL_OBUF_IOV_MAX+1];
 	struct iovec *src = iobuf->out.iov;
@@ -681,10 +952,13 @@ iproto_flush(struct iobuf *iobuf, struct iproto_connection *con)
 	ssize_t nwr = sio_writev(fd, iov, iovcnt);
 
 	/* Count statistics */
-	rmean_collect(rmean_net, IPROTO_SENT, nwr);
+	rmean_collect(iproto_thread->rmean, IPROTO_SENT, nwr);
 	if (nwr > 0) {
 		if (begin->used + nwr == end->used) {
-			if (ibuf_used(&iobuf->in) == 0) {
+			if (is_ref) {
+				/* The tuple goes next. */
+				*begin = *end;
+			} else if (ibuf_used(&iobuf->in) == 0) {
 				/* Quickly recycle the buffer if it's idle. */
 				assert(end->used == obuf_size(&iobuf->out));
 				/* resets wpos and wpend to zero pos */
@@ -724,6 +998,15 @@ iproto_connection_on_output(ev_loop *loop, struct ev_io *watcher,
 		}
 		if (ev_is_active(&con->output))
 			ev_io_stop(con->loop, &con->output);
+		if (con->flush_start != 0 &&
+		    obuf_used(&con->iobuf[0]->out) == 0 &&
+		    obuf_used(&con->iobuf[1]->out) == 0) {
+			iproto_latency_collect(
+				iproto_flush_latency[iproto_thread->id],
+				con->flush_type, con->flush_start,
+				clock_monotonic64());
+			con->flush_start = 0;
+		}
 	} catch (Exception *e) {
 		e->log();
 		iproto_connection_close(con);
@@ -738,6 +1021,96 @@ tx_fiber_init(struct session *session, uint64_t sync)
 	fiber_set_user(fiber(), &session->credentials);
 }
 
+/** Start processing a request of a connection in a tx fiber. */
+static inline void
+tx_begin_request(struct iproto_msg *msg)
+{
+	struct session *session = msg->connection->session;
+	tx_fiber_init(session, msg->header.sync);
+	uint64_t now = clock_monotonic64();
+	iproto_latency_collect(iproto_net_latency, msg->header.type,
+			       msg->start, now);
+	msg->start = now;
+}
+
+/**
+ * Add a tuple to the reply. A large tuple is referenced
+ * and sent from the tuple memory by the network thread.
+ */
+static int
+tx_add_tuple(struct iproto_msg *msg, struct obuf *out, struct tuple *tuple)
+{
+	if (tuple->bsize < IPROTO_TUPLE_REF_MIN)
+		return tuple_to_obuf(tuple, out);
+	struct iproto_tuple_ref *ref = (struct iproto_tuple_ref *)
+		mempool_alloc(&iproto_tuple_ref_pool);
+	if (ref == NULL) {
+		diag_set(OutOfMemory, sizeof(*ref), "mempool",
+			 "struct iproto_tuple_ref");
+		return -1;
+	}
+	ref->svp = obuf_create_svp(out);
+	if (box_tuple_ref(tuple) != 0) {
+		mempool_free(&iproto_tuple_ref_pool, ref);
+		return -1;
+	}
+	ref->tuple = tuple;
+	ref->sent = 0;
+	stailq_add_tail_entry(&msg->refs, ref, fifo);
+	msg->refs_size += tuple->bsize - 1;
+	if (obuf_dup(out, tuple->data + tuple->bsize - 1, 1) != 1) {
+		diag_set(OutOfMemory, 1, "obuf", "dup");
+		return -1;
+	}
+	return 0;
+}
+
+/** Drop the tuples of a reply which failed. */
+static void
+tx_discard_tuples(struct iproto_msg *msg)
+{
+	tx_release_tuple_refs(&msg->refs);
+	msg->refs_size = 0;
+}
+
+/** A port which adds tuples to a reply with tx_add_tuple(). */
+struct port_iproto {
+	struct port_obuf base;
+	struct iproto_msg *msg;
+};
+
+static void
+port_iproto_add_tuple(struct port *base, struct tuple *tuple)
+{
+	struct port_iproto *port = (struct port_iproto *) base;
+	/* Someone else could have written to the buffer. */
+	assert(fiber()->csw == port->base.csw);
+	if (tx_add_tuple(port->msg, port->base.out, tuple) != 0)
+		diag_raise();
+	++base->size;
+}
+
+static const struct port_vtab port_iproto_vtab = {
+	port_iproto_add_tuple,
+};
+
+static void
+port_iproto_create(struct port_iproto *port, struct iproto_msg *msg)
+{
+	port_obuf_create(&port->base, &msg->iobuf->out);
+	port->base.base.vtab = &port_iproto_vtab;
+	port->msg = msg;
+}
+
+/** Complete a request: the reply is in the output buffer. */
+static inline void
+tx_end_request(struct iproto_msg *msg, struct obuf *out)
+{
+	msg->write_end = obuf_create_svp(out);
+	iproto_latency_collect(iproto_tx_latency, msg->header.type,
+			       msg->start, clock_monotonic64());
+}
+
 static int
 tx_check_schema(uint32_t schema_id)
 {
@@ -755,7 +1128,7 @@ tx_process1(struct cmsg *m)
 	struct iproto_msg *msg = (struct iproto_msg *) m;
 	struct obuf *out = &msg->iobuf->out;
 
-	tx_fiber_init(msg->connection->session, msg->header.sync);
+	tx_begin_request(msg);
 	if (tx_check_schema(msg->header.schema_id))
 		goto error;
 
@@ -764,16 +1137,72 @@ tx_process1(struct cmsg *m)
 	if (box_process1(&msg->request, &tuple) ||
 	    iproto_prepare_select(out, &svp))
 		goto error;
-	if (tuple && tuple_to_obuf(tuple, out))
+	if (tuple && tx_add_tuple(msg, out, tuple))
 		goto error;
-	iproto_reply_select(out, &svp, msg->header.sync,
-			    tuple != 0);
-	msg->write_end = obuf_create_svp(out);
+	iproto_reply_select_extra(out, &svp, msg->header.sync,
+				  tuple != 0, msg->refs_size);
+	tx_end_request(msg, out);
 	return;
 error:
+	tx_discard_tuples(msg);
 	iproto_reply_error(out, diag_last_error(&fiber()->diag),
 			   msg->header.sync);
-	msg->write_end = obuf_create_svp(out);
+	tx_end_request(msg, out);
+}
+
+/**
+ * Encode tuples into the output buffer as the engine produces
+ * them. Used for engines which don't yield on read, so nobody
+ * can write to the same buffer until the reply is complete.
+ */
+static int
+tx_select_stream(struct iproto_msg *msg, struct obuf *out,
+		 struct obuf_svp *svp, uint32_t *count)
+{
+	struct request *req = &msg->request;
+	if (iproto_prepare_select(out, svp) != 0)
+		return -1;
+	struct port_iproto port;
+	port_iproto_create(&port, msg);
+	if (box_select((struct port *) &port,
+		       req->space_id, req->index_id,
+		       req->iterator, req->offset, req->limit,
+		       req->key, req->key_end) != 0) {
+		obuf_rollback_to_svp(out, svp);
+		return -1;
+	}
+	*count = port.base.base.size;
+	return 0;
+}
+
+/**
+ * Collect tuples first and encode them when the select is
+ * complete, since the engine may yield in between.
+ */
+static int
+tx_select_buffered(struct iproto_msg *msg, struct obuf *out,
+		   struct obuf_svp *svp, uint32_t *count)
+{
+	struct request *req = &msg->request;
+	struct port port;
+	port_create(&port);
+	if (box_select((struct port *) &port,
+		       req->space_id, req->index_id,
+		       req->iterator, req->offset, req->limit,
+		       req->key, req->key_end) != 0 ||
+	    iproto_prepare_select(out, svp) != 0) {
+		port_destroy(&port);
+		return -1;
+	}
+	*count = port.size;
+	int rc = 0;
+	for (struct port_entry *e = port.first; e != NULL && rc == 0;
+	     e = e->next)
+		rc = tx_add_tuple(msg, out, e->tuple);
+	port_destroy(&port);
+	if (rc != 0)
+		obuf_rollback_to_svp(out, svp);
+	return rc;
 }
 
 static void
@@ -782,32 +1211,31 @@ tx_process_select(struct cmsg *m)
 	struct iproto_msg *msg = (struct iproto_msg *) m;
 	struct obuf *out = &msg->iobuf->out;
 	struct obuf_svp svp;
-	struct port port;
+	struct space *space;
+	uint32_t count;
 	int rc;
-	struct request *req = &msg->request;
 
-	tx_fiber_init(msg->connection->session, msg->header.sync);
+	tx_begin_request(msg);
 
 	if (tx_check_schema(msg->header.schema_id))
 		goto error;
 
-	port_create(&port);
-	rc = box_select((struct port *) &port,
-			req->space_id, req->index_id,
-			req->iterator, req->offset, req->limit,
-			req->key, req->key_end);
-	if (rc < 0 || iproto_prepare_select(out, &svp) != 0) {
-		port_destroy(&port);
+	space = space_by_id(msg->request.space_id);
+	if (space != NULL && engine_can_stream(space->handler->engine->flags))
+		rc = tx_select_stream(msg, out, &svp, &count);
+	else
+		rc = tx_select_buffered(msg, out, &svp, &count);
+	if (rc != 0)
 		goto error;
-	}
-	port_dump(&port, out);
-	iproto_reply_select(out, &svp, msg->header.sync, port.size);
-	msg->write_end = obuf_create_svp(out);
+	iproto_reply_select_extra(out, &svp, msg->header.sync, count,
+				  msg->refs_size);
+	tx_end_request(msg, out);
 	return;
 error:
+	tx_discard_tuples(msg);
 	iproto_reply_error(out, diag_last_error(&fiber()->diag),
 			   msg->header.sync);
-	msg->write_end = obuf_create_svp(out);
+	tx_end_request(msg, out);
 }
 
 static void
@@ -816,7 +1244,7 @@ tx_process_misc(struct cmsg *m)
 	struct iproto_msg *msg = (struct iproto_msg *) m;
 	struct obuf *out = &msg->iobuf->out;
 
-	tx_fiber_init(msg->connection->session, msg->header.sync);
+	tx_begin_request(msg);
 
 	try {
 		switch (msg->header.type) {
@@ -845,7 +1273,7 @@ tx_process_misc(struct cmsg *m)
 		iproto_reply_error(out, diag_last_error(&fiber()->diag),
 				   msg->header.sync);
 	}
-	msg->write_end = obuf_create_svp(out);
+	tx_end_request(msg, out);
 }
 
 static void
@@ -885,6 +1313,43 @@ tx_process_join_subscribe(struct cmsg *m)
 	}
 }
 
+/**
+ * Let the next CALL or EVAL of the thread into tx, when one
+ * of them is complete.
+ */
+static inline void
+net_end_call(struct iproto_msg *msg)
+{
+	if (! iproto_type_is_call(msg->header.type))
+		return;
+	iproto_thread->n_call--;
+	struct stailq *queue = &iproto_thread->call_queue;
+	if (! stailq_empty(queue)) {
+		iproto_thread->n_call++;
+		cpipe_push(&iproto_thread->tx_pipe,
+			   stailq_shift_entry(queue, struct cmsg, fifo));
+	}
+}
+
+/**
+ * Resume input of a connection stopped by the limit on
+ * requests in flight: parse requests which have been read
+ * already and keep reading the socket.
+ */
+static void
+iproto_connection_resume(struct iproto_connection *con)
+{
+	con->is_throttled = false;
+	try {
+		iproto_enqueue_batch(con, &con->iobuf[0]->in);
+	} catch (Exception *e) {
+		/* Best effort at sending the error message to the client. */
+		iproto_write_error(con->input.fd, e);
+		e->log();
+		iproto_connection_close(con);
+	}
+}
+
 static void
 net_send_msg(struct cmsg *m)
 {
@@ -894,10 +1359,19 @@ net_send_msg(struct cmsg *m)
 	/* Discard request (see iproto_enqueue_batch()) */
 	iobuf->in.rpos += msg->len;
 	iobuf->out.wend = msg->write_end;
+	stailq_concat(iproto_connection_refs(con, iobuf), &msg->refs);
+	iproto_connection_update_n_msg(con, -1);
+	if (con->flush_start == 0) {
+		con->flush_start = clock_monotonic64();
+		con->flush_type = msg->header.type;
+	}
+	net_end_call(msg);
 
 	if (evio_has_fd(&con->output)) {
 		if (! ev_is_active(&con->output))
 			ev_feed_event(con->loop, &con->output, EV_WRITE);
+		if (con->is_throttled)
+			iproto_connection_resume(con);
 	} else if (iproto_connection_is_idle(con)) {
 		iproto_connection_close(con);
 	}
@@ -912,6 +1386,7 @@ net_end_join_subscribe(struct cmsg *m)
 	struct iobuf *iobuf = msg->iobuf;
 
 	iobuf->in.rpos += msg->len;
+	iproto_connection_update_n_msg(con, -1);
 	iproto_msg_delete(msg);
 
 	assert(! ev_is_active(&con->input));
@@ -966,7 +1441,7 @@ net_send_greeting(struct cmsg *m)
 						 obuf_iovcnt(out));
 
 			/* Count statistics */
-			rmean_collect(rmean_net, IPROTO_SENT, nwr);
+			rmean_collect(iproto_thread->rmean, IPROTO_SENT, nwr);
 		} catch (Exception *e) {
 			e->log();
 		}
@@ -987,37 +1462,90 @@ net_send_greeting(struct cmsg *m)
 	iproto_msg_delete(msg);
 }
 
-static const struct cmsg_hop connect_route[] = {
-	{ tx_process_connect, &net_pipe },
-	{ net_send_greeting, NULL },
-};
-
 /** }}} */
 
 /**
  * Create a connection and start input.
  */
 static void
-iproto_on_accept(struct evio_service * /* service */, int fd,
-		 struct sockaddr *addr, socklen_t addrlen)
+iproto_accept(int fd)
 {
-	char name[SERVICE_NAME_MAXLEN];
-	snprintf(name, sizeof(name), "%s/%s", "iobuf",
-		sio_strfaddr(addr, addrlen));
-
-	struct iproto_connection *con;
-
-	con = iproto_connection_new(name, fd);
+	struct iproto_connection *con = iproto_connection_new(fd);
 	/*
 	 * Ignore msg allocation failure - the queue size is
 	 * fixed so there is a limited number of msgs in
 	 * use, all stored in just a few blocks of the memory pool.
 	 */
 	struct iproto_msg *msg = iproto_msg_new(con);
-	cmsg_init(msg, connect_route);
+	cmsg_init(msg, iproto_thread->connect_route);
 	msg->iobuf = con->iobuf[0];
 	msg->close_connection = false;
-	cpipe_push(&tx_pipe, msg);
+	cpipe_push(&iproto_thread->tx_pipe, msg);
+}
+
+/** A socket handed over to another network thread. */
+struct iproto_accepted_fd {
+	struct stailq_entry in_queue;
+	int fd;
+};
+
+/**
+ * Pick up the sockets accepted for this thread by the
+ * listening thread.
+ */
+static void
+iproto_on_accept_async(ev_loop * /* loop */, struct ev_async *watcher,
+		       int /* revents */)
+{
+	struct iproto_thread *thread = (struct iproto_thread *) watcher->data;
+	struct stailq queue;
+	stailq_create(&queue);
+	tt_pthread_mutex_lock(&thread->accept_mutex);
+	stailq_concat(&queue, &thread->accept_queue);
+	tt_pthread_mutex_unlock(&thread->accept_mutex);
+
+	while (! stailq_empty(&queue)) {
+		struct iproto_accepted_fd *accepted =
+			stailq_shift_entry(&queue, struct iproto_accepted_fd,
+					   in_queue);
+		int fd = accepted->fd;
+		free(accepted);
+		try {
+			iproto_accept(fd);
+		} catch (Exception *e) {
+			e->log();
+			close(fd);
+		}
+	}
+}
+
+/**
+ * Spread accepted connections over the network threads
+ * round-robin. Runs in thread 0, which owns the listening
+ * socket.
+ */
+static void
+iproto_on_accept(struct evio_service * /* service */, int fd,
+		 struct sockaddr * /* addr */, socklen_t /* addrlen */)
+{
+	static int next_thread = 0;
+	struct iproto_thread *thread = &iproto_threads[next_thread];
+	next_thread = (next_thread + 1) % iproto_thread_count;
+	if (thread == iproto_thread) {
+		iproto_accept(fd);
+		return;
+	}
+	struct iproto_accepted_fd *accepted = (struct iproto_accepted_fd *)
+		malloc(sizeof(*accepted));
+	if (accepted == NULL) {
+		tnt_raise(OutOfMemory, sizeof(*accepted),
+			  "malloc", "struct iproto_accepted_fd");
+	}
+	accepted->fd = fd;
+	tt_pthread_mutex_lock(&thread->accept_mutex);
+	stailq_add_tail_entry(&thread->accept_queue, accepted, in_queue);
+	tt_pthread_mutex_unlock(&thread->accept_mutex);
+	ev_async_send(thread->cord.loop, &thread->accept_async);
 }
 
 static struct evio_service binary; /* iproto binary listener */
@@ -1027,8 +1555,9 @@ static struct evio_service binary; /* iproto binary listener */
  * begin serving the message bus.
  */
 static int
-net_cord_f(va_list /* ap */)
+net_cord_f(va_list ap)
 {
+	iproto_thread = (struct iproto_thread *) va_arg(ap, void *);
 	/* Got to be called in every thread using iobuf */
 	iobuf_init();
 	mempool_create(&iproto_msg_pool, &cord()->slabc,
@@ -1036,50 +1565,126 @@ net_cord_f(va_list /* ap */)
 	mempool_create(&iproto_connection_pool, &cord()->slabc,
 		       sizeof(struct iproto_connection));
 
-	evio_service_init(loop(), &binary, "binary",
-			  iproto_on_accept, NULL);
-
+	if (iproto_thread->id == 0) {
+		evio_service_init(loop(), &binary, "binary",
+				  iproto_on_accept, NULL);
+	}
+	ev_async_start(loop(), &iproto_thread->accept_async);
 
 	/* Init statistics counter */
-	rmean_net = rmean_new(rmean_net_strings, IPROTO_LAST);
+	iproto_thread->rmean = rmean_new(rmean_net_strings, IPROTO_LAST);
 
-	if (rmean_net == NULL) {
+	if (iproto_thread->rmean == NULL) {
 		tnt_raise(OutOfMemory, sizeof(struct rmean),
 			  "rmean", "struct rmean");
 	}
+	rmean_net[iproto_thread->id] = iproto_thread->rmean;
 
-	cbus_join(&net_tx_bus, &net_pipe);
+	cbus_join(&iproto_thread->net_tx_bus, &iproto_thread->net_pipe);
 	/*
 	 * Nothing to do in the fiber so far, the service
 	 * will take care of creating events for incoming
 	 * connections.
 	 */
 	fiber_yield();
-	if (evio_service_is_active(&binary))
+	if (iproto_thread->id == 0 && evio_service_is_active(&binary))
 		evio_service_stop(&binary);
+	ev_async_stop(loop(), &iproto_thread->accept_async);
 
-	rmean_delete(rmean_net);
+	rmean_net[iproto_thread->id] = NULL;
+	rmean_delete(iproto_thread->rmean);
 	return 0;
 }
 
-/** Initialize the iproto subsystem and start network io thread */
-void
-iproto_init()
+static void
+iproto_route_init(struct cmsg_hop *route, cmsg_f tx_f,
+		  struct cpipe *net_pipe, cmsg_f net_f)
 {
-	tx_cord = cord();
-
-	cbus_create(&net_tx_bus);
-	rmean_net_tx_bus = net_tx_bus.stats;
-	cpipe_create(&tx_pipe);
-	cpipe_set_max_input(&tx_pipe, IPROTO_MSG_MAX/2);
-	cpipe_create(&net_pipe);
-	cpipe_set_max_input(&net_pipe, IPROTO_MSG_MAX/2);
+	route[0].f = tx_f;
+	route[0].pipe = net_pipe;
+	route[1].f = net_f;
+	route[1].pipe = NULL;
+}
 
-	static struct cord net_cord;
-	if (cord_costart(&net_cord, "iproto", net_cord_f, NULL))
-		panic("failed to initialize iproto thread");
+static void
+iproto_thread_init(struct iproto_thread *thread, int id)
+{
+	thread->id = id;
+	cbus_create(&thread->net_tx_bus);
+	rmean_net_tx_bus[id] = thread->net_tx_bus.stats;
+	cpipe_create(&thread->tx_pipe);
+	cpipe_set_max_input(&thread->tx_pipe, IPROTO_MSG_MAX/2);
+	cpipe_create(&thread->net_pipe);
+	cpipe_set_max_input(&thread->net_pipe, IPROTO_MSG_MAX/2);
+
+	struct cpipe *net_pipe = &thread->net_pipe;
+	iproto_route_init(thread->disconnect_route, tx_process_disconnect,
+			  net_pipe, net_finish_disconnect);
+	iproto_route_init(thread->misc_route, tx_process_misc,
+			  net_pipe, net_send_msg);
+	iproto_route_init(thread->select_route, tx_process_select,
+			  net_pipe, net_send_msg);
+	iproto_route_init(thread->process1_route, tx_process1,
+			  net_pipe, net_send_msg);
+	iproto_route_init(thread->sync_route, tx_process_join_subscribe,
+			  net_pipe, net_end_join_subscribe);
+	iproto_route_init(thread->connect_route, tx_process_connect,
+			  net_pipe, net_send_greeting);
+
+	const struct cmsg_hop **dml_route = thread->dml_route;
+	dml_route[IPROTO_OK] = NULL;
+	dml_route[IPROTO_SELECT] = thread->select_route;
+	dml_route[IPROTO_INSERT] = thread->process1_route;
+	dml_route[IPROTO_REPLACE] = thread->process1_route;
+	dml_route[IPROTO_UPDATE] = thread->process1_route;
+	dml_route[IPROTO_DELETE] = thread->process1_route;
+	dml_route[IPROTO_CALL] = thread->misc_route;
+	dml_route[IPROTO_AUTH] = thread->misc_route;
+	dml_route[IPROTO_EVAL] = thread->misc_route;
+	dml_route[IPROTO_UPSERT] = thread->process1_route;
+
+	stailq_create(&thread->call_queue);
+	thread->n_call = 0;
+	iproto_latency_create(iproto_flush_latency[id]);
+	stailq_create(&thread->accept_queue);
+	tt_pthread_mutex_init(&thread->accept_mutex, NULL);
+	ev_async_init(&thread->accept_async, iproto_on_accept_async);
+	thread->accept_async.data = thread;
+}
 
-	cbus_join(&net_tx_bus, &tx_pipe);
+/** Initialize the iproto subsystem and start network io threads */
+void
+iproto_init(int thread_count, int call_max, int connection_msg_max)
+{
+	assert(thread_count > 0 && thread_count <= IPROTO_THREADS_MAX);
+	assert(call_max >= 0 && connection_msg_max >= 0);
+	tx_cord = cord();
+	iproto_call_max = call_max;
+	iproto_connection_msg_max = connection_msg_max;
+	mempool_create(&iproto_tuple_ref_pool, &cord()->slabc,
+		       sizeof(struct iproto_tuple_ref));
+	iproto_latency_create(iproto_net_latency);
+	iproto_latency_create(iproto_tx_latency);
+
+	iproto_threads = (struct iproto_thread *)
+		calloc(thread_count, sizeof(*iproto_threads));
+	if (iproto_threads == NULL)
+		panic("failed to allocate iproto threads");
+	iproto_thread_count = thread_count;
+
+	for (int i = 0; i < thread_count; i++) {
+		struct iproto_thread *thread = &iproto_threads[i];
+		iproto_thread_init(thread, i);
+		char name[FIBER_NAME_MAX];
+		if (i == 0)
+			snprintf(name, sizeof(name), "iproto");
+		else
+			snprintf(name, sizeof(name), "iproto%d", i);
+		if (cord_costart(&thread->cord, name, net_cord_f, thread))
+			panic("failed to initialize iproto thread");
+
+		cbus_join(&thread->net_tx_bus, &thread->tx_pipe);
+	}
 }
 
 /**
@@ -1113,7 +1718,7 @@ struct iproto_set_listen_msg: public cmsg
 static void
 iproto_on_bind(void *arg)
 {
-	cpipe_push(&tx_pipe, (struct cmsg *) arg);
+	cpipe_push(&iproto_thread->tx_pipe, (struct cmsg *) arg);
 }
 
 static void
@@ -1165,7 +1770,7 @@ iproto_set_listen(const char *uri)
 	static struct iproto_set_listen_msg msg;
 	iproto_set_listen_msg_init(&msg, uri);
 
-	cpipe_push(&net_pipe, &msg);
+	cpipe_push(&iproto_threads[0].net_pipe, &msg);
 	/** Wait for the end of bind. */
 	fiber_yield();
 	if (! diag_is_empty(&msg.diag)) {
@@ -30,8 +30,18 @@
  * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
  * SUCH DAMAGE.
  */
+enum { IPROTO_THREADS_MAX = 64 };
+
+/**
+ * Start @a thread_count network threads. Thread 0 listens
+ * and hands accepted connections to all threads round-robin.
+ * At most @a call_max CALL and EVAL requests of a thread are
+ * passed to tx at once, 0 for no limit. A connection with
+ * @a connection_msg_max requests in flight isn't read from
+ * until some of them complete, 0 for no limit.
+ */
 void
-iproto_init();
+iproto_init(int thread_count, int call_max, int connection_msg_max);
 
 void
 iproto_set_listen(const char *uri);
@@ -168,7 +168,14 @@ void
 iproto_reply_select(struct obuf *buf, struct obuf_svp *svp, uint64_t sync,
 		    uint32_t count)
 {
-	uint32_t len = obuf_size(buf) - svp->used - 5;
+	iproto_reply_select_extra(buf, svp, sync, count, 0);
+}
+
+void
+iproto_reply_select_extra(struct obuf *buf, struct obuf_svp *svp,
+			  uint64_t sync, uint32_t count, uint32_t extra)
+{
+	uint32_t len = obuf_size(buf) - svp->used - 5 + extra;
 
 	struct iproto_header_bin header = iproto_header_bin;
 	header.v_len = mp_bswap_u32(len);
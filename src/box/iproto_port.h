@@ -49,6 +49,14 @@ iproto_prepare_select(struct obuf *buf, struct obuf_svp *svp);
 void
 iproto_reply_select(struct obuf *buf, struct obuf_svp *svp, uint64_t sync,
 		    uint32_t count);
+
+/**
+ * Same as iproto_reply_select(), but for a reply which also
+ * has @a extra bytes of data sent outside the buffer.
+ */
+void
+iproto_reply_select_extra(struct obuf *buf, struct obuf_svp *svp,
+			  uint64_t sync, uint32_t count, uint32_t extra);
 #if defined(__cplusplus)
 } /*  extern "C" */
 
@@ -74,6 +74,7 @@ const uint32_t key_mp_type[] = {
 
 const struct key_opts key_opts_default = {
 	/* .unique              = */ true,
+	/* .hint                = */ false,
 	/* .dimension           = */ 2,
 	/* .distancebuf         = */ { '\0' },
 	/* .distance            = */ RTREE_INDEX_DISTANCE_TYPE_EUCLID,
@@ -87,6 +88,7 @@ const struct key_opts key_opts_default = {
 
 const struct opt_def key_opts_reg[] = {
 	OPT_DEF("unique", MP_BOOL, struct key_opts, is_unique),
+	OPT_DEF("hint", MP_BOOL, struct key_opts, hint),
 	OPT_DEF("dimension", MP_UINT, struct key_opts, dimension),
 	OPT_DEF("distance", MP_STR, struct key_opts, distancebuf),
 	OPT_DEF("path", MP_STR, struct key_opts, path),
@@ -153,6 +153,12 @@ struct key_opts {
 	 * index
 	 */
 	bool is_unique;
+	/**
+	 * TREE index: store an order-preserving prefix of the
+	 * first key part next to each tuple pointer, so that most
+	 * comparisons don't have to look into the tuple.
+	 */
+	bool hint;
 	/**
 	 * RTREE index dimension.
 	 */
@@ -181,6 +187,8 @@ key_opts_cmp(const struct key_opts *o1, const struct key_opts *o2)
 {
 	if (o1->is_unique != o2->is_unique)
 		return o1->is_unique < o2->is_unique ? -1 : 1;
+	if (o1->hint != o2->hint)
+		return o1->hint < o2->hint ? -1 : 1;
 	if (o1->dimension != o2->dimension)
 		return o1->dimension < o2->dimension ? -1 : 1;
 	if (o1->distance != o2->distance)
@@ -141,6 +141,28 @@ lbox_cfg_set_snap_io_rate_limit(struct lua_State *L)
 	return 0;
 }
 
+static int
+lbox_cfg_set_snap_threads(struct lua_State *L)
+{
+	try {
+		box_set_snap_threads();
+	} catch (Exception *) {
+		lbox_error(L);
+	}
+	return 0;
+}
+
+static int
+lbox_cfg_set_wal_group_commit_delay(struct lua_State *L)
+{
+	try {
+		box_set_wal_group_commit_delay();
+	} catch (Exception *) {
+		lbox_error(L);
+	}
+	return 0;
+}
+
 static int
 lbox_cfg_set_read_only(struct lua_State *L)
 {
@@ -165,7 +187,9 @@ box_lua_cfg_init(struct lua_State *L)
 		{"cfg_set_io_collect_interval", lbox_cfg_set_io_collect_interval},
 		{"cfg_set_too_long_threshold", lbox_cfg_set_too_long_threshold},
 		{"cfg_set_snap_io_rate_limit", lbox_cfg_set_snap_io_rate_limit},
+		{"cfg_set_snap_threads", lbox_cfg_set_snap_threads},
 		{"cfg_set_read_only", lbox_cfg_set_read_only},
+		{"cfg_set_wal_group_commit_delay", lbox_cfg_set_wal_group_commit_delay},
 		{NULL, NULL}
 	};
 
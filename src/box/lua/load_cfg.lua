@@ -7,8 +7,11 @@ local private = require('box.internal')
 -- see default_cfg below
 local default_vinyl_cfg = {
     memory_limit      = 1.0, -- 1G
+    page_cache        = 0.125, -- 128M
     threads           = 5,
+    read_threads      = 4,
     compact_wm        = 2,
+    cursor_batch      = 64,
     branch_prio       = 2,
     branch_age        = 0,
     branch_age_period = 0,
@@ -18,6 +21,9 @@ local default_vinyl_cfg = {
 -- all available options
 local default_cfg = {
     listen              = nil,
+    iproto_threads      = 1,
+    iproto_call_max     = 0,
+    iproto_connection_msg_max = 0,
     slab_alloc_arena    = 1.0,
     slab_alloc_minimal  = 16,
     slab_alloc_maximal  = 1024 * 1024,
@@ -29,13 +35,24 @@ local default_cfg = {
     vinyl              = default_vinyl_cfg,
     logger              = nil,
     logger_nonblock     = true,
+    logger_async        = false,
+    logger_overflow     = "block",
     log_level           = 5,
     io_collect_interval = nil,
     readahead           = 16320,
     snap_io_rate_limit  = nil, -- no limit
+    snap_compression    = "none",
+    snap_threads        = 1,
+    index_build_threads = 4,
     too_long_threshold  = 0.5,
     wal_mode            = "write",
     rows_per_wal        = 500000,
+    wal_max_size        = 256 * 1024 * 1024,
+    wal_prealloc        = false,
+    wal_recycle         = false,
+    wal_tail_size       = 16 * 1024 * 1024,
+    wal_compression     = "none",
+    wal_group_commit_delay = 0,
     wal_dir_rescan_delay= 2,
     panic_on_snap_error = true,
     panic_on_wal_error  = true,
@@ -55,8 +72,11 @@ local default_cfg = {
 -- see template_cfg below
 local vinyl_template_cfg = {
     memory_limit      = 'number',
+    page_cache        = 'number',
     threads           = 'number',
+    read_threads      = 'number',
     compact_wm        = 'number',
+    cursor_batch      = 'number',
     branch_prio       = 'number',
     branch_age        = 'number',
     branch_age_period = 'number',
@@ -67,6 +87,9 @@ local vinyl_template_cfg = {
 -- could be comma separated lua types or 'any' if any type is allowed
 local template_cfg = {
     listen              = 'string, number',
+    iproto_threads      = 'number',
+    iproto_call_max     = 'number',
+    iproto_connection_msg_max = 'number',
     slab_alloc_arena    = 'number',
     slab_alloc_minimal  = 'number',
     slab_alloc_maximal  = 'number',
@@ -78,13 +101,24 @@ local template_cfg = {
     vinyl              = vinyl_template_cfg,
     logger              = 'string',
     logger_nonblock     = 'boolean',
+    logger_async        = 'boolean',
+    logger_overflow     = 'string',
     log_level           = 'number',
     io_collect_interval = 'number',
     readahead           = 'number',
     snap_io_rate_limit  = 'number',
+    snap_compression    = 'string',
+    snap_threads        = 'number',
+    index_build_threads = 'number',
     too_long_threshold  = 'number',
     wal_mode            = 'string',
     rows_per_wal        = 'number',
+    wal_max_size        = 'number',
+    wal_prealloc        = 'boolean',
+    wal_recycle         = 'boolean',
+    wal_tail_size       = 'number',
+    wal_compression     = 'string',
+    wal_group_commit_delay = 'number',
     wal_dir_rescan_delay= 'number',
     panic_on_snap_error = 'boolean',
     panic_on_wal_error  = 'boolean',
@@ -121,6 +155,8 @@ local dynamic_cfg = {
     readahead               = private.cfg_set_readahead,
     too_long_threshold      = private.cfg_set_too_long_threshold,
     snap_io_rate_limit      = private.cfg_set_snap_io_rate_limit,
+    snap_threads            = private.cfg_set_snap_threads,
+    wal_group_commit_delay  = private.cfg_set_wal_group_commit_delay,
     panic_on_wal_error      = function() end,
     read_only               = private.cfg_set_read_only,
     -- snapshot_daemon
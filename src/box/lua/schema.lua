@@ -64,7 +64,10 @@ ffi.cdef[[
         struct tuple *tuple;
     };
 
+    struct port_vtab;
+
     struct port {
+        const struct port_vtab *vtab;
         size_t size;
         struct port_entry *first;
         struct port_entry *last;
@@ -389,7 +392,8 @@ box.schema.index.create = function(space_id, name, options)
         id = 'number',
         if_not_exists = 'boolean',
         dimension = 'number',
-        distance = 'string'
+        distance = 'string',
+        hint = 'boolean'
     }
     check_param_table(options, options_template, true)
     local options_defaults = {
@@ -437,7 +441,8 @@ box.schema.index.create = function(space_id, name, options)
         table.insert(parts, {options.parts[i], options.parts[i + 1]})
     end
     local key_opts = { dimension = options.dimension,
-        unique = options.unique, distance = options.distance }
+        unique = options.unique, distance = options.distance,
+        hint = options.hint }
     for k, v in pairs(options) do
         if options_template[k] == nil then
             key_opts[k] = v
@@ -486,6 +491,7 @@ box.schema.index.alter = function(space_id, index_id, options)
         unique = 'boolean',
         dimension = 'number',
         distance = 'string',
+        hint = 'boolean',
     }
     check_param_table(options, options_template)
 
@@ -555,6 +561,9 @@ box.schema.index.alter = function(space_id, index_id, options)
     if options.distance ~= nil then
         key_opts.distance = options.distance
     end
+    if options.hint ~= nil then
+        key_opts.hint = options.hint
+    end
     if options.parts ~= nil then
         check_index_parts(options.parts)
         options.parts = update_index_parts(options.parts)
@@ -36,6 +36,7 @@
 #include <lauxlib.h>
 #include <lualib.h>
 #include <sio.h>
+#include <pmatomic.h>
 
 #include "box/session.h"
 #include "box/user.h"
@@ -167,6 +168,28 @@ lbox_session_fd(struct lua_State *L)
 }
 
 
+/**
+ * The number of requests of a session being processed,
+ * e.g. to find a connection which floods the server.
+ */
+static int
+lbox_session_requests(struct lua_State *L)
+{
+	if (lua_gettop(L) > 1)
+		luaL_error(L, "session.requests(sid): bad arguments");
+
+	struct session *session;
+	if (lua_gettop(L) == 1)
+		session = session_find(luaL_checkint(L, 1));
+	else
+		session = current_session();
+	if (session == NULL)
+		luaL_error(L, "session.requests(): session does not exist");
+	lua_pushinteger(L, pm_atomic_load_explicit(&session->n_requests,
+						   pm_memory_order_relaxed));
+	return 1;
+}
+
 /**
  * Pretty print peer name.
  */
@@ -281,6 +304,7 @@ box_lua_session_init(struct lua_State *L)
 		{"fd", lbox_session_fd},
 		{"exists", lbox_session_exists},
 		{"peer", lbox_session_peer},
+		{"requests", lbox_session_requests},
 		{"on_connect", lbox_session_on_connect},
 		{"on_disconnect", lbox_session_on_disconnect},
 		{"on_auth", lbox_session_on_auth},
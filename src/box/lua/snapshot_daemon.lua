@@ -140,9 +140,21 @@ do
 
             local rm = xlogs[1]
             table.remove(xlogs, 1)
-            log.info("removing old xlog %s", rm)
+            local ok
+            if box.cfg.wal_prealloc and box.cfg.wal_recycle then
+                -- the WAL writer takes the file for its next
+                -- spare file instead of allocating a new one;
+                -- it zeroes the file in place, so it creates a
+                -- new one if a relay still has this one open
+                log.info("recycling old xlog %s", rm)
+                ok = fio.rename(rm, fio.pathjoin(box.cfg.wal_dir,
+                                                 'xlog.recycle'))
+            else
+                log.info("removing old xlog %s", rm)
+                ok = fio.unlink(rm)
+            end
 
-            if not fio.unlink(rm) then
+            if not ok then
                 log.error("error while removing %s: %s",
                           rm, errno.strerror())
                 return
@@ -33,19 +33,29 @@
 
 #include <string.h>
 #include <rmean.h>
+#include <histogram.h>
 
 #include <lua.h>
 #include <lauxlib.h>
 #include <lualib.h>
 
 #include "lua/utils.h"
+#include "box/iproto_constants.h"
 
 extern struct rmean *rmean_box;
 extern struct rmean *rmean_error;
-/** network statistics (iproto & cbus) */
-extern struct rmean *rmean_net;
-extern struct rmean *rmean_net_tx_bus;
+/** network statistics (iproto & cbus), one per iproto thread */
+extern int iproto_thread_count;
+extern struct rmean *rmean_net[];
+extern struct rmean *rmean_net_tx_bus[];
 extern struct rmean *rmean_tx_wal_bus;
+extern struct histogram *wal_batch_hist;
+extern struct histogram *wal_sync_hist;
+/** latency statistics, by request type */
+extern struct histogram **wal_latency;
+extern struct histogram *iproto_net_latency[];
+extern struct histogram *iproto_tx_latency[];
+extern struct histogram *iproto_flush_latency[][IPROTO_TYPE_STAT_MAX];
 
 static void
 fill_stat_item(struct lua_State *L, int rps, int64_t total)
@@ -110,31 +120,116 @@ lbox_stat_call(struct lua_State *L)
 	return 1;
 }
 
+/**
+ * A rmean_foreach() callback used to sum up statistics of
+ * all network threads in the table on top of the stack.
+ */
+static int
+add_stat_item(const char *name, int rps, int64_t total, void *cb_ctx)
+{
+	struct lua_State *L = (struct lua_State *) cb_ctx;
+
+	lua_getfield(L, -1, name);
+	if (lua_isnil(L, -1)) {
+		lua_pop(L, 1);
+		lua_newtable(L);
+		lua_pushvalue(L, -1);
+		lua_setfield(L, -3, name);
+	} else {
+		lua_getfield(L, -1, "rps");
+		rps += lua_tointeger(L, -1);
+		lua_getfield(L, -2, "total");
+		total += lua_tonumber(L, -1);
+		lua_pop(L, 2);
+	}
+	fill_stat_item(L, rps, total);
+	lua_pop(L, 1);
+	return 0;
+}
+
+/**
+ * Push box.stat.net(): the totals over all network threads
+ * and, in the "thread" array, the statistics of each thread.
+ */
+static void
+lbox_stat_net_push(struct lua_State *L)
+{
+	lua_newtable(L);
+	for (int i = 0; i < iproto_thread_count; i++) {
+		if (rmean_net[i] == NULL)
+			continue;
+		rmean_foreach(rmean_net[i], add_stat_item, L);
+		rmean_foreach(rmean_net_tx_bus[i], add_stat_item, L);
+	}
+	lua_newtable(L);
+	for (int i = 0; i < iproto_thread_count; i++) {
+		lua_newtable(L);
+		if (rmean_net[i] != NULL) {
+			rmean_foreach(rmean_net[i], set_stat_item, L);
+			rmean_foreach(rmean_net_tx_bus[i], set_stat_item, L);
+		}
+		lua_rawseti(L, -2, i + 1);
+	}
+	lua_setfield(L, -2, "thread");
+}
+
 static int
 lbox_stat_net_index(struct lua_State *L)
 {
-	luaL_checkstring(L, -1);
-	int res = rmean_foreach(rmean_net, seek_stat_item, L);
-	if (res)
-		return res;
-	return rmean_foreach(rmean_net_tx_bus, seek_stat_item, L);
+	const char *key = luaL_checkstring(L, -1);
+	lbox_stat_net_push(L);
+	lua_getfield(L, -1, key);
+	return 1;
 }
 
 static int
 lbox_stat_net_call(struct lua_State *L)
 {
-	lua_newtable(L);
-	rmean_foreach(rmean_net, set_stat_item, L);
-	rmean_foreach(rmean_net_tx_bus, set_stat_item, L);
+	lbox_stat_net_push(L);
 	return 1;
 }
 
+/** Push a summary of a histogram: count, percentiles and max. */
+static void
+fill_hist_item(struct lua_State *L, const struct histogram *hist)
+{
+	lua_newtable(L);
+
+	lua_pushstring(L, "total");
+	lua_pushnumber(L, hist->total);
+	lua_settable(L, -3);
+
+	static const struct {
+		const char *name;
+		double pct;
+	} pct[] = {
+		{ "p50", 50 }, { "p90", 90 }, { "p99", 99 }, { "p999", 99.9 },
+	};
+	for (unsigned i = 0; i < sizeof(pct) / sizeof(pct[0]); i++) {
+		lua_pushstring(L, pct[i].name);
+		lua_pushnumber(L, histogram_percentile(hist, pct[i].pct));
+		lua_settable(L, -3);
+	}
+
+	lua_pushstring(L, "max");
+	lua_pushnumber(L, hist->max);
+	lua_settable(L, -3);
+}
+
 static int
 lbox_stat_wal_index(struct lua_State *L)
 {
-	luaL_checkstring(L, -1);
+	const char *key = luaL_checkstring(L, -1);
 	if (rmean_tx_wal_bus == NULL)
 		return 0;
+	if (strcmp(key, "BATCH") == 0) {
+		fill_hist_item(L, wal_batch_hist);
+		return 1;
+	}
+	if (strcmp(key, "SYNC") == 0) {
+		fill_hist_item(L, wal_sync_hist);
+		return 1;
+	}
 	return rmean_foreach(rmean_tx_wal_bus, seek_stat_item, L);
 }
 
@@ -142,11 +237,75 @@ static int
 lbox_stat_wal_call(struct lua_State *L)
 {
 	lua_newtable(L);
-	if (rmean_tx_wal_bus)
+	if (rmean_tx_wal_bus) {
 		rmean_foreach(rmean_tx_wal_bus, set_stat_item, L);
+		fill_hist_item(L, wal_batch_hist);
+		lua_setfield(L, -2, "BATCH");
+		fill_hist_item(L, wal_sync_hist);
+		lua_setfield(L, -2, "SYNC");
+	}
 	return 1;
 }
 
+/**
+ * Push box.stat.latency(): for each request type which has
+ * been seen, the latency of every stage of its processing.
+ */
+static void
+lbox_stat_latency_push(struct lua_State *L)
+{
+	lua_newtable(L);
+	if (iproto_net_latency[0] == NULL)
+		return; /* box.cfg() is not called yet. */
+	for (int type = 0; type < IPROTO_TYPE_STAT_MAX; type++) {
+		if (iproto_type_strs[type] == NULL)
+			continue;
+		/* Sum up the network threads. */
+		struct histogram *flush =
+			histogram_new(iproto_flush_latency[0][type]->buckets,
+				      iproto_flush_latency[0][type]->n_buckets);
+		if (flush == NULL)
+			luaL_error(L, "failed to allocate a histogram");
+		for (int i = 0; i < iproto_thread_count; i++)
+			histogram_add(flush, iproto_flush_latency[i][type]);
+		struct histogram *wal =
+			wal_latency != NULL ? wal_latency[type] : NULL;
+		if (iproto_net_latency[type]->total == 0 &&
+		    (wal == NULL || wal->total == 0)) {
+			histogram_delete(flush);
+			continue;
+		}
+		lua_newtable(L);
+		fill_hist_item(L, iproto_net_latency[type]);
+		lua_setfield(L, -2, "NET");
+		fill_hist_item(L, iproto_tx_latency[type]);
+		lua_setfield(L, -2, "TX");
+		if (wal != NULL) {
+			fill_hist_item(L, wal);
+			lua_setfield(L, -2, "WAL");
+		}
+		fill_hist_item(L, flush);
+		lua_setfield(L, -2, "FLUSH");
+		histogram_delete(flush);
+		lua_setfield(L, -2, iproto_type_strs[type]);
+	}
+}
+
+static int
+lbox_stat_latency_index(struct lua_State *L)
+{
+	const char *key = luaL_checkstring(L, -1);
+	lbox_stat_latency_push(L);
+	lua_getfield(L, -1, key);
+	return 1;
+}
+
+static int
+lbox_stat_latency_call(struct lua_State *L)
+{
+	lbox_stat_latency_push(L);
+	return 1;
+}
 
 static const struct luaL_reg lbox_stat_meta [] = {
 	{"__index", lbox_stat_index},
@@ -166,6 +325,12 @@ static const struct luaL_reg lbox_stat_wal_meta [] = {
 	{NULL, NULL}
 };
 
+static const struct luaL_reg lbox_stat_latency_meta [] = {
+	{"__index", lbox_stat_latency_index},
+	{"__call",  lbox_stat_latency_call},
+	{NULL, NULL}
+};
+
 
 /** Initialize box.stat package. */
 void
@@ -196,5 +361,12 @@ box_lua_stat_init(struct lua_State *L)
 	luaL_register(L, NULL, lbox_stat_wal_meta);
 	lua_setmetatable(L, -2);
 	lua_pop(L, 1); /* stat wal module */
+
+	luaL_register_module(L, "box.stat.latency", statlib);
+
+	lua_newtable(L);
+	luaL_register(L, NULL, lbox_stat_latency_meta);
+	lua_setmetatable(L, -2);
+	lua_pop(L, 1); /* stat latency module */
 }
 
@@ -34,6 +34,10 @@
 #include <small/rlist.h>
 
 #include "trivia/util.h"
+#include "clock.h"
+#include "fiber.h"
+#include "cbus.h"
+#include "tt_pthread.h"
 #include "main.h"
 #include "coeio_file.h"
 #include "coeio.h"
@@ -574,11 +578,111 @@ memtx_end_build_primary_key(struct space *space, void *param)
 	handler->replace = memtx_replace_primary_key;
 }
 
+/**
+ * A secondary TREE index, which keys are collected and sorted
+ * in a separate thread on recovery. Only the sort is offloaded:
+ * bps_tree_index_build() allocates index extents, which is not
+ * thread-safe, so it is always done in tx.
+ */
+struct memtx_build_task {
+	struct cord cord;
+	MemtxTree *index;
+	MemtxIndex *pk;
+	/** Iterator over the primary key, owned by the task. */
+	struct iterator *it;
+	/** Time spent collecting and sorting keys, in seconds. */
+	double elapsed;
+	/** True if the keys are being sorted in a thread. */
+	bool is_started;
+	/** The error which stopped the task, raised in tx. */
+	struct diag diag;
+};
+
+static void *
+memtx_build_task_f(void *arg)
+{
+	struct memtx_build_task *task = (struct memtx_build_task *) arg;
+	double start = clock_monotonic();
+
+	try {
+		task->index->beginBuild();
+		task->index->reserve(task->pk->size() * 1.2);
+		task->pk->initIterator(task->it, ITER_ALL, NULL, 0);
+		struct tuple *tuple;
+		while ((tuple = task->it->next(task->it)))
+			task->index->buildNext(tuple);
+		task->index->sortBuild();
+	} catch (Exception *) {
+		diag_move(&fiber()->diag, &task->diag);
+	}
+
+	task->elapsed = clock_monotonic() - start;
+	return NULL;
+}
+
+/**
+ * Build the given TREE indexes, running at most @a thread_count
+ * sort threads at a time. Each batch is finished in tx before
+ * the next one is started, so that no more than @a thread_count
+ * build arrays are allocated at once.
+ */
+static void
+memtx_build_tree_keys(MemtxIndex *pk, struct memtx_build_task *tasks,
+		      uint32_t task_count, uint32_t thread_count)
+{
+	uint32_t n_tuples = pk->size();
+	for (uint32_t i = 0; i < task_count; i += thread_count) {
+		uint32_t batch_end = MIN(i + thread_count, task_count);
+		for (uint32_t j = i; j < batch_end; j++) {
+			struct memtx_build_task *task = &tasks[j];
+			task->pk = pk;
+			say_info("Adding %" PRIu32 " keys to %s index '%s' ...",
+				 n_tuples, index_type_strs[TREE],
+				 index_name(task->index));
+			task->is_started = cord_start(&task->cord, "build",
+						      memtx_build_task_f,
+						      task) == 0;
+			if (!task->is_started) {
+				/* Fall back to sorting in tx. */
+				say_warn("failed to start a build thread");
+				memtx_build_task_f(task);
+			}
+		}
+		/*
+		 * Join all threads of the batch before raising an
+		 * error: they use the primary key iterators.
+		 */
+		for (uint32_t j = i; j < batch_end; j++) {
+			struct memtx_build_task *task = &tasks[j];
+			if (task->is_started)
+				cord_join(&task->cord);
+		}
+		for (uint32_t j = i; j < batch_end; j++) {
+			struct memtx_build_task *task = &tasks[j];
+			if (!diag_is_empty(&task->diag)) {
+				diag_move(&task->diag, &fiber()->diag);
+				diag_raise();
+			}
+			double start = clock_monotonic();
+			task->index->endBuild();
+			say_info("Index '%s' built in %.3f sec "
+				 "(sort %.3f sec)", index_name(task->index),
+				 task->elapsed + clock_monotonic() - start,
+				 task->elapsed);
+		}
+	}
+}
+
 /**
  * Secondary indexes are built in bulk after all data is
  * recovered. This function enables secondary keys on a space.
  * Data dictionary spaces are an exception, they are fully
  * built right from the start.
+ *
+ * TREE indexes take the most time to build, since they need
+ * a sort, so they are sorted in parallel threads, up to
+ * box.cfg.index_build_threads at a time. The rest are built
+ * one by one in tx.
  */
 void
 memtx_build_secondary_keys(struct space *space, void *param)
@@ -589,6 +693,7 @@ memtx_build_secondary_keys(struct space *space, void *param)
 		return;
 
 	if (space->index_id_max > 0) {
+		MemtxEngine *engine = (MemtxEngine *) param;
 		MemtxIndex *pk = (MemtxIndex *) space->index[0];
 		uint32_t n_tuples = pk->size();
 
@@ -597,8 +702,38 @@ memtx_build_secondary_keys(struct space *space, void *param)
 				 space_name(space));
 		}
 
-		for (uint32_t j = 1; j < space->index_count; j++)
-			index_build((MemtxIndex *) space->index[j], pk);
+		uint32_t thread_count = engine->buildThreads();
+		struct memtx_build_task *tasks = NULL;
+		uint32_t task_count = 0;
+		auto guard = make_scoped_guard([&]{
+			for (uint32_t i = 0; i < task_count; i++) {
+				tasks[i].it->free(tasks[i].it);
+				diag_destroy(&tasks[i].diag);
+			}
+			free(tasks);
+		});
+		if (thread_count > 1 && n_tuples > 0) {
+			size_t size = space->index_count * sizeof(*tasks);
+			tasks = (struct memtx_build_task *) calloc(1, size);
+			if (tasks == NULL) {
+				tnt_raise(OutOfMemory, size, "calloc",
+					  "struct memtx_build_task");
+			}
+		}
+
+		for (uint32_t j = 1; j < space->index_count; j++) {
+			MemtxIndex *index = (MemtxIndex *) space->index[j];
+			if (tasks == NULL || index->key_def->type != TREE) {
+				index_build(index, pk);
+				continue;
+			}
+			struct memtx_build_task *task = &tasks[task_count];
+			task->it = pk->allocIterator();
+			task->index = (MemtxTree *) index;
+			diag_create(&task->diag);
+			task_count++;
+		}
+		memtx_build_tree_keys(pk, tasks, task_count, thread_count);
 
 		if (n_tuples > 0) {
 			say_info("Space '%s': done", space_name(space));
@@ -613,9 +748,11 @@ MemtxEngine::MemtxEngine(const char *snap_dirname, bool panic_on_snap_error,
 	m_checkpoint(0),
 	m_state(MEMTX_INITIALIZED),
 	m_snap_io_rate_limit(UINT64_MAX),
+	m_build_threads(1),
+	m_snap_threads(1),
 	m_panic_on_wal_error(panic_on_wal_error)
 {
-	flags = ENGINE_CAN_BE_TEMPORARY;
+	flags = ENGINE_CAN_BE_TEMPORARY | ENGINE_CAN_STREAM;
 	xdir_create(&m_snap_dir, snap_dirname, SNAP, &SERVER_UUID);
 	m_snap_dir.panic_if_error = panic_on_snap_error;
 	xdir_scan_xc(&m_snap_dir);
@@ -670,6 +807,340 @@ MemtxEngine::recoverSnapshotRow(struct xrow_header *row)
 	space->handler->applySnapshotRow(space, request);
 }
 
+void
+MemtxEngine::recoverSnapshotRows(struct xrow_header *rows, uint32_t count)
+{
+	for (uint32_t i = 0; i < count; i++) {
+		try {
+			recoverSnapshotRow(&rows[i]);
+		} catch (ClientError *e) {
+			if (m_snap_dir.panic_if_error)
+				throw;
+			say_error("can't apply row: ");
+			e->log();
+		}
+	}
+}
+
+/* {{{ Snapshot reader */
+
+enum {
+	/** Size of rows passed from the reader to tx at once. */
+	SNAP_BATCH_SIZE = 1024 * 1024,
+	/** Max number of batches in flight. */
+	SNAP_BATCH_MAX = 8,
+};
+
+struct snap_reader;
+
+/**
+ * Rows read by the snapshot reader thread. Row bodies are
+ * copied to the batch buffer, since the cursor reuses its own.
+ */
+struct snap_batch: public cmsg {
+	struct snap_reader *reader;
+	struct xrow_header *rows;
+	uint32_t row_count;
+	uint32_t row_capacity;
+	char *buf;
+	size_t buf_used;
+	size_t buf_size;
+	/** Set by the reader in the last batch. */
+	bool is_last;
+	/** Last batch: true if the EOF marker has been read. */
+	bool eof_read;
+	/** Last batch: the error which stopped the reader. */
+	struct diag diag;
+	/** Set by tx if it has failed and the reader must stop. */
+	bool is_cancelled;
+};
+
+/**
+ * Snapshot recovery is split between two threads: the reader
+ * does file IO, checks checksums and decompresses blocks, tx
+ * creates tuples and inserts them into indexes. Tuples can't
+ * be allocated or checked against space formats outside tx,
+ * since the allocator and the space cache belong to tx.
+ */
+struct snap_reader {
+	struct cbus bus;
+	/** Batches read, consumed by tx. */
+	struct cpipe tx_pipe;
+	/** Batches applied, consumed by the reader. */
+	struct cpipe reader_pipe;
+	struct cord cord;
+	struct xlog *snap;
+	/* ---- reader thread ---- */
+	struct fiber *reader_fiber;
+	/** Batches ready to be filled. */
+	struct stailq free;
+	uint32_t free_count;
+	bool is_cancelled;
+	/* ---- tx thread ---- */
+	struct fiber *tx_fiber;
+	/** Batches received from the reader, not yet applied. */
+	struct stailq ready;
+	struct snap_batch batches[SNAP_BATCH_MAX];
+};
+
+static void
+tx_snap_batch_ready(struct cmsg *m);
+
+static void
+snap_reader_recycle(struct cmsg *m);
+
+static struct cmsg_hop snap_batch_route[] = {
+	{tx_snap_batch_ready, NULL},
+};
+
+static struct cmsg_hop snap_batch_return_route[] = {
+	{snap_reader_recycle, NULL},
+};
+
+static bool
+snap_batch_is_full(struct snap_batch *batch, const struct xrow_header *row)
+{
+	size_t size = 0;
+	for (int i = 0; i < row->bodycnt; i++)
+		size += row->body[i].iov_len;
+	return batch->row_count > 0 &&
+	       batch->buf_used + size > batch->buf_size;
+}
+
+static int
+snap_batch_add_row(struct snap_batch *batch, const struct xrow_header *row)
+{
+	size_t size = 0;
+	for (int i = 0; i < row->bodycnt; i++)
+		size += row->body[i].iov_len;
+	if (batch->row_count == batch->row_capacity) {
+		uint32_t capacity = MAX(batch->row_capacity * 2, 1024u);
+		size_t bsize = capacity * sizeof(*batch->rows);
+		struct xrow_header *rows = (struct xrow_header *)
+			realloc(batch->rows, bsize);
+		if (rows == NULL) {
+			tnt_error(OutOfMemory, bsize, "realloc",
+				  "snapshot rows");
+			return -1;
+		}
+		batch->rows = rows;
+		batch->row_capacity = capacity;
+	}
+	if (batch->buf_used + size > batch->buf_size) {
+		/* Row bodies must not move, see snap_batch_is_full() */
+		assert(batch->row_count == 0);
+		size_t bsize = MAX(size, (size_t) SNAP_BATCH_SIZE);
+		char *buf = (char *) realloc(batch->buf, bsize);
+		if (buf == NULL) {
+			tnt_error(OutOfMemory, bsize, "realloc",
+				  "snapshot rows");
+			return -1;
+		}
+		batch->buf = buf;
+		batch->buf_size = bsize;
+	}
+	struct xrow_header *copy = &batch->rows[batch->row_count++];
+	*copy = *row;
+	for (int i = 0; i < row->bodycnt; i++) {
+		char *body = batch->buf + batch->buf_used;
+		memcpy(body, row->body[i].iov_base, row->body[i].iov_len);
+		copy->body[i].iov_base = body;
+		batch->buf_used += row->body[i].iov_len;
+	}
+	return 0;
+}
+
+/** Called in the reader when tx is done with a batch. */
+static void
+snap_reader_recycle(struct cmsg *m)
+{
+	struct snap_batch *batch = (struct snap_batch *) m;
+	struct snap_reader *reader = batch->reader;
+	if (batch->is_cancelled)
+		reader->is_cancelled = true;
+	stailq_add_tail_entry(&reader->free, m, fifo);
+	reader->free_count++;
+	fiber_wakeup(reader->reader_fiber);
+}
+
+static struct snap_batch *
+snap_reader_get_batch(struct snap_reader *reader)
+{
+	while (stailq_empty(&reader->free))
+		fiber_yield();
+	struct snap_batch *batch = (struct snap_batch *)
+		stailq_shift_entry(&reader->free, struct cmsg, fifo);
+	reader->free_count--;
+	batch->row_count = 0;
+	batch->buf_used = 0;
+	batch->is_last = false;
+	batch->eof_read = false;
+	batch->is_cancelled = false;
+	return batch;
+}
+
+static void
+snap_reader_send(struct snap_reader *reader, struct snap_batch *batch)
+{
+	cmsg_init(batch, snap_batch_route);
+	cpipe_push(&reader->tx_pipe, batch);
+}
+
+static int
+snap_reader_f(va_list ap)
+{
+	struct snap_reader *reader = va_arg(ap, struct snap_reader *);
+	reader->reader_fiber = fiber();
+	cbus_join(&reader->bus, &reader->reader_pipe);
+
+	struct xlog_cursor cursor;
+	xlog_cursor_open(&cursor, reader->snap);
+	struct snap_batch *batch = snap_reader_get_batch(reader);
+	int rc;
+	try {
+		struct xrow_header row;
+		while ((rc = xlog_cursor_next(&cursor, &row)) == 0) {
+			if (snap_batch_is_full(batch, &row)) {
+				snap_reader_send(reader, batch);
+				batch = snap_reader_get_batch(reader);
+				if (reader->is_cancelled)
+					break;
+			}
+			if (snap_batch_add_row(batch, &row) != 0) {
+				rc = -1;
+				break;
+			}
+		}
+	} catch (Exception *) {
+		rc = -1;
+	}
+	if (rc < 0)
+		diag_move(&fiber()->diag, &batch->diag);
+	batch->is_last = true;
+	batch->eof_read = cursor.eof_read;
+	xlog_cursor_close(&cursor);
+	snap_reader_send(reader, batch);
+
+	/* Wait until tx is done with all batches. */
+	while (reader->free_count < SNAP_BATCH_MAX)
+		fiber_yield();
+	return 0;
+}
+
+/** Called in tx when the reader has filled a batch. */
+static void
+tx_snap_batch_ready(struct cmsg *m)
+{
+	struct snap_batch *batch = (struct snap_batch *) m;
+	struct snap_reader *reader = batch->reader;
+	stailq_add_tail_entry(&reader->ready, m, fifo);
+	fiber_wakeup(reader->tx_fiber);
+}
+
+static void
+snap_reader_create(struct snap_reader *reader, struct xlog *snap)
+{
+	memset(reader, 0, sizeof(*reader));
+	reader->snap = snap;
+	cbus_create(&reader->bus);
+	cpipe_create(&reader->tx_pipe);
+	cpipe_create(&reader->reader_pipe);
+	/* Deliver batches right away, they are large enough. */
+	cpipe_set_max_input(&reader->tx_pipe, 1);
+	cpipe_set_max_input(&reader->reader_pipe, 1);
+	stailq_create(&reader->free);
+	stailq_create(&reader->ready);
+	for (int i = 0; i < SNAP_BATCH_MAX; i++) {
+		struct snap_batch *batch = &reader->batches[i];
+		batch->reader = reader;
+		diag_create(&batch->diag);
+		stailq_add_tail_entry(&reader->free, (struct cmsg *) batch,
+				      fifo);
+	}
+	reader->free_count = SNAP_BATCH_MAX;
+	reader->tx_fiber = fiber();
+}
+
+static void
+snap_reader_destroy(struct snap_reader *reader)
+{
+	for (int i = 0; i < SNAP_BATCH_MAX; i++) {
+		struct snap_batch *batch = &reader->batches[i];
+		diag_destroy(&batch->diag);
+		free(batch->rows);
+		free(batch->buf);
+	}
+	cbus_destroy(&reader->bus);
+}
+
+/* }}} */
+
+bool
+MemtxEngine::recoverSnapshot(struct xlog *snap)
+{
+	struct snap_reader reader;
+	snap_reader_create(&reader, snap);
+	auto reader_guard = make_scoped_guard([&]{
+		snap_reader_destroy(&reader);
+	});
+
+	if (cord_costart(&reader.cord, "snap_reader", snap_reader_f,
+			 &reader) != 0) {
+		/* Fall back to reading in tx. */
+		say_warn("failed to start the snapshot reader thread");
+		struct xlog_cursor cursor;
+		xlog_cursor_open(&cursor, snap);
+		auto cursor_guard = make_scoped_guard([&]{
+			xlog_cursor_close(&cursor);
+		});
+		struct xrow_header row;
+		while (xlog_cursor_next_xc(&cursor, &row) == 0)
+			recoverSnapshotRows(&row, 1);
+		return cursor.eof_read;
+	}
+	cbus_join(&reader.bus, &reader.tx_pipe);
+
+	/*
+	 * Keep receiving batches after an error, until the
+	 * last one, so that the reader can be stopped.
+	 */
+	struct diag diag;
+	diag_create(&diag);
+	bool eof_read = false;
+	bool is_last = false;
+	while (!is_last) {
+		while (stailq_empty(&reader.ready))
+			fiber_yield();
+		struct snap_batch *batch = (struct snap_batch *)
+			stailq_shift_entry(&reader.ready, struct cmsg, fifo);
+		if (diag_is_empty(&diag)) {
+			try {
+				recoverSnapshotRows(batch->rows,
+						    batch->row_count);
+			} catch (Exception *) {
+				diag_move(&fiber()->diag, &diag);
+			}
+			/* Same policy as in xlog_cursor_next(). */
+			region_free_after(&fiber()->gc, 128 * 1024);
+		}
+		is_last = batch->is_last;
+		if (is_last) {
+			eof_read = batch->eof_read;
+			if (diag_is_empty(&diag))
+				diag_move(&batch->diag, &diag);
+		}
+		batch->is_cancelled = !diag_is_empty(&diag);
+		cmsg_init(batch, snap_batch_return_route);
+		cpipe_push(&reader.reader_pipe, batch);
+	}
+	cord_cojoin(&reader.cord);
+	if (!diag_is_empty(&diag)) {
+		diag_move(&diag, &fiber()->diag);
+		diag_raise();
+	}
+	return eof_read;
+}
+
 /** Called at start to tell memtx to recover to a given LSN. */
 void
 MemtxEngine::beginInitialRecovery()
@@ -703,30 +1174,14 @@ MemtxEngine::beginInitialRecovery()
 	SERVER_UUID = snap->server_uuid;
 
 	say_info("recovering from `%s'", snap->filename);
-	struct xlog_cursor cursor;
-	xlog_cursor_open(&cursor, snap);
-	auto reader_guard = make_scoped_guard([&]{
-		xlog_cursor_close(&cursor);
-	});
-
-	struct xrow_header row;
-	while (xlog_cursor_next_xc(&cursor, &row) == 0) {
-		try {
-			recoverSnapshotRow(&row);
-		} catch (ClientError *e) {
-			if (m_snap_dir.panic_if_error)
-				throw;
-			say_error("can't apply row: ");
-			e->log();
-		}
-	}
+	bool eof_read = recoverSnapshot(snap);
 
 	/**
 	 * We should never try to read snapshots with no EOF
 	 * marker - such snapshots are very likely corrupted and
 	 * should not be trusted.
 	 */
-	if (!cursor.eof_read)
+	if (!eof_read)
 		panic("snapshot `%s' has no EOF marker", snap->filename);
 }
 
@@ -840,7 +1295,7 @@ MemtxEngine::createIndex(struct key_def *key_def)
 	case HASH:
 		return new MemtxHash(key_def);
 	case TREE:
-		return new MemtxTree(key_def);
+		return memtx_tree_new(key_def);
 	case RTREE:
 		return new MemtxRTree(key_def);
 	case BITSET:
@@ -881,7 +1336,15 @@ MemtxEngine::keydefCheck(struct space *space, struct key_def *key_def)
 		}
 		break;
 	case TREE:
-		/* TREE index has no limitations. */
+		if (key_def->opts.hint && key_def->parts[0].type != NUM &&
+		    key_def->parts[0].type != INT &&
+		    key_def->parts[0].type != STRING) {
+			tnt_raise(ClientError, ER_MODIFY_INDEX,
+				  key_def->name,
+				  space_name(space),
+				  "TREE index hint requires the first "
+				  "key part to be NUM, INT or STR");
+		}
 		break;
 	case RTREE:
 		if (key_def->part_count != 1) {
@@ -1057,45 +1520,23 @@ MemtxEngine::bootstrap()
 		recoverSnapshotRow(&row);
 }
 
-static void
-checkpoint_write_row(struct xlog *l, struct xrow_header *row,
-		     uint64_t snap_io_rate_limit)
+/**
+ * Account @a written bytes against snap_io_rate_limit and sleep
+ * if the limit is exceeded.
+ *
+ * @return the time of the first write to disk within the
+ * current second, 0 if there is no limit.
+ */
+static ev_tstamp
+checkpoint_throttle(struct xlog *l, size_t written,
+		    uint64_t snap_io_rate_limit)
 {
 	static uint64_t bytes;
 	ev_tstamp elapsed;
 	static ev_tstamp last = 0;
 	ev_loop *loop = loop();
 
-	row->tm = last;
-	row->server_id = 0;
-	/**
-	 * Rows in snapshot are numbered from 1 to %rows.
-	 * This makes streaming such rows to a replica or
-	 * to recovery look similar to streaming a normal
-	 * WAL. @sa the place which skips old rows in
-	 * recovery_apply_row().
-	 */
-	row->lsn = ++l->rows;
-	row->sync = 0; /* don't write sync to wal */
-
-	struct iovec iov[XROW_IOVMAX];
-	int iovcnt = xlog_encode_row(row, iov);
-
-	/* TODO: use writev here */
-	for (int i = 0; i < iovcnt; i++) {
-		if (fwrite(iov[i].iov_base, iov[i].iov_len, 1, l->f) != 1) {
-			say_syserror("Can't write row (%zu bytes)",
-				     iov[i].iov_len);
-			tnt_raise(SystemError, "fwrite");
-		}
-		bytes += iov[i].iov_len;
-	}
-
-	if (l->rows % 100000 == 0)
-		say_crit("%.1fM rows written", l->rows / 1000000.);
-
-	fiber_gc();
-
+	bytes += written;
 	if (snap_io_rate_limit != UINT64_MAX) {
 		if (last == 0) {
 			/*
@@ -1132,6 +1573,59 @@ checkpoint_write_row(struct xlog *l, struct xrow_header *row,
 		last = ev_now(loop);
 		bytes -= snap_io_rate_limit;
 	}
+	return last;
+}
+
+static void
+checkpoint_write_row(struct xlog *l, struct xrow_header *row,
+		     uint64_t snap_io_rate_limit)
+{
+	static ev_tstamp last = 0;
+
+	row->tm = last;
+	row->server_id = 0;
+	/**
+	 * Rows in snapshot are numbered from 1 to %rows.
+	 * This makes streaming such rows to a replica or
+	 * to recovery look similar to streaming a normal
+	 * WAL. @sa the place which skips old rows in
+	 * recovery_apply_row().
+	 */
+	row->lsn = ++l->rows;
+	row->sync = 0; /* don't write sync to wal */
+
+	ssize_t written = xlog_write_row(l, row);
+	if (written < 0)
+		diag_raise();
+
+	if (l->rows % 100000 == 0)
+		say_crit("%.1fM rows written", l->rows / 1000000.);
+
+	fiber_gc();
+
+	last = checkpoint_throttle(l, written, snap_io_rate_limit);
+}
+
+/** Make an INSERT row for a tuple of a snapshot. */
+static void
+checkpoint_encode_tuple(struct xrow_header *row,
+			struct request_replace_body *body,
+			uint32_t n, struct tuple *tuple)
+{
+	body->m_body = 0x82; /* map of two elements. */
+	body->k_space_id = IPROTO_SPACE_ID;
+	body->m_space_id = 0xce; /* uint32 */
+	body->v_space_id = mp_bswap_u32(n);
+	body->k_tuple = IPROTO_TUPLE;
+
+	memset(row, 0, sizeof(struct xrow_header));
+	row->type = IPROTO_INSERT;
+
+	row->bodycnt = 2;
+	row->body[0].iov_base = body;
+	row->body[0].iov_len = sizeof(*body);
+	row->body[1].iov_base = tuple->data;
+	row->body[1].iov_len = tuple->bsize;
 }
 
 static void
@@ -1139,21 +1633,8 @@ checkpoint_write_tuple(struct xlog *l, uint32_t n, struct tuple *tuple,
 		       uint64_t snap_io_rate_limit)
 {
 	struct request_replace_body body;
-	body.m_body = 0x82; /* map of two elements. */
-	body.k_space_id = IPROTO_SPACE_ID;
-	body.m_space_id = 0xce; /* uint32 */
-	body.v_space_id = mp_bswap_u32(n);
-	body.k_tuple = IPROTO_TUPLE;
-
 	struct xrow_header row;
-	memset(&row, 0, sizeof(struct xrow_header));
-	row.type = IPROTO_INSERT;
-
-	row.bodycnt = 2;
-	row.body[0].iov_base = &body;
-	row.body[0].iov_len = sizeof(body);
-	row.body[1].iov_base = tuple->data;
-	row.body[1].iov_len = tuple->bsize;
+	checkpoint_encode_tuple(&row, &body, n, tuple);
 	checkpoint_write_row(l, &row, snap_io_rate_limit);
 }
 
@@ -1163,6 +1644,27 @@ struct checkpoint_entry {
 	struct rlist link;
 };
 
+/**
+ * Rows of a space encoded by a snapshot worker thread,
+ * waiting to be written to the snapshot file.
+ */
+struct checkpoint_chunk {
+	/** Link in checkpoint::chunks. */
+	struct rlist link;
+	/** LSN of the first row in the chunk. */
+	int64_t lsn;
+	struct xlog_batch batch;
+};
+
+enum {
+	/**
+	 * How many chunks per worker thread may be encoded
+	 * but not yet written, limits the memory used by
+	 * a snapshot.
+	 */
+	CHECKPOINT_CHUNKS_PER_THREAD = 2,
+};
+
 struct checkpoint {
 	/**
 	 * List of MemTX spaces to snapshot, with consistent
@@ -1175,11 +1677,38 @@ struct checkpoint {
 	/** The vclock of the snapshot file. */
 	struct vclock vclock;
 	struct xdir dir;
+	/** The number of threads encoding rows of user spaces. */
+	uint32_t thread_count;
+	/**
+	 * The members below are shared between the snapshot
+	 * thread and the worker threads and are protected by
+	 * the mutex.
+	 */
+	pthread_mutex_t mutex;
+	/** Signalled whenever any of the members below change. */
+	pthread_cond_t cond;
+	/** The next space to be taken by a worker. */
+	struct checkpoint_entry *next_entry;
+	/** LSN of the first row of the next chunk. */
+	int64_t next_lsn;
+	/**
+	 * Timestamp of the rows of the next chunk, the time of
+	 * the last throttled write, see checkpoint_write_row().
+	 */
+	ev_tstamp tm;
+	/** Encoded chunks, not ordered. */
+	struct rlist chunks;
+	/** The number of chunks being encoded or not yet written. */
+	uint32_t chunk_count;
+	/** The number of running worker threads. */
+	uint32_t worker_count;
+	/** Set on error, tells all threads to stop. */
+	bool is_aborted;
 };
 
 static void
 checkpoint_init(struct checkpoint *ckpt, const char *snap_dirname,
-		uint64_t snap_io_rate_limit)
+		uint64_t snap_io_rate_limit, uint32_t thread_count)
 {
 	ckpt->entries = RLIST_HEAD_INITIALIZER(ckpt->entries);
 	ckpt->waiting_for_snap_thread = false;
@@ -1187,6 +1716,16 @@ checkpoint_init(struct checkpoint *ckpt, const char *snap_dirname,
 	ckpt->snap_io_rate_limit = snap_io_rate_limit;
 	/* May be used in abortCheckpoint() */
 	vclock_create(&ckpt->vclock);
+	ckpt->thread_count = thread_count;
+	tt_pthread_mutex_init(&ckpt->mutex, NULL);
+	tt_pthread_cond_init(&ckpt->cond, NULL);
+	ckpt->next_entry = NULL;
+	ckpt->next_lsn = 0;
+	ckpt->tm = 0;
+	rlist_create(&ckpt->chunks);
+	ckpt->chunk_count = 0;
+	ckpt->worker_count = 0;
+	ckpt->is_aborted = false;
 }
 
 static void
@@ -1200,6 +1739,8 @@ checkpoint_destroy(struct checkpoint *ckpt)
 	}
 	ckpt->entries = RLIST_HEAD_INITIALIZER(ckpt->entries);
 	xdir_destroy(&ckpt->dir);
+	tt_pthread_cond_destroy(&ckpt->cond);
+	tt_pthread_mutex_destroy(&ckpt->mutex);
 }
 
 
@@ -1225,6 +1766,303 @@ checkpoint_add_space(struct space *sp, void *data)
 	pk->createReadViewForIterator(entry->iterator);
 };
 
+static void
+checkpoint_write_entry(struct checkpoint *ckpt, struct xlog *snap,
+		       struct checkpoint_entry *entry)
+{
+	struct tuple *tuple;
+	struct iterator *it = entry->iterator;
+	for (tuple = it->next(it); tuple; tuple = it->next(it)) {
+		checkpoint_write_tuple(snap, space_id(entry->space),
+				       tuple, ckpt->snap_io_rate_limit);
+	}
+}
+
+/** Stop all snapshot threads. Called with the mutex locked. */
+static void
+checkpoint_abort(struct checkpoint *ckpt)
+{
+	ckpt->is_aborted = true;
+	tt_pthread_cond_broadcast(&ckpt->cond);
+}
+
+/**
+ * Encode tuples of a space into a chunk and queue it for
+ * writing. The chunk gets the next @a count LSNs, so chunks
+ * can be written in the order of LSNs no matter in which
+ * order the workers finish them.
+ */
+static int
+checkpoint_encode_chunk(struct checkpoint *ckpt, uint32_t n,
+			struct tuple **tuples, uint32_t count)
+{
+	int64_t lsn = 0;
+	ev_tstamp tm = 0;
+	tt_pthread_mutex_lock(&ckpt->mutex);
+	while (!ckpt->is_aborted && ckpt->chunk_count >=
+	       ckpt->thread_count * CHECKPOINT_CHUNKS_PER_THREAD)
+		tt_pthread_cond_wait(&ckpt->cond, &ckpt->mutex);
+	bool is_aborted = ckpt->is_aborted;
+	if (!is_aborted) {
+		lsn = ckpt->next_lsn;
+		ckpt->next_lsn += count;
+		ckpt->chunk_count++;
+		tm = ckpt->tm;
+	}
+	tt_pthread_mutex_unlock(&ckpt->mutex);
+	if (is_aborted)
+		return -1;
+
+	struct checkpoint_chunk *chunk =
+		(struct checkpoint_chunk *) malloc(sizeof(*chunk));
+	if (chunk == NULL) {
+		tnt_error(OutOfMemory, sizeof(*chunk), "malloc",
+			  "struct checkpoint_chunk");
+		goto error;
+	}
+	chunk->lsn = lsn;
+	xlog_batch_create(&chunk->batch);
+	try {
+		for (uint32_t i = 0; i < count; i++) {
+			struct request_replace_body body;
+			struct xrow_header row;
+			checkpoint_encode_tuple(&row, &body, n, tuples[i]);
+			row.lsn = lsn + i;
+			row.tm = tm;
+			if (xlog_batch_add_row(&chunk->batch, &row) < 0)
+				goto error;
+		}
+	} catch (Exception *e) {
+		goto error;
+	}
+	if (xlog_batch_seal(&chunk->batch, ckpt->dir.compression) != 0)
+		goto error;
+	/* Row headers are encoded on the region, see checkpoint_write_row() */
+	fiber_gc();
+
+	tt_pthread_mutex_lock(&ckpt->mutex);
+	rlist_add_tail_entry(&ckpt->chunks, chunk, link);
+	tt_pthread_cond_broadcast(&ckpt->cond);
+	tt_pthread_mutex_unlock(&ckpt->mutex);
+	return 0;
+error:
+	fiber_gc();
+	if (chunk != NULL) {
+		xlog_batch_destroy(&chunk->batch);
+		free(chunk);
+	}
+	tt_pthread_mutex_lock(&ckpt->mutex);
+	checkpoint_abort(ckpt);
+	tt_pthread_mutex_unlock(&ckpt->mutex);
+	return -1;
+}
+
+/**
+ * Take spaces one by one and encode their rows in chunks of
+ * about XLOG_BLOCK_SIZE bytes, until all spaces are taken or
+ * the checkpoint is aborted.
+ */
+static void
+checkpoint_worker_encode(struct checkpoint *ckpt)
+{
+	struct tuple **tuples = NULL;
+	uint32_t capacity = 0;
+	auto tuples_guard = make_scoped_guard([&]{ free(tuples); });
+	while (true) {
+		struct checkpoint_entry *entry = NULL;
+		tt_pthread_mutex_lock(&ckpt->mutex);
+		if (!ckpt->is_aborted &&
+		    &ckpt->next_entry->link != &ckpt->entries) {
+			entry = ckpt->next_entry;
+			ckpt->next_entry = rlist_entry(entry->link.next,
+						       struct checkpoint_entry,
+						       link);
+		}
+		tt_pthread_mutex_unlock(&ckpt->mutex);
+		if (entry == NULL)
+			return;
+
+		uint32_t n = space_id(entry->space);
+		struct iterator *it = entry->iterator;
+		struct tuple *tuple = it->next(it);
+		while (tuple != NULL) {
+			uint32_t count = 0;
+			size_t size = 0;
+			for (; tuple != NULL && size < XLOG_BLOCK_SIZE;
+			     tuple = it->next(it)) {
+				if (count == capacity) {
+					capacity = MAX(capacity * 2, 1024u);
+					size_t bsize = capacity *
+						       sizeof(*tuples);
+					struct tuple **new_tuples =
+						(struct tuple **)
+						realloc(tuples, bsize);
+					if (new_tuples == NULL) {
+						tnt_raise(OutOfMemory, bsize,
+							  "realloc", "tuples");
+					}
+					tuples = new_tuples;
+				}
+				tuples[count++] = tuple;
+				size += tuple->bsize;
+			}
+			if (checkpoint_encode_chunk(ckpt, n, tuples,
+						    count) != 0)
+				return;
+		}
+	}
+}
+
+/**
+ * A snapshot worker thread. An error, including an exception,
+ * aborts the whole checkpoint and is passed to the tx thread
+ * by cord_join().
+ */
+static void *
+checkpoint_worker_f(void *arg)
+{
+	struct checkpoint *ckpt = (struct checkpoint *) arg;
+	try {
+		checkpoint_worker_encode(ckpt);
+	} catch (Exception *e) {
+		tt_pthread_mutex_lock(&ckpt->mutex);
+		checkpoint_abort(ckpt);
+		tt_pthread_mutex_unlock(&ckpt->mutex);
+	}
+	tt_pthread_mutex_lock(&ckpt->mutex);
+	ckpt->worker_count--;
+	tt_pthread_cond_broadcast(&ckpt->cond);
+	tt_pthread_mutex_unlock(&ckpt->mutex);
+	return NULL;
+}
+
+/**
+ * Write chunks encoded by the workers to the snapshot file,
+ * in the order of LSNs, until all workers are done.
+ */
+static int
+checkpoint_write_chunks(struct checkpoint *ckpt, struct xlog *snap)
+{
+	int rc = 0;
+	tt_pthread_mutex_lock(&ckpt->mutex);
+	while (!ckpt->is_aborted) {
+		struct checkpoint_chunk *chunk, *next = NULL;
+		rlist_foreach_entry(chunk, &ckpt->chunks, link) {
+			if (chunk->lsn == snap->rows + 1) {
+				next = chunk;
+				break;
+			}
+		}
+		if (next == NULL) {
+			if (ckpt->worker_count == 0) {
+				assert(rlist_empty(&ckpt->chunks));
+				break;
+			}
+			tt_pthread_cond_wait(&ckpt->cond, &ckpt->mutex);
+			continue;
+		}
+		rlist_del_entry(next, link);
+		ev_tstamp tm = ckpt->tm;
+		tt_pthread_mutex_unlock(&ckpt->mutex);
+
+		int64_t rows = snap->rows;
+		ssize_t written = xlog_write_batch(snap, &next->batch);
+		xlog_batch_destroy(&next->batch);
+		free(next);
+		if (written >= 0) {
+			if (rows / 100000 != snap->rows / 100000) {
+				say_crit("%.1fM rows written",
+					 snap->rows / 1000000.);
+			}
+			tm = checkpoint_throttle(snap, written,
+						 ckpt->snap_io_rate_limit);
+		}
+
+		tt_pthread_mutex_lock(&ckpt->mutex);
+		ckpt->tm = tm;
+		ckpt->chunk_count--;
+		tt_pthread_cond_broadcast(&ckpt->cond);
+		if (written < 0) {
+			checkpoint_abort(ckpt);
+			rc = -1;
+		}
+	}
+	tt_pthread_mutex_unlock(&ckpt->mutex);
+	return rc;
+}
+
+/**
+ * Write spaces starting from @a first using worker threads
+ * to iterate over the read views and encode rows.
+ */
+static void
+checkpoint_write_parallel(struct checkpoint *ckpt, struct xlog *snap,
+			  struct checkpoint_entry *first)
+{
+	ckpt->next_entry = first;
+	ckpt->next_lsn = snap->rows + 1;
+	/* Nothing is written, only the current timestamp is taken. */
+	ckpt->tm = checkpoint_throttle(snap, 0, ckpt->snap_io_rate_limit);
+
+	uint32_t thread_count = ckpt->thread_count;
+	struct cord *workers = (struct cord *)
+		calloc(thread_count, sizeof(*workers));
+	if (workers == NULL) {
+		tnt_raise(OutOfMemory, thread_count * sizeof(*workers),
+			  "calloc", "snapshot workers");
+	}
+	auto workers_guard = make_scoped_guard([=]{ free(workers); });
+
+	uint32_t started = 0;
+	for (; started < thread_count; started++) {
+		tt_pthread_mutex_lock(&ckpt->mutex);
+		ckpt->worker_count++;
+		tt_pthread_mutex_unlock(&ckpt->mutex);
+		if (cord_start(&workers[started], "snapshot.worker",
+			       checkpoint_worker_f, ckpt) != 0) {
+			tt_pthread_mutex_lock(&ckpt->mutex);
+			ckpt->worker_count--;
+			tt_pthread_mutex_unlock(&ckpt->mutex);
+			break;
+		}
+	}
+	if (started == 0) {
+		/* Fall back to writing in this thread. */
+		say_warn("failed to start snapshot worker threads");
+		for (struct checkpoint_entry *entry = first;
+		     &entry->link != &ckpt->entries;
+		     entry = rlist_entry(entry->link.next,
+					 struct checkpoint_entry, link))
+			checkpoint_write_entry(ckpt, snap, entry);
+		return;
+	}
+
+	int rc = checkpoint_write_chunks(ckpt, snap);
+
+	/*
+	 * cord_join() replaces the diagnostics of the caller,
+	 * keep the first error.
+	 */
+	struct diag diag;
+	diag_create(&diag);
+	diag_move(&fiber()->diag, &diag);
+	for (uint32_t i = 0; i < started; i++) {
+		cord_join(&workers[i]);
+		if (diag_is_empty(&diag))
+			diag_move(&fiber()->diag, &diag);
+	}
+	diag_move(&diag, &fiber()->diag);
+
+	struct checkpoint_chunk *chunk, *tmp;
+	rlist_foreach_entry_safe(chunk, &ckpt->chunks, link, tmp) {
+		xlog_batch_destroy(&chunk->batch);
+		free(chunk);
+	}
+	rlist_create(&ckpt->chunks);
+	if (rc != 0 || ckpt->is_aborted)
+		diag_raise();
+}
+
 int
 checkpoint_f(va_list ap)
 {
@@ -1238,15 +2076,21 @@ checkpoint_f(va_list ap)
 	auto guard = make_scoped_guard([=]{ xlog_close(snap); });
 
 	say_info("saving snapshot `%s'", snap->filename);
+	/*
+	 * System spaces are written first, in this thread, since
+	 * recovery needs them to create user spaces. User spaces
+	 * are written by worker threads if there are any.
+	 */
 	struct checkpoint_entry *entry;
 	rlist_foreach_entry(entry, &ckpt->entries, link) {
-		struct tuple *tuple;
-		struct iterator *it = entry->iterator;
-		for (tuple = it->next(it); tuple; tuple = it->next(it)) {
-			checkpoint_write_tuple(snap, space_id(entry->space),
-					       tuple, ckpt->snap_io_rate_limit);
-		}
+		if (ckpt->thread_count > 1 && !space_is_system(entry->space))
+			break;
+		checkpoint_write_entry(ckpt, snap, entry);
 	}
+	if (&entry->link != &ckpt->entries)
+		checkpoint_write_parallel(ckpt, snap, entry);
+	if (xlog_flush(snap) < 0)
+		diag_raise();
 	say_info("done");
 	return 0;
 }
@@ -1258,7 +2102,9 @@ MemtxEngine::beginCheckpoint()
 
 	m_checkpoint = region_alloc_object_xc(&fiber()->gc, struct checkpoint);
 
-	checkpoint_init(m_checkpoint, m_snap_dir.dirname, m_snap_io_rate_limit);
+	checkpoint_init(m_checkpoint, m_snap_dir.dirname, m_snap_io_rate_limit,
+			m_snap_threads);
+	m_checkpoint->dir.compression = m_snap_dir.compression;
 	space_foreach(checkpoint_add_space, m_checkpoint);
 
 	/* increment snapshot version; set tuple deletion to delayed mode */
@@ -76,6 +76,25 @@ struct MemtxEngine: public Engine {
 		if (m_snap_io_rate_limit == 0)
 			m_snap_io_rate_limit = UINT64_MAX;
 	}
+	/** Set compression of new snapshots. */
+	void setSnapCompression(enum xlog_compression compression)
+	{
+		m_snap_dir.compression = compression;
+	}
+	/** Set the number of threads used to build secondary keys. */
+	void setBuildThreads(int thread_count)
+	{
+		m_build_threads = thread_count;
+	}
+	int buildThreads() const
+	{
+		return m_build_threads;
+	}
+	/** Set the number of threads used to write a snapshot. */
+	void setSnapThreads(int thread_count)
+	{
+		m_snap_threads = thread_count;
+	}
 	/**
 	 * Return LSN of the most recent snapshot or -1 if there is
 	 * no snapshot.
@@ -84,6 +103,19 @@ struct MemtxEngine: public Engine {
 private:
 	void
 	recoverSnapshotRow(struct xrow_header *row);
+	/**
+	 * Apply snapshot rows, logging and skipping broken
+	 * ones unless panic_on_snap_error is set.
+	 */
+	void
+	recoverSnapshotRows(struct xrow_header *rows, uint32_t count);
+	/**
+	 * Apply all rows of a snapshot, reading them in a
+	 * separate thread. Returns true if the EOF marker
+	 * has been read.
+	 */
+	bool
+	recoverSnapshot(struct xlog *snap);
 	/** Non-zero if there is a checkpoint (snapshot) in progress. */
 	struct checkpoint *m_checkpoint;
 	enum memtx_recovery_state m_state;
@@ -91,6 +123,13 @@ private:
 	struct xdir m_snap_dir;
 	/** Limit disk usage of checkpointing (bytes per second). */
 	uint64_t m_snap_io_rate_limit;
+	/**
+	 * Max number of threads sorting secondary TREE keys
+	 * on recovery.
+	 */
+	int m_build_threads;
+	/** Number of threads encoding rows of a snapshot. */
+	int m_snap_threads;
 	struct vclock m_last_checkpoint;
 	bool m_has_checkpoint;
 	bool m_panic_on_wal_error;
@@ -33,6 +33,7 @@
 #include "memtx_index.h"
 #include "tuple.h"
 #include "say.h"
+#include "clock.h"
 #include "schema.h"
 #include "user_def.h"
 #include "space.h"
@@ -91,6 +92,7 @@ index_build(MemtxIndex *index, MemtxIndex *pk)
 {
 	uint32_t n_tuples = pk->size();
 	uint32_t estimated_tuples = n_tuples * 1.2;
+	double start = clock_monotonic();
 
 	index->beginBuild();
 	index->reserve(estimated_tuples);
@@ -108,4 +110,9 @@ index_build(MemtxIndex *index, MemtxIndex *pk)
 		index->buildNext(tuple);
 
 	index->endBuild();
+
+	if (n_tuples > 0) {
+		say_info("Index '%s' built in %.3f sec", index_name(index),
+			 clock_monotonic() - start);
+	}
 }
@@ -43,8 +43,64 @@ struct key_data
 {
 	const char *key;
 	uint32_t part_count;
+	/** Hint of the first key part, see memtx_tree_data. */
+	uint64_t hint;
 };
 
+/**
+ * Map a field of the first key part to a hint. The mapping is
+ * monotonic, but not injective: unsigned values above INT64_MAX
+ * in an INT part share the top hint, and strings are cut to
+ * their first 8 bytes, so equal hints mean "compare in full".
+ */
+static inline uint64_t
+tree_field_hint(const char *field, enum field_type type)
+{
+	switch (type) {
+	case NUM:
+		return mp_decode_uint(&field);
+	case INT:
+		if (mp_typeof(*field) == MP_UINT) {
+			uint64_t val = mp_decode_uint(&field);
+			if (val > INT64_MAX)
+				return UINT64_MAX;
+			return val | (1ULL << 63);
+		}
+		return (uint64_t) mp_decode_int(&field) ^ (1ULL << 63);
+	case STRING: {
+		uint32_t len;
+		const char *str = mp_decode_str(&field, &len);
+		uint64_t hint = 0;
+		for (uint32_t i = 0; i < sizeof(hint); i++) {
+			hint <<= 8;
+			if (i < len)
+				hint |= (uint8_t) str[i];
+		}
+		return hint;
+	}
+	default:
+		unreachable();
+		return 0;
+	}
+}
+
+static inline uint64_t
+tree_tuple_hint(const struct tuple *tuple, struct key_def *key_def)
+{
+	assert(key_def->opts.hint);
+	const char *field = tuple_field(tuple, key_def->parts[0].fieldno);
+	assert(field != NULL);
+	return tree_field_hint(field, key_def->parts[0].type);
+}
+
+static inline uint64_t
+tree_key_hint(const char *key, uint32_t part_count, struct key_def *key_def)
+{
+	if (!key_def->opts.hint || part_count == 0)
+		return 0;
+	return tree_field_hint(key, key_def->parts[0].type);
+}
+
 int
 tree_index_compare(const tuple *a, const tuple *b, struct key_def *key_def)
 {
@@ -65,26 +121,196 @@ int tree_index_qcompare(const void* a, const void *b, void *c)
 	return tree_index_compare(*(struct tuple **)a,
 		*(struct tuple **)b, (struct key_def *)c);
 }
+int
+tree_index_compare_hint(struct memtx_tree_data a, struct memtx_tree_data b,
+			struct key_def *key_def)
+{
+	if (a.hint != b.hint)
+		return a.hint < b.hint ? -1 : 1;
+	return tree_index_compare(a.tuple, b.tuple, key_def);
+}
+int
+tree_index_compare_key_hint(struct memtx_tree_data a,
+			    const struct key_data *key_data,
+			    struct key_def *key_def)
+{
+	if (a.hint != key_data->hint)
+		return a.hint < key_data->hint ? -1 : 1;
+	return tree_index_compare_key(a.tuple, key_data, key_def);
+}
+int tree_index_qcompare_hint(const void* a, const void *b, void *c)
+{
+	return tree_index_compare_hint(*(struct memtx_tree_data *)a,
+		*(struct memtx_tree_data *)b, (struct key_def *)c);
+}
+
+/* }}} */
+
+/* {{{ Tree flavours **********************************************/
+
+/**
+ * The two instantiations of the tree, wrapped for MemtxTreeImpl:
+ * a tree of tuples, and a tree of (tuple, hint) pairs for indexes
+ * with the hint option.
+ */
+struct memtx_tree_plain {
+	typedef struct tuple *elem_t;
+	typedef struct bps_tree_index tree_t;
+	typedef struct bps_tree_index_iterator iterator_t;
+
+	static inline elem_t
+	make_elem(struct tuple *tuple, struct key_def *)
+	{ return tuple; }
+	static inline struct tuple *
+	elem_tuple(const elem_t *elem)
+	{ return *elem; }
+	static inline int
+	compare_key(const elem_t *elem, const struct key_data *key,
+		    struct key_def *key_def)
+	{ return tree_index_compare_key(*elem, key, key_def); }
+	static int
+	qcompare(const void *a, const void *b, void *arg)
+	{ return tree_index_qcompare(a, b, arg); }
+
+	static inline void
+	create(tree_t *tree, struct key_def *key_def)
+	{
+		bps_tree_index_create(tree, key_def,
+				      memtx_index_extent_alloc,
+				      memtx_index_extent_free);
+	}
+	static inline void destroy(tree_t *tree)
+	{ bps_tree_index_destroy(tree); }
+	static inline int build(tree_t *tree, elem_t *array, size_t size)
+	{ return bps_tree_index_build(tree, array, size); }
+	static inline size_t size(const tree_t *tree)
+	{ return bps_tree_index_size(tree); }
+	static inline size_t mem_used(const tree_t *tree)
+	{ return bps_tree_index_mem_used(tree); }
+	static inline elem_t *random(const tree_t *tree, size_t rnd)
+	{ return bps_tree_index_random(tree, rnd); }
+	static inline elem_t *find(const tree_t *tree, struct key_data *key)
+	{ return bps_tree_index_find(tree, key); }
+	static inline int insert(tree_t *tree, elem_t elem, elem_t *replaced)
+	{ return bps_tree_index_insert(tree, elem, replaced); }
+	static inline int remove(tree_t *tree, elem_t elem)
+	{ return bps_tree_index_delete(tree, elem); }
+	static inline iterator_t invalid_iterator()
+	{ return bps_tree_index_invalid_iterator(); }
+	static inline iterator_t itr_first(const tree_t *tree)
+	{ return bps_tree_index_itr_first(tree); }
+	static inline iterator_t
+	lower_bound(const tree_t *tree, struct key_data *key, bool *exact)
+	{ return bps_tree_index_lower_bound(tree, key, exact); }
+	static inline iterator_t
+	upper_bound(const tree_t *tree, struct key_data *key, bool *exact)
+	{ return bps_tree_index_upper_bound(tree, key, exact); }
+	static inline elem_t *itr_get_elem(const tree_t *tree, iterator_t *itr)
+	{ return bps_tree_index_itr_get_elem(tree, itr); }
+	static inline bool itr_next(const tree_t *tree, iterator_t *itr)
+	{ return bps_tree_index_itr_next(tree, itr); }
+	static inline bool itr_prev(const tree_t *tree, iterator_t *itr)
+	{ return bps_tree_index_itr_prev(tree, itr); }
+	static inline void itr_freeze(tree_t *tree, iterator_t *itr)
+	{ bps_tree_index_itr_freeze(tree, itr); }
+	static inline void itr_destroy(tree_t *tree, iterator_t *itr)
+	{ bps_tree_index_itr_destroy(tree, itr); }
+};
+
+struct memtx_tree_hint {
+	typedef struct memtx_tree_data elem_t;
+	typedef struct bps_tree_index_hint tree_t;
+	typedef struct bps_tree_index_hint_iterator iterator_t;
+
+	static inline elem_t
+	make_elem(struct tuple *tuple, struct key_def *key_def)
+	{
+		struct memtx_tree_data elem;
+		elem.tuple = tuple;
+		elem.hint = tree_tuple_hint(tuple, key_def);
+		return elem;
+	}
+	static inline struct tuple *
+	elem_tuple(const elem_t *elem)
+	{ return elem->tuple; }
+	static inline int
+	compare_key(const elem_t *elem, const struct key_data *key,
+		    struct key_def *key_def)
+	{ return tree_index_compare_key_hint(*elem, key, key_def); }
+	static int
+	qcompare(const void *a, const void *b, void *arg)
+	{ return tree_index_qcompare_hint(a, b, arg); }
+
+	static inline void
+	create(tree_t *tree, struct key_def *key_def)
+	{
+		bps_tree_index_hint_create(tree, key_def,
+					   memtx_index_extent_alloc,
+					   memtx_index_extent_free);
+	}
+	static inline void destroy(tree_t *tree)
+	{ bps_tree_index_hint_destroy(tree); }
+	static inline int build(tree_t *tree, elem_t *array, size_t size)
+	{ return bps_tree_index_hint_build(tree, array, size); }
+	static inline size_t size(const tree_t *tree)
+	{ return bps_tree_index_hint_size(tree); }
+	static inline size_t mem_used(const tree_t *tree)
+	{ return bps_tree_index_hint_mem_used(tree); }
+	static inline elem_t *random(const tree_t *tree, size_t rnd)
+	{ return bps_tree_index_hint_random(tree, rnd); }
+	static inline elem_t *find(const tree_t *tree, struct key_data *key)
+	{ return bps_tree_index_hint_find(tree, key); }
+	static inline int insert(tree_t *tree, elem_t elem, elem_t *replaced)
+	{ return bps_tree_index_hint_insert(tree, elem, replaced); }
+	static inline int remove(tree_t *tree, elem_t elem)
+	{ return bps_tree_index_hint_delete(tree, elem); }
+	static inline iterator_t invalid_iterator()
+	{ return bps_tree_index_hint_invalid_iterator(); }
+	static inline iterator_t itr_first(const tree_t *tree)
+	{ return bps_tree_index_hint_itr_first(tree); }
+	static inline iterator_t
+	lower_bound(const tree_t *tree, struct key_data *key, bool *exact)
+	{ return bps_tree_index_hint_lower_bound(tree, key, exact); }
+	static inline iterator_t
+	upper_bound(const tree_t *tree, struct key_data *key, bool *exact)
+	{ return bps_tree_index_hint_upper_bound(tree, key, exact); }
+	static inline elem_t *itr_get_elem(const tree_t *tree, iterator_t *itr)
+	{ return bps_tree_index_hint_itr_get_elem(tree, itr); }
+	static inline bool itr_next(const tree_t *tree, iterator_t *itr)
+	{ return bps_tree_index_hint_itr_next(tree, itr); }
+	static inline bool itr_prev(const tree_t *tree, iterator_t *itr)
+	{ return bps_tree_index_hint_itr_prev(tree, itr); }
+	static inline void itr_freeze(tree_t *tree, iterator_t *itr)
+	{ bps_tree_index_hint_itr_freeze(tree, itr); }
+	static inline void itr_destroy(tree_t *tree, iterator_t *itr)
+	{ bps_tree_index_hint_itr_destroy(tree, itr); }
+};
+
+/* }}} */
 
 /* {{{ MemtxTree Iterators ****************************************/
-struct tree_iterator {
+template <class Tree>
+struct memtx_tree_iterator {
 	struct iterator base;
-	const struct bps_tree_index *tree;
+	const typename Tree::tree_t *tree;
 	struct key_def *key_def;
-	struct bps_tree_index_iterator bps_tree_iter;
+	typename Tree::iterator_t bps_tree_iter;
 	struct key_data key_data;
 };
 
+template <class Tree>
 static void
 tree_iterator_free(struct iterator *iterator);
 
-static inline struct tree_iterator *
+template <class Tree>
+static inline struct memtx_tree_iterator<Tree> *
 tree_iterator(struct iterator *it)
 {
-	assert(it->free == tree_iterator_free);
-	return (struct tree_iterator *) it;
+	assert(it->free == tree_iterator_free<Tree>);
+	return (struct memtx_tree_iterator<Tree> *) it;
 }
 
+template <class Tree>
 static void
 tree_iterator_free(struct iterator *iterator)
 {
@@ -98,161 +324,228 @@ tree_iterator_dummie(struct iterator *iterator)
 	return 0;
 }
 
+template <class Tree>
 static struct tuple *
 tree_iterator_fwd(struct iterator *iterator)
 {
-	struct tree_iterator *it = tree_iterator(iterator);
-	tuple **res = bps_tree_index_itr_get_elem(it->tree, &it->bps_tree_iter);
+	struct memtx_tree_iterator<Tree> *it = tree_iterator<Tree>(iterator);
+	typename Tree::elem_t *res =
+		Tree::itr_get_elem(it->tree, &it->bps_tree_iter);
 	if (!res)
 		return 0;
-	bps_tree_index_itr_next(it->tree, &it->bps_tree_iter);
-	return *res;
+	Tree::itr_next(it->tree, &it->bps_tree_iter);
+	return Tree::elem_tuple(res);
 }
 
+template <class Tree>
 static struct tuple *
 tree_iterator_bwd(struct iterator *iterator)
 {
-	struct tree_iterator *it = tree_iterator(iterator);
-	tuple **res = bps_tree_index_itr_get_elem(it->tree, &it->bps_tree_iter);
+	struct memtx_tree_iterator<Tree> *it = tree_iterator<Tree>(iterator);
+	typename Tree::elem_t *res =
+		Tree::itr_get_elem(it->tree, &it->bps_tree_iter);
 	if (!res)
 		return 0;
-	bps_tree_index_itr_prev(it->tree, &it->bps_tree_iter);
-	return *res;
+	Tree::itr_prev(it->tree, &it->bps_tree_iter);
+	return Tree::elem_tuple(res);
 }
 
+template <class Tree>
 static struct tuple *
 tree_iterator_fwd_check_equality(struct iterator *iterator)
 {
-	struct tree_iterator *it = tree_iterator(iterator);
-	tuple **res = bps_tree_index_itr_get_elem(it->tree, &it->bps_tree_iter);
+	struct memtx_tree_iterator<Tree> *it = tree_iterator<Tree>(iterator);
+	typename Tree::elem_t *res =
+		Tree::itr_get_elem(it->tree, &it->bps_tree_iter);
 	if (!res)
 		return 0;
-	if (tree_index_compare_key(*res, &it->key_data, it->key_def) != 0) {
-		it->bps_tree_iter = bps_tree_index_invalid_iterator();
+	if (Tree::compare_key(res, &it->key_data, it->key_def) != 0) {
+		it->bps_tree_iter = Tree::invalid_iterator();
 		return 0;
 	}
-	bps_tree_index_itr_next(it->tree, &it->bps_tree_iter);
-	return *res;
+	Tree::itr_next(it->tree, &it->bps_tree_iter);
+	return Tree::elem_tuple(res);
 }
 
+template <class Tree>
 static struct tuple *
 tree_iterator_fwd_check_next_equality(struct iterator *iterator)
 {
-	struct tree_iterator *it = tree_iterator(iterator);
-	tuple **res = bps_tree_index_itr_get_elem(it->tree, &it->bps_tree_iter);
+	struct memtx_tree_iterator<Tree> *it = tree_iterator<Tree>(iterator);
+	typename Tree::elem_t *res =
+		Tree::itr_get_elem(it->tree, &it->bps_tree_iter);
 	if (!res)
 		return 0;
-	bps_tree_index_itr_next(it->tree, &it->bps_tree_iter);
-	iterator->next = tree_iterator_fwd_check_equality;
-	return *res;
+	Tree::itr_next(it->tree, &it->bps_tree_iter);
+	iterator->next = tree_iterator_fwd_check_equality<Tree>;
+	return Tree::elem_tuple(res);
 }
 
+template <class Tree>
 static struct tuple *
 tree_iterator_bwd_skip_one(struct iterator *iterator)
 {
-	struct tree_iterator *it = tree_iterator(iterator);
-	bps_tree_index_itr_prev(it->tree, &it->bps_tree_iter);
-	iterator->next = tree_iterator_bwd;
-	return tree_iterator_bwd(iterator);
+	struct memtx_tree_iterator<Tree> *it = tree_iterator<Tree>(iterator);
+	Tree::itr_prev(it->tree, &it->bps_tree_iter);
+	iterator->next = tree_iterator_bwd<Tree>;
+	return tree_iterator_bwd<Tree>(iterator);
 }
 
+template <class Tree>
 static struct tuple *
 tree_iterator_bwd_check_equality(struct iterator *iterator)
 {
-	struct tree_iterator *it = tree_iterator(iterator);
-	tuple **res = bps_tree_index_itr_get_elem(it->tree, &it->bps_tree_iter);
+	struct memtx_tree_iterator<Tree> *it = tree_iterator<Tree>(iterator);
+	typename Tree::elem_t *res =
+		Tree::itr_get_elem(it->tree, &it->bps_tree_iter);
 	if (!res)
 		return 0;
-	if (tree_index_compare_key(*res, &it->key_data, it->key_def) != 0) {
-		it->bps_tree_iter = bps_tree_index_invalid_iterator();
+	if (Tree::compare_key(res, &it->key_data, it->key_def) != 0) {
+		it->bps_tree_iter = Tree::invalid_iterator();
 		return 0;
 	}
-	bps_tree_index_itr_prev(it->tree, &it->bps_tree_iter);
-	return *res;
+	Tree::itr_prev(it->tree, &it->bps_tree_iter);
+	return Tree::elem_tuple(res);
 }
 
+template <class Tree>
 static struct tuple *
 tree_iterator_bwd_skip_one_check_next_equality(struct iterator *iterator)
 {
-	struct tree_iterator *it = tree_iterator(iterator);
-	bps_tree_index_itr_prev(it->tree, &it->bps_tree_iter);
-	iterator->next = tree_iterator_bwd_check_equality;
-	return tree_iterator_bwd_check_equality(iterator);
+	struct memtx_tree_iterator<Tree> *it = tree_iterator<Tree>(iterator);
+	Tree::itr_prev(it->tree, &it->bps_tree_iter);
+	iterator->next = tree_iterator_bwd_check_equality<Tree>;
+	return tree_iterator_bwd_check_equality<Tree>(iterator);
 }
 /* }}} */
 
 /* {{{ MemtxTree  **********************************************************/
 
-MemtxTree::MemtxTree(struct key_def *key_def_arg)
-	: MemtxIndex(key_def_arg), build_array(0), build_array_size(0),
-	  build_array_alloc_size(0)
+template <class Tree>
+class MemtxTreeImpl: public MemtxTree {
+public:
+	MemtxTreeImpl(struct key_def *key_def);
+	virtual ~MemtxTreeImpl() override;
+
+	virtual void beginBuild() override;
+	virtual void reserve(uint32_t size_hint) override;
+	virtual void buildNext(struct tuple *tuple) override;
+	virtual void endBuild() override;
+	virtual void sortBuild() override;
+	virtual size_t size() const override;
+	virtual struct tuple *random(uint32_t rnd) const override;
+	virtual struct tuple *findByKey(const char *key,
+					uint32_t part_count) const override;
+	virtual struct tuple *replace(struct tuple *old_tuple,
+				      struct tuple *new_tuple,
+				      enum dup_replace_mode mode) override;
+
+	virtual size_t bsize() const override;
+	virtual struct iterator *allocIterator() const override;
+	virtual void initIterator(struct iterator *iterator,
+				  enum iterator_type type,
+				  const char *key,
+				  uint32_t part_count) const override;
+
+	/**
+	 * Create a read view for iterator so further index modifications
+	 * will not affect the iterator iteration.
+	 */
+	virtual void createReadViewForIterator(struct iterator *iterator) override;
+	/**
+	 * Destroy a read view of an iterator. Must be called for iterators,
+	 * for which createReadViewForIterator was called.
+	 */
+	virtual void destroyReadViewForIterator(struct iterator *iterator) override;
+
+private:
+	typedef typename Tree::elem_t elem_t;
+
+	typename Tree::tree_t tree;
+	elem_t *build_array;
+	size_t build_array_size, build_array_alloc_size;
+	/** True if build_array has been sorted by sortBuild(). */
+	bool build_array_is_sorted;
+};
+
+template <class Tree>
+MemtxTreeImpl<Tree>::MemtxTreeImpl(struct key_def *key_def_arg)
+	: MemtxTree(key_def_arg), build_array(0), build_array_size(0),
+	  build_array_alloc_size(0), build_array_is_sorted(false)
 {
 	memtx_index_arena_init();
-	bps_tree_index_create(&tree, key_def,
-			      memtx_index_extent_alloc,
-			      memtx_index_extent_free);
+	Tree::create(&tree, key_def);
 }
 
-MemtxTree::~MemtxTree()
+template <class Tree>
+MemtxTreeImpl<Tree>::~MemtxTreeImpl()
 {
-	bps_tree_index_destroy(&tree);
+	Tree::destroy(&tree);
 	free(build_array);
 }
 
+template <class Tree>
 size_t
-MemtxTree::size() const
+MemtxTreeImpl<Tree>::size() const
 {
-	return bps_tree_index_size(&tree);
+	return Tree::size(&tree);
 }
 
+template <class Tree>
 size_t
-MemtxTree::bsize() const
+MemtxTreeImpl<Tree>::bsize() const
 {
-	return bps_tree_index_mem_used(&tree);
+	return Tree::mem_used(&tree);
 }
 
+template <class Tree>
 struct tuple *
-MemtxTree::random(uint32_t rnd) const
+MemtxTreeImpl<Tree>::random(uint32_t rnd) const
 {
-	struct tuple **res = bps_tree_index_random(&tree, rnd);
-	return res ? *res : 0;
+	elem_t *res = Tree::random(&tree, rnd);
+	return res ? Tree::elem_tuple(res) : 0;
 }
 
+template <class Tree>
 struct tuple *
-MemtxTree::findByKey(const char *key, uint32_t part_count) const
+MemtxTreeImpl<Tree>::findByKey(const char *key, uint32_t part_count) const
 {
 	assert(key_def->opts.is_unique && part_count == key_def->part_count);
 
 	struct key_data key_data;
 	key_data.key = key;
 	key_data.part_count = part_count;
-	struct tuple **res = bps_tree_index_find(&tree, &key_data);
-	return res ? *res : 0;
+	key_data.hint = tree_key_hint(key, part_count, key_def);
+	elem_t *res = Tree::find(&tree, &key_data);
+	return res ? Tree::elem_tuple(res) : 0;
 }
 
+template <class Tree>
 struct tuple *
-MemtxTree::replace(struct tuple *old_tuple, struct tuple *new_tuple,
-		   enum dup_replace_mode mode)
+MemtxTreeImpl<Tree>::replace(struct tuple *old_tuple, struct tuple *new_tuple,
+			     enum dup_replace_mode mode)
 {
 	uint32_t errcode;
 
 	if (new_tuple) {
-		struct tuple *dup_tuple = NULL;
+		elem_t new_elem = Tree::make_elem(new_tuple, key_def);
+		elem_t dup_elem;
+		memset(&dup_elem, 0, sizeof(dup_elem));
 
 		/* Try to optimistically replace the new_tuple. */
-		int tree_res =
-		bps_tree_index_insert(&tree, new_tuple, &dup_tuple);
+		int tree_res = Tree::insert(&tree, new_elem, &dup_elem);
 		if (tree_res) {
 			tnt_raise(OutOfMemory, BPS_TREE_EXTENT_SIZE,
 				  "MemtxTree", "replace");
 		}
+		struct tuple *dup_tuple = Tree::elem_tuple(&dup_elem);
 
 		errcode = replace_check_dup(old_tuple, dup_tuple, mode);
 
 		if (errcode) {
-			bps_tree_index_delete(&tree, new_tuple);
+			Tree::remove(&tree, new_elem);
 			if (dup_tuple)
-				bps_tree_index_insert(&tree, dup_tuple, 0);
+				Tree::insert(&tree, dup_elem, 0);
 			struct space *sp = space_cache_find(key_def->space_id);
 			tnt_raise(ClientError, errcode, index_name(this),
 				  space_name(sp));
@@ -260,35 +553,37 @@ MemtxTree::replace(struct tuple *old_tuple, struct tuple *new_tuple,
 		if (dup_tuple)
 			return dup_tuple;
 	}
-	if (old_tuple) {
-		bps_tree_index_delete(&tree, old_tuple);
-	}
+	if (old_tuple)
+		Tree::remove(&tree, Tree::make_elem(old_tuple, key_def));
 	return old_tuple;
 }
 
+template <class Tree>
 struct iterator *
-MemtxTree::allocIterator() const
+MemtxTreeImpl<Tree>::allocIterator() const
 {
-	struct tree_iterator *it = (struct tree_iterator *)
+	struct memtx_tree_iterator<Tree> *it = (struct memtx_tree_iterator<Tree> *)
 			calloc(1, sizeof(*it));
 	if (it == NULL) {
-		tnt_raise(OutOfMemory, sizeof(struct tree_iterator),
+		tnt_raise(OutOfMemory, sizeof(struct memtx_tree_iterator<Tree>),
 			  "MemtxTree", "iterator");
 	}
 
 	it->key_def = key_def;
 	it->tree = &tree;
-	it->base.free = tree_iterator_free;
-	it->bps_tree_iter = bps_tree_index_invalid_iterator();
+	it->base.free = tree_iterator_free<Tree>;
+	it->bps_tree_iter = Tree::invalid_iterator();
 	return (struct iterator *) it;
 }
 
+template <class Tree>
 void
-MemtxTree::initIterator(struct iterator *iterator, enum iterator_type type,
-			const char *key, uint32_t part_count) const
+MemtxTreeImpl<Tree>::initIterator(struct iterator *iterator,
+				  enum iterator_type type,
+				  const char *key, uint32_t part_count) const
 {
 	assert(part_count == 0 || key != NULL);
-	struct tree_iterator *it = tree_iterator(iterator);
+	struct memtx_tree_iterator<Tree> *it = tree_iterator<Tree>(iterator);
 
 	if (part_count == 0) {
 		/*
@@ -304,22 +599,23 @@ MemtxTree::initIterator(struct iterator *iterator, enum iterator_type type,
 	}
 	it->key_data.key = key;
 	it->key_data.part_count = part_count;
+	it->key_data.hint = tree_key_hint(key, part_count, key_def);
 
 	bool exact = false;
 	if (key == 0) {
 		if (iterator_type_is_reverse(type))
-			it->bps_tree_iter = bps_tree_index_invalid_iterator();
+			it->bps_tree_iter = Tree::invalid_iterator();
 		else
-			it->bps_tree_iter = bps_tree_index_itr_first(&tree);
+			it->bps_tree_iter = Tree::itr_first(&tree);
 	} else {
 		if (type == ITER_ALL || type == ITER_EQ || type == ITER_GE || type == ITER_LT) {
-			it->bps_tree_iter = bps_tree_index_lower_bound(&tree, &it->key_data, &exact);
+			it->bps_tree_iter = Tree::lower_bound(&tree, &it->key_data, &exact);
 			if (type == ITER_EQ && !exact) {
 				it->base.next = tree_iterator_dummie;
 				return;
 			}
 		} else { // ITER_GT, ITER_REQ, ITER_LE
-			it->bps_tree_iter = bps_tree_index_upper_bound(&tree, &it->key_data, &exact);
+			it->bps_tree_iter = Tree::upper_bound(&tree, &it->key_data, &exact);
 			if (type == ITER_REQ && !exact) {
 				it->base.next = tree_iterator_dummie;
 				return;
@@ -329,98 +625,135 @@ MemtxTree::initIterator(struct iterator *iterator, enum iterator_type type,
 
 	switch (type) {
 	case ITER_EQ:
-		it->base.next = tree_iterator_fwd_check_next_equality;
+		it->base.next = tree_iterator_fwd_check_next_equality<Tree>;
 		break;
 	case ITER_REQ:
-		it->base.next = tree_iterator_bwd_skip_one_check_next_equality;
+		it->base.next =
+			tree_iterator_bwd_skip_one_check_next_equality<Tree>;
 		break;
 	case ITER_ALL:
 	case ITER_GE:
-		it->base.next = tree_iterator_fwd;
+		it->base.next = tree_iterator_fwd<Tree>;
 		break;
 	case ITER_GT:
-		it->base.next = tree_iterator_fwd;
+		it->base.next = tree_iterator_fwd<Tree>;
 		break;
 	case ITER_LE:
-		it->base.next = tree_iterator_bwd_skip_one;
+		it->base.next = tree_iterator_bwd_skip_one<Tree>;
 		break;
 	case ITER_LT:
-		it->base.next = tree_iterator_bwd_skip_one;
+		it->base.next = tree_iterator_bwd_skip_one<Tree>;
 		break;
 	default:
 		return Index::initIterator(iterator, type, key, part_count);
 	}
 }
 
+template <class Tree>
 void
-MemtxTree::beginBuild()
+MemtxTreeImpl<Tree>::beginBuild()
 {
-	assert(bps_tree_index_size(&tree) == 0);
+	assert(Tree::size(&tree) == 0);
 }
 
+template <class Tree>
 void
-MemtxTree::reserve(uint32_t size_hint)
+MemtxTreeImpl<Tree>::reserve(uint32_t size_hint)
 {
 	if (size_hint < build_array_alloc_size)
 		return;
-	build_array = (struct tuple**)
-		realloc(build_array, size_hint * sizeof(struct tuple *));
+	size_t size = size_hint * sizeof(build_array[0]);
+	elem_t *tmp = (elem_t *) realloc(build_array, size);
+	if (tmp == NULL)
+		tnt_raise(OutOfMemory, size, "realloc", "build_array");
+	build_array = tmp;
 	build_array_alloc_size = size_hint;
 }
 
+template <class Tree>
 void
-MemtxTree::buildNext(struct tuple *tuple)
+MemtxTreeImpl<Tree>::buildNext(struct tuple *tuple)
 {
 	if (!build_array) {
-		build_array = (struct tuple**)malloc(BPS_TREE_EXTENT_SIZE);
+		build_array = (elem_t *) malloc(BPS_TREE_EXTENT_SIZE);
+		if (build_array == NULL) {
+			tnt_raise(OutOfMemory, BPS_TREE_EXTENT_SIZE,
+				  "malloc", "build_array");
+		}
 		build_array_alloc_size =
-			BPS_TREE_EXTENT_SIZE / sizeof(struct tuple*);
+			BPS_TREE_EXTENT_SIZE / sizeof(build_array[0]);
 	}
 	assert(build_array_size <= build_array_alloc_size);
 	if (build_array_size == build_array_alloc_size) {
-		build_array_alloc_size = build_array_alloc_size +
-					 build_array_alloc_size / 2;
-		build_array = (struct tuple**)
-			realloc(build_array,
-				build_array_alloc_size *
-				sizeof(struct tuple *));
+		uint32_t alloc_size = build_array_alloc_size +
+				      build_array_alloc_size / 2;
+		size_t size = alloc_size * sizeof(build_array[0]);
+		elem_t *tmp = (elem_t *) realloc(build_array, size);
+		if (tmp == NULL)
+			tnt_raise(OutOfMemory, size, "realloc", "build_array");
+		build_array = tmp;
+		build_array_alloc_size = alloc_size;
 	}
-	build_array[build_array_size++] = tuple;
+	build_array[build_array_size++] = Tree::make_elem(tuple, key_def);
+	build_array_is_sorted = false;
 }
 
+template <class Tree>
 void
-MemtxTree::endBuild()
+MemtxTreeImpl<Tree>::sortBuild()
 {
-	qsort_arg(build_array, build_array_size, sizeof(struct tuple *), tree_index_qcompare, key_def);
-	bps_tree_index_build(&tree, build_array, build_array_size);
+	qsort_arg(build_array, build_array_size, sizeof(build_array[0]),
+		  Tree::qcompare, key_def);
+	build_array_is_sorted = true;
+}
+
+template <class Tree>
+void
+MemtxTreeImpl<Tree>::endBuild()
+{
+	if (!build_array_is_sorted)
+		sortBuild();
+	Tree::build(&tree, build_array, build_array_size);
 
 	free(build_array);
 	build_array = 0;
 	build_array_size = 0;
 	build_array_alloc_size = 0;
+	build_array_is_sorted = false;
 }
 
 /**
  * Create a read view for iterator so further index modifications
  * will not affect the iterator iteration.
  */
+template <class Tree>
 void
-MemtxTree::createReadViewForIterator(struct iterator *iterator)
+MemtxTreeImpl<Tree>::createReadViewForIterator(struct iterator *iterator)
 {
-	struct tree_iterator *it = tree_iterator(iterator);
-	struct bps_tree_index *tree = (struct bps_tree_index *)it->tree;
-	bps_tree_index_itr_freeze(tree, &it->bps_tree_iter);
+	struct memtx_tree_iterator<Tree> *it = tree_iterator<Tree>(iterator);
+	typename Tree::tree_t *tree = (typename Tree::tree_t *)it->tree;
+	Tree::itr_freeze(tree, &it->bps_tree_iter);
 }
 
 /**
  * Destroy a read view of an iterator. Must be called for iterators,
  * for which createReadViewForIterator was called.
  */
+template <class Tree>
 void
-MemtxTree::destroyReadViewForIterator(struct iterator *iterator)
+MemtxTreeImpl<Tree>::destroyReadViewForIterator(struct iterator *iterator)
+{
+	struct memtx_tree_iterator<Tree> *it = tree_iterator<Tree>(iterator);
+	typename Tree::tree_t *tree = (typename Tree::tree_t *)it->tree;
+	Tree::itr_destroy(tree, &it->bps_tree_iter);
+}
+
+MemtxTree *
+memtx_tree_new(struct key_def *key_def)
 {
-	struct tree_iterator *it = tree_iterator(iterator);
-	struct bps_tree_index *tree = (struct bps_tree_index *)it->tree;
-	bps_tree_index_itr_destroy(tree, &it->bps_tree_iter);
+	if (key_def->opts.hint)
+		return new MemtxTreeImpl<memtx_tree_hint>(key_def);
+	return new MemtxTreeImpl<memtx_tree_plain>(key_def);
 }
 
+/* }}} */
@@ -37,12 +37,40 @@
 struct tuple;
 struct key_data;
 
+/**
+ * An element of a TREE index with the hint option. @hint holds
+ * an order-preserving prefix of the first key part of @tuple:
+ * for any two elements, hint(a) < hint(b) implies a < b, so the
+ * tuples need to be compared only if the hints are equal.
+ * Indexes without the option store bare tuple pointers, to
+ * keep their elements 8 bytes long.
+ */
+struct memtx_tree_data {
+	struct tuple *tuple;
+	uint64_t hint;
+};
+
+/** Used by the self-check code of the tree. */
+static inline bool
+operator!=(const struct memtx_tree_data &a, const struct memtx_tree_data &b)
+{
+	return a.tuple != b.tuple || a.hint != b.hint;
+}
+
 int
 tree_index_compare(const struct tuple *a, const struct tuple *b, struct key_def *key_def);
 
 int
 tree_index_compare_key(const tuple *a, const key_data *b, struct key_def *key_def);
 
+int
+tree_index_compare_hint(struct memtx_tree_data a, struct memtx_tree_data b,
+			struct key_def *key_def);
+
+int
+tree_index_compare_key_hint(struct memtx_tree_data a, const key_data *b,
+			    struct key_def *key_def);
+
 #define BPS_TREE_NAME _index
 #define BPS_TREE_BLOCK_SIZE (512)
 #define BPS_TREE_EXTENT_SIZE MEMTX_EXTENT_SIZE
@@ -54,45 +82,50 @@ tree_index_compare_key(const tuple *a, const key_data *b, struct key_def *key_de
 
 #include "salad/bps_tree.h"
 
+#undef BPS_TREE_NAME
+#undef BPS_TREE_BLOCK_SIZE
+#undef BPS_TREE_EXTENT_SIZE
+#undef BPS_TREE_COMPARE
+#undef BPS_TREE_COMPARE_KEY
+#undef bps_tree_elem_t
+#undef bps_tree_key_t
+#undef bps_tree_arg_t
+
+#define BPS_TREE_NAME _index_hint
+#define BPS_TREE_BLOCK_SIZE (512)
+#define BPS_TREE_EXTENT_SIZE MEMTX_EXTENT_SIZE
+#define BPS_TREE_COMPARE(a, b, arg) tree_index_compare_hint(a, b, arg)
+#define BPS_TREE_COMPARE_KEY(a, b, arg) tree_index_compare_key_hint(a, b, arg)
+#define bps_tree_elem_t struct memtx_tree_data
+#define bps_tree_key_t struct key_data *
+#define bps_tree_arg_t struct key_def *
+
+#include "salad/bps_tree.h"
+
+/**
+ * A TREE index. The implementation depends on the hint option,
+ * see memtx_tree_new().
+ */
 class MemtxTree: public MemtxIndex {
 public:
-	MemtxTree(struct key_def *key_def);
-	virtual ~MemtxTree() override;
-
-	virtual void beginBuild() override;
-	virtual void reserve(uint32_t size_hint) override;
-	virtual void buildNext(struct tuple *tuple) override;
-	virtual void endBuild() override;
-	virtual size_t size() const override;
-	virtual struct tuple *random(uint32_t rnd) const override;
-	virtual struct tuple *findByKey(const char *key,
-					uint32_t part_count) const override;
-	virtual struct tuple *replace(struct tuple *old_tuple,
-				      struct tuple *new_tuple,
-				      enum dup_replace_mode mode) override;
-
-	virtual size_t bsize() const override;
-	virtual struct iterator *allocIterator() const override;
-	virtual void initIterator(struct iterator *iterator,
-				  enum iterator_type type,
-				  const char *key,
-				  uint32_t part_count) const override;
-
+	MemtxTree(struct key_def *key_def)
+		:MemtxIndex(key_def)
+	{ }
 	/**
-	 * Create a read view for iterator so further index modifications
-	 * will not affect the iterator iteration.
+	 * Sort the tuples collected by buildNext(). Doesn't touch
+	 * the tree itself, so it is safe to call it from a thread
+	 * other than tx, e.g. to sort secondary keys of a space
+	 * concurrently on recovery. endBuild() skips the sort if
+	 * it has already been done.
 	 */
-	virtual void createReadViewForIterator(struct iterator *iterator) override;
-	/**
-	 * Destroy a read view of an iterator. Must be called for iterators,
-	 * for which createReadViewForIterator was called.
-	 */
-	virtual void destroyReadViewForIterator(struct iterator *iterator) override;
-
-// protected:
-	struct bps_tree_index tree;
-	struct tuple **build_array;
-	size_t build_array_size, build_array_alloc_size;
+	virtual void sortBuild() = 0;
 };
 
+/**
+ * Create a TREE index: a tree of (tuple, hint) pairs if the
+ * index has the hint option, a tree of tuples otherwise.
+ */
+MemtxTree *
+memtx_tree_new(struct key_def *key_def);
+
 #endif /* TARANTOOL_BOX_TREE_INDEX_H_INCLUDED */
@@ -36,8 +36,8 @@
 
 static struct mempool port_entry_pool;
 
-void
-port_add_tuple(struct port *port, struct tuple *tuple)
+static void
+port_list_add_tuple(struct port *port, struct tuple *tuple)
 {
 	struct port_entry *e;
 	if (port->size == 0) {
@@ -61,9 +61,14 @@ port_add_tuple(struct port *port, struct tuple *tuple)
 	++port->size;
 }
 
+static const struct port_vtab port_list_vtab = {
+	port_list_add_tuple,
+};
+
 void
 port_create(struct port *port)
 {
+	port->vtab = &port_list_vtab;
 	port->size = 0;
 	port->first = NULL;
 	port->last = NULL;
@@ -103,6 +108,30 @@ port_dump(struct port *port, struct obuf *out)
 	}
 }
 
+static void
+port_obuf_add_tuple(struct port *base, struct tuple *tuple)
+{
+	struct port_obuf *port = (struct port_obuf *) base;
+	/* Someone else could have written to the buffer. */
+	assert(fiber()->csw == port->csw);
+	if (tuple_to_obuf(tuple, port->out) != 0)
+		diag_raise();
+	++base->size;
+}
+
+static const struct port_vtab port_obuf_vtab = {
+	port_obuf_add_tuple,
+};
+
+void
+port_obuf_create(struct port_obuf *port, struct obuf *out)
+{
+	port_create(&port->base);
+	port->base.vtab = &port_obuf_vtab;
+	port->out = out;
+	port->csw = fiber()->csw;
+}
+
 void
 port_init(void)
 {
@@ -37,6 +37,8 @@ extern "C" {
 #endif /* defined(__cplusplus) */
 
 struct tuple;
+struct obuf;
+struct port;
 
 /**
  * A single port represents a destination of box_process output.
@@ -55,14 +57,24 @@ struct tuple;
  * dispatch: first, by the type of the port the tuple is being
  * added to, second, by the type of the tuple format, since the
  * format defines the internal structure of the tuple.
+ *
+ * The first dispatch is done with port_vtab. By default
+ * (port_create()) tuples are referenced and collected in a list
+ * which the caller walks or dumps when the request is done.
  */
 
+struct port_vtab {
+	void (*add_tuple)(struct port *port, struct tuple *tuple);
+};
+
 struct port_entry {
 	struct port_entry *next;
 	struct tuple *tuple;
 };
 
 struct port {
+	const struct port_vtab *vtab;
+	/** Number of tuples added to the port. */
 	size_t size;
 	struct port_entry *first;
 	struct port_entry *last;
@@ -81,8 +93,30 @@ port_destroy(struct port *port);
 void
 port_dump(struct port *port, struct obuf *out);
 
+static inline void
+port_add_tuple(struct port *port, struct tuple *tuple)
+{
+	port->vtab->add_tuple(port, tuple); /* throws */
+}
+
+/**
+ * A port which encodes tuples straight into an output buffer
+ * as they are produced, without referencing them or allocating
+ * a list entry per tuple.
+ *
+ * The producer must not yield while the port is in use:
+ * otherwise another fiber may write its own reply to the same
+ * buffer in between two tuples. See engine_can_stream().
+ */
+struct port_obuf {
+	struct port base;
+	struct obuf *out;
+	/** fiber()->csw at port creation, to catch yields. */
+	int csw;
+};
+
 void
-port_add_tuple(struct port *port, struct tuple *tuple);
+port_obuf_create(struct port_obuf *port, struct obuf *out);
 
 void
 port_init(void);
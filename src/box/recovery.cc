@@ -473,6 +473,51 @@ public:
 	}
 };
 
+/**
+ * Recover rows from the in-memory WAL tail, provided the
+ * recovery is close enough to the end of the WAL to find the
+ * rows it hasn't seen yet there.
+ *
+ * @param[in,out] pos  position in the WAL tail, -1 if unknown
+ * @retval 0 the recovery is up to date with the WAL
+ * @retval -1 the rows are not in memory, read them from files
+ */
+static int
+recover_wal_tail(struct recovery *r, struct xstream *stream, int64_t *pos)
+{
+	if (*pos < 0 && wal_tail_start(wal, &r->vclock, pos) != 0)
+		return -1;
+	char *data;
+	ssize_t size = wal_tail_read(wal, pos, &data);
+	if (size < 0) {
+		*pos = -1;
+		return -1;
+	}
+	if (r->current_wal != NULL) {
+		/*
+		 * The file position is stale now. Should the
+		 * tail be overwritten, the right file is found
+		 * by the recovery vclock.
+		 */
+		xlog_close(r->current_wal);
+		r->current_wal = NULL;
+	}
+	const char *end = data + size;
+	while (data < end) {
+		struct wal_tail_row hdr;
+		memcpy(&hdr, data, sizeof(hdr));
+		const char *row_data = data + sizeof(hdr);
+		data += sizeof(hdr) + hdr.len;
+		if (hdr.lsn <= vclock_get(&r->vclock, hdr.server_id))
+			continue;
+		struct xrow_header row;
+		xrow_header_decode(&row, &row_data, data);
+		xstream_write(stream, &row);
+	}
+	region_free(&fiber()->gc);
+	return 0;
+}
+
 static int
 recovery_follow_f(va_list ap)
 {
@@ -482,8 +527,12 @@ recovery_follow_f(va_list ap)
 	fiber_set_user(fiber(), &admin_credentials);
 
 	WalSubscription subscription(r->wal_dir.dirname);
+	/* Position in the in-memory WAL tail, -1 if not there. */
+	int64_t tail_pos = -1;
 
 	while (! fiber_is_cancelled()) {
+		if (recover_wal_tail(r, stream, &tail_pos) == 0)
+			goto wait;
 
 		/*
 		 * Recover until there is no new stuff which appeared in
@@ -516,7 +565,7 @@ recovery_follow_f(va_list ap)
 
 		subscription.set_log_path(r->current_wal != NULL ?
 					  r->current_wal->filename : NULL);
-
+wait:
 		if (subscription.signaled == false) {
 			/**
 			 * Allow an immediate wakeup/break loop
@@ -43,6 +43,12 @@
 #include "trigger.h"
 #include "errinj.h"
 #include "xrow_io.h"
+#include "clock.h"
+
+/** Hand the output buffer to the flusher once it is this big. */
+static const size_t RELAY_FLUSH_SIZE = 256 * 1024;
+/** Don't keep rows in the output buffer longer, in seconds. */
+static const double RELAY_FLUSH_TIMEOUT = 0.01;
 
 static void
 relay_send_initial_join_row(struct xstream *stream, struct xrow_header *row);
@@ -67,6 +73,104 @@ relay_destroy(struct relay *relay)
 	(void) relay;
 }
 
+/**
+ * Send output buffers to the replica as soon as the relay
+ * yields, or as soon as a buffer gets full.
+ */
+static int
+relay_flusher_f(va_list ap)
+{
+	struct relay *relay = va_arg(ap, struct relay *);
+	auto guard = make_scoped_guard([=]{
+		/* Let the waiter see the error. */
+		if (relay->waiter != NULL)
+			fiber_wakeup(relay->waiter);
+	});
+	while (! fiber_is_cancelled()) {
+		struct obuf *buf = relay->out;
+		if (obuf_size(buf) == 0) {
+			relay->flusher_is_idle = true;
+			if (relay->waiter != NULL)
+				fiber_wakeup(relay->waiter);
+			fiber_set_cancellable(true);
+			fiber_yield();
+			fiber_set_cancellable(false);
+			continue;
+		}
+		relay->out = buf == &relay->obuf[0] ?
+			     &relay->obuf[1] : &relay->obuf[0];
+		relay->last_flush = clock_monotonic();
+		if (relay->waiter != NULL)
+			fiber_wakeup(relay->waiter);
+		coio_writev(&relay->io, buf->iov, obuf_iovcnt(buf),
+			    obuf_size(buf));
+		obuf_reset(buf);
+	}
+	return 0;
+}
+
+/**
+ * Hand the output buffer over to the flusher. If @a sync is
+ * set, wait until all buffered rows are sent as well.
+ */
+static void
+relay_flush(struct relay *relay, bool sync)
+{
+	struct obuf *buf = relay->out;
+	while (sync ? obuf_size(relay->out) > 0 || ! relay->flusher_is_idle :
+		      relay->out == buf && obuf_size(buf) > 0) {
+		if (relay->flusher == NULL)
+			tnt_raise(FiberIsCancelled);
+		if (fiber_is_dead(relay->flusher)) {
+			/* Failed to write to the replica. */
+			fiber_join(relay->flusher);
+			relay->flusher = NULL;
+			if (diag_is_empty(&fiber()->diag))
+				tnt_raise(FiberIsCancelled);
+			diag_raise();
+		}
+		if (relay->flusher_is_idle) {
+			relay->flusher_is_idle = false;
+			fiber_wakeup(relay->flusher);
+		}
+		relay->waiter = fiber();
+		fiber_yield();
+		relay->waiter = NULL;
+	}
+}
+
+static void
+relay_start_output(struct relay *relay)
+{
+	obuf_create(&relay->obuf[0], &cord()->slabc, RELAY_FLUSH_SIZE);
+	obuf_create(&relay->obuf[1], &cord()->slabc, RELAY_FLUSH_SIZE);
+	relay->out = &relay->obuf[0];
+	relay->waiter = NULL;
+	relay->flusher_is_idle = false;
+	relay->last_flush = clock_monotonic();
+	relay->flusher = fiber_new_xc("relay_flusher", relay_flusher_f);
+	fiber_set_joinable(relay->flusher, true);
+	fiber_start(relay->flusher, relay);
+}
+
+/** Stop the flusher, dropping the rows which haven't been sent. */
+static void
+relay_stop_output(struct relay *relay)
+{
+	if (relay->flusher != NULL) {
+		/* Keep the error being raised, if any. */
+		struct diag diag;
+		diag_create(&diag);
+		diag_move(&fiber()->diag, &diag);
+		fiber_cancel(relay->flusher);
+		fiber_join(relay->flusher);
+		diag_move(&diag, &fiber()->diag);
+		relay->flusher = NULL;
+	}
+	obuf_destroy(&relay->obuf[0]);
+	obuf_destroy(&relay->obuf[1]);
+}
+
 static inline void
 relay_set_cord_name(int fd)
 {
@@ -84,10 +188,15 @@ relay_initial_join_f(va_list ap)
 {
 	struct relay *relay = va_arg(ap, struct relay *);
 	relay_set_cord_name(relay->io.fd);
+	relay_start_output(relay);
+	auto output_guard = make_scoped_guard([=]{
+		relay_stop_output(relay);
+	});
 
 	/* Send snapshot */
 	assert(relay->stream.write != NULL);
 	engine_join(&relay->stream);
+	relay_flush(relay, true);
 
 	return 0;
 }
@@ -111,12 +220,17 @@ relay_final_join_f(va_list ap)
 {
 	struct relay *relay = va_arg(ap, struct relay *);
 	relay_set_cord_name(relay->io.fd);
+	relay_start_output(relay);
+	auto output_guard = make_scoped_guard([=]{
+		relay_stop_output(relay);
+	});
 
 	/* Send all WALs until stop_vclock */
 	assert(relay->stream.write != NULL);
 	xdir_scan_xc(&relay->r->wal_dir);
 	recover_remaining_wals(relay->r, &relay->stream, &relay->stop_vclock);
 	assert(vclock_compare(&relay->r->vclock, &relay->stop_vclock) == 0);
+	relay_flush(relay, true);
 	return 0;
 }
 
@@ -159,6 +273,10 @@ relay_subscribe_f(va_list ap)
 
 	relay->stream.write = relay_send_subscribe_row;
 	relay_set_cord_name(relay->io.fd);
+	relay_start_output(relay);
+	auto output_guard = make_scoped_guard([=]{
+		relay_stop_output(relay);
+	});
 	recovery_follow_local(r, &relay->stream, fiber_name(fiber()),
 			      relay->wal_dir_rescan_delay);
 
@@ -247,11 +365,26 @@ relay_subscribe(int fd, uint64_t sync, struct server *server,
 	diag_raise();
 }
 
+/**
+ * Encode a row into the output buffer. The buffer is sent
+ * by the flusher as soon as the relay yields, so rows read
+ * in one go are sent with a few large writes.
+ */
 static void
 relay_send(struct relay *relay, struct xrow_header *packet)
 {
 	packet->sync = relay->sync;
-	coio_write_xrow(&relay->io, packet);
+	struct iovec iov[XROW_IOVMAX];
+	int iovcnt = xrow_to_iovec(packet, iov);
+	for (int i = 0; i < iovcnt; i++)
+		obuf_dup_xc(relay->out, iov[i].iov_base, iov[i].iov_len);
+	if (obuf_size(relay->out) >= RELAY_FLUSH_SIZE ||
+	    clock_monotonic() - relay->last_flush >= RELAY_FLUSH_TIMEOUT) {
+		relay_flush(relay, false);
+	} else if (relay->flusher_is_idle) {
+		relay->flusher_is_idle = false;
+		fiber_wakeup(relay->flusher);
+	}
 }
 
 static void
@@ -261,6 +394,7 @@ relay_send_initial_join_row(struct xstream *stream, struct xrow_header *row)
 	relay_send(relay, row);
 	ERROR_INJECT(ERRINJ_RELAY,
 	{
+		relay_flush(relay, true);
 		fiber_sleep(1000.0);
 	});
 }
@@ -277,6 +411,7 @@ relay_send_final_join_row(struct xstream *stream, struct xrow_header *row)
 	relay_send(relay, row);
 	ERROR_INJECT(ERRINJ_RELAY,
 	{
+		relay_flush(relay, true);
 		fiber_sleep(1000.0);
 	});
 }
@@ -299,6 +434,7 @@ relay_send_subscribe_row(struct xstream *stream, struct xrow_header *packet)
 		relay_send(relay, packet);
 		ERROR_INJECT(ERRINJ_RELAY,
 		{
+			relay_flush(relay, true);
 			fiber_sleep(1000.0);
 		});
 	}
@@ -32,6 +32,7 @@
  */
 #include "evio.h"
 #include "fiber.h"
+#include "small/obuf.h"
 #include "vclock.h"
 #include "xstream.h"
 
@@ -50,6 +51,21 @@ struct relay {
 	struct xstream stream;
 	struct vclock stop_vclock;
 	ev_tstamp wal_dir_rescan_delay;
+	/**
+	 * Output buffers: rows are encoded into one of them,
+	 * while the flusher sends the other one to the replica.
+	 */
+	struct obuf obuf[2];
+	/** The buffer rows are encoded into. */
+	struct obuf *out;
+	/** The fiber sending buffered rows to the replica. */
+	struct fiber *flusher;
+	/** Set while the flusher has nothing to send. */
+	bool flusher_is_idle;
+	/** The fiber waiting for the flusher, if any. */
+	struct fiber *waiter;
+	/** When the flusher last took a buffer to send. */
+	double last_flush;
 };
 
 /**
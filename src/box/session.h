@@ -73,6 +73,13 @@ struct session {
 	 * the first yield.
 	 */
 	uint64_t sync;
+	/**
+	 * The number of requests of the session's connection
+	 * in flight: queued in the network thread, processed in
+	 * tx or waiting to be sent. Updated atomically by the
+	 * network thread.
+	 */
+	int n_requests;
 	/** Authentication salt. */
 	char salt[SESSION_SEED_SIZE];
 	/** Cached user id and global grants */
@@ -79,6 +79,7 @@ SysviewSpace::executeUpsert(struct txn *, struct space *space, struct request *)
 SysviewEngine::SysviewEngine()
 	:Engine("sysview")
 {
+	flags = ENGINE_CAN_STREAM;
 }
 
 Handler *SysviewEngine::open()
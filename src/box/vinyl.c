@@ -69,6 +69,7 @@
 
 #include "trivia/util.h"
 #include "crc32.h"
+#include "third_party/PMurHash.h"
 #include "clock.h"
 #include "trivia/config.h"
 #include "tt_pthread.h"
@@ -100,6 +101,8 @@ struct vy_sequence;
 struct vy_conf;
 struct vy_quota;
 struct vy_cachepool;
+struct vy_page_cache;
+struct vy_read_pool;
 struct tx_manager;
 struct scheduler;
 struct vy_stat;
@@ -113,9 +116,12 @@ struct vinyl_env {
 	struct vy_conf      *conf;
 	struct vy_quota     *quota;
 	struct vy_cachepool *cachepool;
+	/* NULL if vinyl.page_cache is 0 */
+	struct vy_page_cache *page_cache;
 	struct tx_manager   *xm;
 	struct scheduler    *scheduler;
 	struct vy_stat      *stat;
+	struct vy_read_pool *read_pool;
 	struct mempool      read_task_pool;
 	struct mempool      cursor_pool;
 	struct cord *worker_pool;
@@ -618,8 +624,21 @@ struct vy_quota {
 	int wait;
 	int64_t limit;
 	int64_t used;
+	/* total memory released by dumps, for the dump rate */
+	int64_t released;
 	pthread_mutex_t lock;
-	pthread_cond_t cond;
+	/*
+	 * Fibers waiting for quota to be released.
+	 * Accessed in the tx thread only.
+	 */
+	struct rlist waiters;
+	/* wakes up the waiters when a worker releases quota */
+	struct ev_async async;
+	struct ev_loop *loop;
+	/* observed dump rate, bytes per second, tx thread only */
+	double dump_rate;
+	double rate_time;
+	int64_t rate_released;
 };
 
 static struct vy_quota *
@@ -657,6 +676,25 @@ vy_quota_used_percent(struct vy_quota *q)
 	return percent;
 }
 
+/**
+ * Check if adding v bytes moves memory usage to another
+ * compaction zone (zones are 10% wide) or over the limit,
+ * i.e. whether the scheduler may have new work to do.
+ */
+static inline bool
+vy_quota_crosses_zone(struct vy_quota *q, int64_t v)
+{
+	bool crosses = false;
+	tt_pthread_mutex_lock(&q->lock);
+	if (q->limit != 0) {
+		int64_t before = (q->used * 100) / q->limit / 10;
+		int64_t after = ((q->used + v) * 100) / q->limit / 10;
+		crosses = before != after || q->used + v >= q->limit;
+	}
+	tt_pthread_mutex_unlock(&q->lock);
+	return crosses;
+}
+
 /* range queue */
 
 struct ssrqnode {
@@ -1125,6 +1163,17 @@ static struct vy_filterif vy_filterif_lz4 =
 	.complete = vy_filter_lz4_complete
 };
 
+static void
+vy_quota_async_cb(ev_loop *loop, struct ev_async *watcher, int events)
+{
+	(void) loop;
+	(void) events;
+	struct vy_quota *q = (struct vy_quota *) watcher->data;
+	struct fiber *f, *tmp;
+	rlist_foreach_entry_safe(f, &q->waiters, state, tmp)
+		fiber_wakeup(f);
+}
+
 static struct vy_quota *
 vy_quota_new(int64_t limit)
 {
@@ -1137,16 +1186,25 @@ vy_quota_new(int64_t limit)
 	q->wait   = 0;
 	q->limit  = limit;
 	q->used   = 0;
+	q->released = 0;
+	q->dump_rate = 0;
+	q->rate_time = clock_monotonic();
+	q->rate_released = 0;
 	tt_pthread_mutex_init(&q->lock, NULL);
-	tt_pthread_cond_init(&q->cond, NULL);
+	rlist_create(&q->waiters);
+	q->loop = loop();
+	ev_async_init(&q->async, vy_quota_async_cb);
+	q->async.data = q;
+	ev_async_start(q->loop, &q->async);
 	return q;
 }
 
 static int
 vy_quota_delete(struct vy_quota *q)
 {
+	assert(rlist_empty(&q->waiters));
+	ev_async_stop(q->loop, &q->async);
 	tt_pthread_mutex_destroy(&q->lock);
-	tt_pthread_cond_destroy(&q->cond);
 	free(q);
 	return 0;
 }
@@ -1165,24 +1223,14 @@ vy_quota_op(struct vy_quota *q, enum vy_quotaop op, int64_t v)
 	tt_pthread_mutex_lock(&q->lock);
 	switch (op) {
 	case VINYL_QADD:
-		if (unlikely(!q->enable || q->limit == 0)) {
-			/*
-			 * Fall through to quota accounting, skip
-			 * the wait.
-			 */
-		} else {
-			while (q->used + v >= q->limit) {
-				q->wait++;
-				tt_pthread_cond_wait(&q->cond, &q->lock);
-				q->wait--;
-			}
-		}
+		/* writers are throttled in vy_quota_throttle() */
 		q->used += v;
 		break;
 	case VINYL_QREMOVE:
 		q->used -= v;
+		q->released += v;
 		if (q->wait) {
-			tt_pthread_cond_signal(&q->cond);
+			ev_async_send(q->loop, &q->async);
 		}
 		break;
 	}
@@ -1190,6 +1238,98 @@ vy_quota_op(struct vy_quota *q, enum vy_quotaop op, int64_t v)
 	return 0;
 }
 
+enum {
+	/** Memory usage percent at which writers are slowed down. */
+	VY_QUOTA_THROTTLE_WM = 75,
+};
+
+/** Max delay of a single write by the throttle, in seconds. */
+static const double VY_QUOTA_THROTTLE_MAX = 1.0;
+/** How often the dump rate is re-evaluated, in seconds. */
+static const double VY_QUOTA_RATE_PERIOD = 1.0;
+
+static void
+vy_quota_update_rate(struct vy_quota *q, int64_t released)
+{
+	double now = clock_monotonic();
+	double elapsed = now - q->rate_time;
+	if (elapsed < VY_QUOTA_RATE_PERIOD)
+		return;
+	if (released > q->rate_released) {
+		double rate = (released - q->rate_released) / elapsed;
+		if (q->dump_rate == 0)
+			q->dump_rate = rate;
+		else
+			q->dump_rate = (q->dump_rate + rate) / 2;
+	}
+	q->rate_released = released;
+	q->rate_time = now;
+}
+
+/**
+ * Called in the tx thread before a write of size bytes.
+ * Above VY_QUOTA_THROTTLE_WM percent of the limit, the writer
+ * sleeps for the time it takes to dump size bytes at the
+ * observed dump rate, scaled by how close memory usage is to
+ * the limit. When the limit is hit, the fiber waits until
+ * a dump releases memory. Only the writing fiber yields,
+ * the event loop keeps running.
+ *
+ * The wait doesn't account for size: a transaction bigger
+ * than the limit would never pass, so memory usage may
+ * exceed the limit by the size of a write.
+ *
+ * @retval 0 the write may proceed
+ * @retval -1 the fiber was cancelled while waiting
+ */
+static int
+vy_quota_throttle(struct vy_quota *q, int64_t size, double *throttled)
+{
+	*throttled = 0;
+	if (unlikely(!q->enable || q->limit == 0 || size == 0))
+		return 0;
+	double start = clock_monotonic();
+	tt_pthread_mutex_lock(&q->lock);
+	int64_t used = q->used;
+	int64_t released = q->released;
+	tt_pthread_mutex_unlock(&q->lock);
+
+	vy_quota_update_rate(q, released);
+	int64_t wm = q->limit / 100 * VY_QUOTA_THROTTLE_WM;
+	if (used > wm && used + size < q->limit && q->dump_rate > 0) {
+		double delay = size / q->dump_rate *
+			       (used - wm) / (q->limit - wm);
+		if (delay > VY_QUOTA_THROTTLE_MAX)
+			delay = VY_QUOTA_THROTTLE_MAX;
+		fiber_sleep(delay);
+		if (fiber_is_cancelled()) {
+			diag_set(FiberIsCancelled);
+			return -1;
+		}
+	}
+	while (true) {
+		tt_pthread_mutex_lock(&q->lock);
+		bool exceeded = q->used >= q->limit;
+		if (exceeded)
+			q->wait++;
+		tt_pthread_mutex_unlock(&q->lock);
+		if (! exceeded)
+			break;
+		rlist_add_tail_entry(&q->waiters, fiber(), state);
+		fiber_yield_timeout(TIMEOUT_INFINITY);
+		rlist_del_entry(fiber(), state);
+		tt_pthread_mutex_lock(&q->lock);
+		q->wait--;
+		tt_pthread_mutex_unlock(&q->lock);
+		if (fiber_is_cancelled()) {
+			diag_set(FiberIsCancelled);
+			return -1;
+		}
+	}
+	*throttled = clock_monotonic() - start;
+	return 0;
+}
+
 static int
 path_exists(const char *path)
 {
@@ -1465,12 +1605,18 @@ struct vy_stat {
 	struct vy_avg    get_read_disk;
 	struct vy_avg    get_read_cache;
 	struct vy_avg    get_latency;
+	/* bloom filter */
+	uint64_t bloom_skip;
+	uint64_t bloom_false_positive;
 	/* transaction */
 	uint64_t tx;
 	uint64_t tx_rlb;
 	uint64_t tx_conflict;
 	struct vy_avg    tx_latency;
 	struct vy_avg    tx_stmts;
+	/* write throttling, usec per transaction */
+	uint64_t throttled;
+	struct vy_avg    throttle_time;
 	/* cursor */
 	uint64_t cursor;
 	struct vy_avg    cursor_latency;
@@ -1509,6 +1655,7 @@ vy_stat_prepare(struct vy_stat *s)
 	vy_avg_prepare(&s->get_latency);
 	vy_avg_prepare(&s->tx_latency);
 	vy_avg_prepare(&s->tx_stmts);
+	vy_avg_prepare(&s->throttle_time);
 	vy_avg_prepare(&s->cursor_latency);
 	vy_avg_prepare(&s->cursor_read_disk);
 	vy_avg_prepare(&s->cursor_read_cache);
@@ -1532,6 +1679,15 @@ vy_stat_get(struct vy_stat *s, const struct vy_stat_get *statget)
 	tt_pthread_mutex_unlock(&s->lock);
 }
 
+static inline void
+vy_stat_bloom(struct vy_stat *s, uint32_t skip, uint32_t false_positive)
+{
+	tt_pthread_mutex_lock(&s->lock);
+	s->bloom_skip += skip;
+	s->bloom_false_positive += false_positive;
+	tt_pthread_mutex_unlock(&s->lock);
+}
+
 static inline void
 vy_stat_tx(struct vy_stat *s, uint64_t start, uint32_t count,
           int rlb, int conflict)
@@ -1546,6 +1702,16 @@ vy_stat_tx(struct vy_stat *s, uint64_t start, uint32_t count,
 	tt_pthread_mutex_unlock(&s->lock);
 }
 
+static inline void
+vy_stat_throttle(struct vy_stat *s, double throttled)
+{
+	tt_pthread_mutex_lock(&s->lock);
+	if (throttled > 0)
+		s->throttled++;
+	vy_avg_update(&s->throttle_time, throttled * 1000000);
+	tt_pthread_mutex_unlock(&s->lock);
+}
+
 static inline void
 vy_stat_cursor(struct vy_stat *s, uint64_t start, int read_disk, int read_cache, int ops)
 {
@@ -3587,9 +3753,21 @@ struct PACKED vy_page_info {
 	uint64_t max_lsn;
 };
 
+/**
+ * Bits of vy_page_index_header::extensions: which optional
+ * sections follow the page index (their total size is stored
+ * in vy_page_index_header::extension).
+ */
+enum {
+	/** Bloom filter over the keys of the run. */
+	VY_PAGE_INDEX_EXT_BLOOM = 1,
+};
+
 struct vy_page_index {
 	struct vy_page_index_header header;
 	struct vy_buf pages, minmax;
+	/** Bloom filter of the run, empty if there is none. */
+	struct vy_buf bloom;
 };
 
 static inline char *
@@ -3606,6 +3784,7 @@ static inline void
 vy_page_index_init(struct vy_page_index *i) {
 	vy_buf_init(&i->pages);
 	vy_buf_init(&i->minmax);
+	vy_buf_init(&i->bloom);
 	memset(&i->header, 0, sizeof(i->header));
 }
 
@@ -3613,6 +3792,7 @@ static inline void
 vy_page_index_free(struct vy_page_index *i) {
 	vy_buf_free(&i->pages);
 	vy_buf_free(&i->minmax);
+	vy_buf_free(&i->bloom);
 }
 
 static inline struct vy_page_info *
@@ -3658,6 +3838,175 @@ vy_page_index_size(struct vy_page_index *i)
 
 static int vy_page_index_load(struct vy_page_index *, void *);
 
+/** {{{ Bloom filter */
+
+enum {
+	/** Seed of the key hash stored in bloom filters. */
+	VY_BLOOM_SEED = 13U,
+	/** Filter size per distinct key, gives ~1% false positives. */
+	VY_BLOOM_BITS_PER_KEY = 10,
+	/** Number of probes, ln(2) * VY_BLOOM_BITS_PER_KEY. */
+	VY_BLOOM_HASH_COUNT = 7,
+};
+
+/**
+ * On-disk and in-memory layout of a run bloom filter:
+ * the header is followed by bit_count / 8 bytes of bitmap.
+ */
+struct PACKED vy_bloom_header {
+	uint32_t hash_count;
+	uint32_t bit_count;
+};
+
+/**
+ * Get the bytes of a key part to hash. Equal values must give
+ * equal bytes, while MsgPack has many encodings of a number:
+ * 1 may be a fixint or a uint 16, and in a NUMBER or SCALAR
+ * part also an int 8 or a double 1.0. So integers of NUM and
+ * INT parts are hashed as 64-bit values and numbers of NUMBER
+ * and SCALAR parts as doubles, the way mp_compare_number()
+ * compares them. Strings and binaries are hashed without
+ * MsgPack header, booleans as is.
+ */
+static inline const char *
+vy_bloom_key_part(const char *field, enum field_type type,
+		  uint64_t *num, uint32_t *size)
+{
+	const char *f = field;
+	enum mp_type mp_type = mp_typeof(*field);
+	if (mp_type == MP_STR)
+		return mp_decode_str(&field, size);
+	if (mp_type == MP_BIN)
+		return mp_decode_bin(&field, size);
+	if (type == NUM || type == INT) {
+		if (mp_type == MP_UINT)
+			*num = mp_decode_uint(&field);
+		else
+			*num = mp_decode_int(&field);
+	} else {
+		double d;
+		switch (mp_type) {
+		case MP_UINT:
+			d = mp_decode_uint(&field);
+			break;
+		case MP_INT:
+			d = mp_decode_int(&field);
+			break;
+		case MP_FLOAT:
+			d = mp_decode_float(&field);
+			break;
+		case MP_DOUBLE:
+			d = mp_decode_double(&field);
+			break;
+		default:
+			/* A boolean of a SCALAR part. */
+			mp_next(&field);
+			*size = field - f;
+			return f;
+		}
+		/* -0.0 is equal to 0.0 */
+		if (d == 0)
+			d = 0;
+		memcpy(num, &d, sizeof(d));
+	}
+	*size = sizeof(*num);
+	return (const char *)num;
+}
+
+/**
+ * Hash all parts of a key. The hash is only meaningful for
+ * full keys: the caller must make sure that no part is missing.
+ */
+static inline uint32_t
+vy_bloom_hash(const char *tuple_data, const struct key_def *key_def)
+{
+	uint32_t h = VY_BLOOM_SEED;
+	uint32_t carry = 0;
+	uint32_t total_size = 0;
+	for (uint32_t part_id = 0; part_id < key_def->part_count; part_id++) {
+		const char *field = vy_tuple_key_part(tuple_data, part_id);
+		assert(field != NULL);
+		enum field_type type = key_def->parts[part_id].type;
+		uint64_t num;
+		uint32_t size;
+		const char *f = vy_bloom_key_part(field, type, &num, &size);
+		PMurHash32_Process(&h, &carry, f, size);
+		total_size += size;
+	}
+	return PMurHash32_Result(h, carry, total_size);
+}
+
+/**
+ * Check if all key parts are present, i.e. the key identifies
+ * exactly one tuple and can be looked up in a bloom filter.
+ */
+static inline bool
+vy_bloom_key_is_full(const char *tuple_data, const struct key_def *key_def)
+{
+	return vy_tuple_key_part(tuple_data, key_def->part_count - 1) != NULL;
+}
+
+/**
+ * Build a bloom filter in an empty buffer from an array
+ * of key hashes.
+ */
+static int
+vy_bloom_build(struct vy_buf *bloom, const uint32_t *hashes, uint32_t count)
+{
+	assert(vy_buf_used(bloom) == 0);
+	uint64_t bit_count = (uint64_t)count * VY_BLOOM_BITS_PER_KEY;
+	if (bit_count < 64)
+		bit_count = 64;
+	bit_count = (bit_count + 7) & ~7ULL;
+	if (bit_count > UINT32_MAX)
+		bit_count = UINT32_MAX & ~7U;
+	uint32_t size = sizeof(struct vy_bloom_header) + bit_count / 8;
+	if (vy_buf_ensure(bloom, size))
+		return vy_oom();
+	struct vy_bloom_header *header = (struct vy_bloom_header *)bloom->s;
+	header->hash_count = VY_BLOOM_HASH_COUNT;
+	header->bit_count = bit_count;
+	uint8_t *bits = (uint8_t *)(header + 1);
+	memset(bits, 0, bit_count / 8);
+	for (uint32_t i = 0; i < count; i++) {
+		/* Double hashing, see Kirsch & Mitzenmacher. */
+		uint32_t h = hashes[i];
+		uint32_t delta = (h >> 17) | (h << 15);
+		for (uint32_t j = 0; j < header->hash_count; j++) {
+			uint32_t bit = h % header->bit_count;
+			bits[bit / 8] |= 1 << (bit % 8);
+			h += delta;
+		}
+	}
+	vy_buf_advance(bloom, size);
+	return 0;
+}
+
+/**
+ * Return false if the key with the given hash is definitely
+ * absent in the run, true if it may be there or the run
+ * has no bloom filter.
+ */
+static inline bool
+vy_bloom_maybe_has(struct vy_buf *bloom, uint32_t hash)
+{
+	if (vy_buf_used(bloom) == 0)
+		return true;
+	struct vy_bloom_header *header = (struct vy_bloom_header *)bloom->s;
+	const uint8_t *bits = (const uint8_t *)(header + 1);
+	uint32_t h = hash;
+	uint32_t delta = (h >> 17) | (h << 15);
+	for (uint32_t j = 0; j < header->hash_count; j++) {
+		uint32_t bit = h % header->bit_count;
+		if ((bits[bit / 8] & (1 << (bit % 8))) == 0)
+			return false;
+		h += delta;
+	}
+	return true;
+}
+
+/** }}} Bloom filter */
+
 struct vy_page_iter {
 	struct vy_page_index *index;
 	struct key_def *key_def;
@@ -3933,6 +4282,175 @@ struct sdmerge {
 	int         resume;
 };
 
+/**
+ * Cache of decompressed run pages shared by all indexes.
+ * Pages are identified by the run id, which is unique and
+ * never reused, and the page offset in the index file.
+ * The cache is used from reader threads, all accesses are
+ * serialized with a mutex; a hit copies the page to the
+ * reader's buffer, so a page may be evicted at any time.
+ */
+struct vy_page_key {
+	uint64_t run_id;
+	uint64_t offset;
+};
+
+struct vy_cached_page {
+	struct vy_page_key key;
+	/* link in vy_page_cache->lru */
+	struct rlist in_lru;
+	uint32_t size;
+	char data[0];
+};
+
+static inline uint32_t
+vy_page_key_hash(const struct vy_page_key *key)
+{
+	uint64_t h = key->run_id * 0x9E3779B97F4A7C15ULL ^ key->offset;
+	return (uint32_t) (h ^ (h >> 32));
+}
+
+static inline int
+vy_page_key_cmp(const struct vy_page_key *a, const struct vy_page_key *b)
+{
+	return a->run_id != b->run_id || a->offset != b->offset;
+}
+
+typedef struct vy_cached_page *vy_cached_page_ptr;
+
+#define mh_name _vy_page
+#define mh_key_t const struct vy_page_key *
+#define mh_node_t vy_cached_page_ptr
+#define mh_arg_t void *
+#define mh_hash(a, arg) vy_page_key_hash(&(*(a))->key)
+#define mh_hash_key(a, arg) vy_page_key_hash(a)
+#define mh_cmp(a, b, arg) vy_page_key_cmp(&(*(a))->key, &(*(b))->key)
+#define mh_cmp_key(a, b, arg) vy_page_key_cmp((a), &(*(b))->key)
+#define MH_SOURCE 1
+#include "salad/mhash.h"
+
+struct vy_page_cache {
+	pthread_mutex_t mutex;
+	struct mh_vy_page_t *pages;
+	/* least recently used pages first */
+	struct rlist lru;
+	uint64_t used;
+	uint64_t limit;
+	uint64_t hit;
+	uint64_t miss;
+	uint64_t evict;
+};
+
+static struct vy_page_cache *
+vy_page_cache_new(uint64_t limit)
+{
+	struct vy_page_cache *c = calloc(1, sizeof(*c));
+	if (c == NULL) {
+		diag_set(OutOfMemory, sizeof(*c), "page cache", "struct");
+		return NULL;
+	}
+	c->pages = mh_vy_page_new();
+	if (c->pages == NULL) {
+		diag_set(OutOfMemory, sizeof(*c->pages), "page cache", "hash");
+		free(c);
+		return NULL;
+	}
+	tt_pthread_mutex_init(&c->mutex, NULL);
+	rlist_create(&c->lru);
+	c->limit = limit;
+	return c;
+}
+
+static void
+vy_page_cache_delete(struct vy_page_cache *c)
+{
+	struct vy_cached_page *page, *tmp;
+	rlist_foreach_entry_safe(page, &c->lru, in_lru, tmp)
+		free(page);
+	mh_vy_page_delete(c->pages);
+	tt_pthread_mutex_destroy(&c->mutex);
+	free(c);
+}
+
+/** Remove the least recently used page, called under the mutex. */
+static void
+vy_page_cache_evict(struct vy_page_cache *c)
+{
+	assert(!rlist_empty(&c->lru));
+	struct vy_cached_page *page =
+		rlist_first_entry(&c->lru, struct vy_cached_page, in_lru);
+	mh_int_t k = mh_vy_page_find(c->pages, &page->key, NULL);
+	assert(k != mh_end(c->pages));
+	mh_vy_page_del(c->pages, k, NULL);
+	rlist_del_entry(page, in_lru);
+	c->used -= page->size;
+	c->evict++;
+	free(page);
+}
+
+/**
+ * Copy a cached page to buf.
+ * @retval 0 the page was found
+ * @retval 1 cache miss
+ */
+static int
+vy_page_cache_get(struct vy_page_cache *c, const struct vy_page_key *key,
+		  struct vy_buf *buf)
+{
+	tt_pthread_mutex_lock(&c->mutex);
+	mh_int_t k = mh_vy_page_find(c->pages, key, NULL);
+	if (k == mh_end(c->pages)) {
+		c->miss++;
+		tt_pthread_mutex_unlock(&c->mutex);
+		return 1;
+	}
+	struct vy_cached_page *page = *mh_vy_page_node(c->pages, k);
+	assert(vy_buf_unused(buf) >= page->size);
+	memcpy(buf->p, page->data, page->size);
+	vy_buf_advance(buf, page->size);
+	rlist_move_tail_entry(&c->lru, page, in_lru);
+	c->hit++;
+	tt_pthread_mutex_unlock(&c->mutex);
+	return 0;
+}
+
+/**
+ * Add a page which has just been read from disk,
+ * evicting least recently used pages if necessary.
+ * Failures are ignored: the cache is best effort.
+ */
+static void
+vy_page_cache_put(struct vy_page_cache *c, const struct vy_page_key *key,
+		  const char *data, uint32_t size)
+{
+	if (size > c->limit)
+		return;
+	struct vy_cached_page *page = malloc(sizeof(*page) + size);
+	if (page == NULL)
+		return;
+	page->key = *key;
+	page->size = size;
+	memcpy(page->data, data, size);
+
+	tt_pthread_mutex_lock(&c->mutex);
+	if (mh_vy_page_find(c->pages, key, NULL) != mh_end(c->pages)) {
+		/* another reader has cached this page already */
+		tt_pthread_mutex_unlock(&c->mutex);
+		free(page);
+		return;
+	}
+	while (c->used + size > c->limit)
+		vy_page_cache_evict(c);
+	if (mh_vy_page_put(c->pages, &page, NULL, NULL) == mh_end(c->pages)) {
+		tt_pthread_mutex_unlock(&c->mutex);
+		free(page);
+		return;
+	}
+	rlist_add_tail_entry(&c->lru, page, in_lru);
+	c->used += size;
+	tt_pthread_mutex_unlock(&c->mutex);
+}
+
 struct sdreadarg {
 	struct vy_page_index    *index;
 	struct vy_buf      *buf;
@@ -3947,6 +4465,8 @@ struct sdreadarg {
 	int         use_compression;
 	struct vy_filterif *compression_if;
 	struct key_def *key_def;
+	/* decompressed page cache, NULL if pages are not cached */
+	struct vy_page_cache *cache;
 };
 
 struct PACKED sdread {
@@ -3970,6 +4490,16 @@ sd_read_page(struct sdread *i, struct vy_page_info *info)
 	if (unlikely(rc == -1))
 		return vy_oom();
 
+	struct vy_page_key key = {
+		.run_id = arg->index->header.id.id,
+		.offset = info->offset
+	};
+	if (arg->cache != NULL &&
+	    vy_page_cache_get(arg->cache, &key, arg->buf) == 0) {
+		sd_pageinit(&i->page, (struct sdpageheader*)arg->buf->s);
+		return 0;
+	}
+
 	i->reads++;
 
 	/* compression */
@@ -4013,6 +4543,9 @@ sd_read_page(struct sdread *i, struct vy_page_info *info)
 			return -1;
 		}
 		vy_filter_free(&f);
+		if (arg->cache != NULL)
+			vy_page_cache_put(arg->cache, &key, arg->buf->s,
+					  vy_buf_used(arg->buf));
 		sd_pageinit(&i->page, (struct sdpageheader*)arg->buf->s);
 		return 0;
 	}
@@ -4027,6 +4560,8 @@ sd_read_page(struct sdread *i, struct vy_page_info *info)
 		return -1;
 	}
 	vy_buf_advance(arg->buf, info->size);
+	if (arg->cache != NULL)
+		vy_page_cache_put(arg->cache, &key, arg->buf->s, info->size);
 	sd_pageinit(&i->page, (struct sdpageheader*)(arg->buf->s));
 	return 0;
 }
@@ -4153,6 +4688,14 @@ vy_page_index_load(struct vy_page_index *i, void *ptr)
 	       (char *)ptr + sizeof(struct vy_page_index_header) + index_size,
 	       minmax_size);
 	vy_buf_advance(&i->minmax, minmax_size);
+	if (h->extensions & VY_PAGE_INDEX_EXT_BLOOM) {
+		/* the bloom filter is the only extension so far */
+		const char *bloom = (char *)ptr +
+			sizeof(struct vy_page_index_header) + h->size;
+		rc = vy_buf_add(&i->bloom, (void *)bloom, h->extension);
+		if (unlikely(rc == -1))
+			return vy_oom();
+	}
 	i->header = *h;
 	return 0;
 }
@@ -4312,7 +4855,7 @@ static int sd_recover_complete(struct sdrecover *ri)
 	 * index */
 	char *eof = ri->map.p +
 		    ri->actual->offset + sizeof(struct vy_page_index_header) +
-		    ri->actual->size - ri->actual->extension;
+		    ri->actual->size + ri->actual->extension;
 	uint64_t file_size = eof - ri->map.p;
 	int rc = vy_file_resize(ri->file, file_size);
 	if (unlikely(rc == -1))
@@ -4437,6 +4980,11 @@ struct PACKED vy_range {
 	uint32_t   branch_count;
 	uint32_t   temperature;
 	uint64_t   temperature_reads;
+	/*
+	 * Incremented on every change of the in-memory indexes
+	 * or the run list, invalidates open read iterators.
+	 */
+	uint32_t   version;
 	uint16_t   refs;
 	pthread_mutex_t reflock;
 	struct svindex    i0, i1;
@@ -4478,6 +5026,7 @@ vy_range_split(struct vy_range *node) {
 static inline struct svindex*
 vy_range_rotate(struct vy_range *node) {
 	node->flags |= SI_ROTATE;
+	node->version++;
 	return &node->i0;
 }
 
@@ -4485,6 +5034,7 @@ static inline void
 vy_range_unrotate(struct vy_range *node) {
 	assert((node->flags & SI_ROTATE) > 0);
 	node->flags &= ~SI_ROTATE;
+	node->version++;
 	node->i0 = node->i1;
 	node->i0.tree.arg = &node->i0;
 	sv_indexinit(&node->i1, node->i0.key_def);
@@ -4960,6 +5510,61 @@ vy_cachepool_push(struct sicache *c)
 	tt_pthread_mutex_unlock(&p->mutex);
 }
 
+/*
+ * A merge iterator which a cursor keeps open between reads.
+ * It is reused as long as the range it was built for is
+ * not modified, see vy_range->version.
+ */
+struct sireadstate {
+	struct svmerge merge;
+	struct svmergeiter im;
+	struct svreaditer ri;
+	struct vy_range *range;
+	uint64_t range_id;
+	uint32_t range_version;
+	int open;
+};
+
+static inline void
+si_readstate_init(struct sireadstate *s, struct vinyl_index *index)
+{
+	sv_mergeinit(&s->merge, index, index->key_def);
+	s->range = NULL;
+	s->range_id = 0;
+	s->range_version = 0;
+	s->open = 0;
+}
+
+static inline void
+si_readstate_close(struct sireadstate *s)
+{
+	if (s->open)
+		sv_readiter_close(&s->ri);
+	sv_mergereset(&s->merge);
+	s->range = NULL;
+	s->open = 0;
+}
+
+static inline void
+si_readstate_free(struct sireadstate *s)
+{
+	si_readstate_close(s);
+	sv_mergefree(&s->merge);
+}
+
+/*
+ * The range pointer alone is not enough: a range may be
+ * freed and another one allocated at the same address,
+ * so the unique range id is checked too.
+ */
+static inline int
+si_readstate_valid(struct sireadstate *s, struct vy_range *n)
+{
+	return s->open && s->range == n &&
+	       s->range_id == n->self.id.id &&
+	       s->range_version == n->version;
+}
+
 struct siread {
 	enum vinyl_order order;
 	void *key;
@@ -4972,8 +5577,16 @@ struct siread {
 	int read_cache;
 	struct sv *upsert_v;
 	int upsert_eq;
+	/* key hash for bloom filters, valid if bloom_check is set */
+	int bloom_check;
+	uint32_t bloom_hash;
+	/* runs skipped by bloom filters and bloom filter misses */
+	uint32_t bloom_skip;
+	uint32_t bloom_false_positive;
 	struct vinyl_tuple *result;
 	struct sicache *cache;
+	/* merge state to continue from, optional */
+	struct sireadstate *state;
 	struct vinyl_index *index;
 };
 
@@ -5222,16 +5835,24 @@ vy_task_execute(struct vy_task *task, struct sdc *c, uint64_t vlsn)
 	return rc;
 }
 
-/* dump tuple to branch page buffers (tuple header and data) */
+/* dump tuple to branch page buffers (tuple header and data),
+ * remember the key hash for the branch bloom filter */
 static int
 vy_branch_dump_tuple(struct svwriteiter *iwrite, struct vy_buf *info_buf,
-		     struct vy_buf *data_buf, struct sdpageheader *header)
+		     struct vy_buf *data_buf, struct sdpageheader *header,
+		     struct key_def *key_def, struct vy_buf *hash_buf)
 {
 	struct sv *value = sv_writeiter_get(iwrite);
 	uint64_t lsn = sv_lsn(value);
 	uint8_t flags = sv_flags(value);
-	if (sv_writeiter_is_duplicate(iwrite))
+	if (sv_writeiter_is_duplicate(iwrite)) {
 		flags |= SVDUP;
+	} else {
+		/* older versions of the key have the same hash */
+		uint32_t hash = vy_bloom_hash(sv_pointer(value), key_def);
+		if (vy_buf_add(hash_buf, &hash, sizeof(hash)))
+			return -1;
+	}
 	if (vy_buf_ensure(info_buf, sizeof(struct sdv)))
 		return -1;
 	struct sdv *tupleinfo = (struct sdv *)info_buf->p;
@@ -5266,7 +5887,8 @@ vy_branch_write_page(struct vy_file *file, struct svwriteiter *iwrite,
 		     struct vy_filterif *compression,
 		     struct vy_page_index_header *index_header,
 		     struct vy_page_info *page_info,
-		     struct vy_buf *minmax_buf)
+		     struct vy_buf *minmax_buf,
+		     struct key_def *key_def, struct vy_buf *hash_buf)
 {
 	memset(page_info, 0, sizeof(*page_info));
 
@@ -5281,7 +5903,7 @@ vy_branch_write_page(struct vy_file *file, struct svwriteiter *iwrite,
 
 	while (iwrite && sv_writeiter_has(iwrite)) {
 		int rc = vy_branch_dump_tuple(iwrite, &tuplesinfo, &values,
-					      &header);
+					      &header, key_def, hash_buf);
 		if (rc != 0) {
 			vy_oom();
 			goto err;
@@ -5387,8 +6009,10 @@ err:
 static int
 vy_branch_write(struct vy_file *file, struct svwriteiter *iwrite,
 	        struct vy_filterif *compression, uint64_t limit, struct sdid *id,
-	        struct vy_page_index *sdindex)
+	        struct key_def *key_def, struct vy_page_index *sdindex)
 {
+	struct vy_buf hashes;
+	vy_buf_init(&hashes);
 	uint64_t seal_offset = file->size;
 	struct sdseal seal;
 	sd_sealset_open(&seal);
@@ -5416,13 +6040,19 @@ vy_branch_write(struct vy_file *file, struct svwriteiter *iwrite,
 		struct vy_page_info *page = (struct vy_page_info *)sdindex->pages.p;
 		vy_buf_advance(&sdindex->pages, sizeof(struct vy_page_info));
 		if (vy_branch_write_page(file, iwrite, compression, index_header,
-					 page, &sdindex->minmax))
+					 page, &sdindex->minmax, key_def, &hashes))
 			goto err;
 
 		page->offset = page_offset;
 
 	} while (index_header->total < limit && iwrite && sv_writeiter_resume(iwrite));
 
+	if (vy_bloom_build(&sdindex->bloom, (uint32_t *)hashes.s,
+			   vy_buf_used(&hashes) / sizeof(uint32_t)))
+		goto err;
+	index_header->extensions |= VY_PAGE_INDEX_EXT_BLOOM;
+	index_header->extension = vy_buf_used(&sdindex->bloom);
+
 	index_header->size = vy_buf_used(&sdindex->pages) +
 				vy_buf_used(&sdindex->minmax);
 	index_header->offset = file->size;
@@ -5430,12 +6060,13 @@ vy_branch_write(struct vy_file *file, struct svwriteiter *iwrite,
 
 	sd_sealset_close(&seal, index_header);
 
-	struct iovec iovv[3];
+	struct iovec iovv[4];
 	struct vy_iov iov;
-	vy_iov_init(&iov, iovv, 3);
+	vy_iov_init(&iov, iovv, 4);
 	vy_iov_add(&iov, index_header, sizeof(struct vy_page_index_header));
 	vy_iov_add(&iov, sdindex->pages.s, vy_buf_used(&sdindex->pages));
 	vy_iov_add(&iov, sdindex->minmax.s, vy_buf_used(&sdindex->minmax));
+	vy_iov_add(&iov, sdindex->bloom.s, vy_buf_used(&sdindex->bloom));
 	if (vy_file_writev(file, &iov) < 0 ||
 		vy_file_pwrite(file, seal_offset, &seal, sizeof(struct sdseal)) < 0) {
 		vy_error("file '%s' write error: %s",
@@ -5446,11 +6077,13 @@ vy_branch_write(struct vy_file *file, struct svwriteiter *iwrite,
 	if (vy_file_sync(file) == -1) {
 		vy_error("index file '%s' sync error: %s",
 		               file->path, strerror(errno));
-		return -1;
+		goto err;
 	}
 
+	vy_buf_free(&hashes);
 	return 0;
 err:
+	vy_buf_free(&hashes);
 	return -1;
 }
 
@@ -5488,7 +6121,7 @@ vy_run_create(struct vinyl_index *index, struct sdc *c,
 	vy_page_index_init(&sdindex);
 	if ((rc = vy_branch_write(&parent->file, &iwrite,
 			          index->conf.compression_if, UINT64_MAX,
-			          &id, &sdindex)))
+			          &id, index->key_def, &sdindex)))
 		goto err;
 
 	*result = vy_run_new();
@@ -5548,6 +6181,7 @@ vy_run(struct vinyl_index *index, struct sdc *c, struct vy_range *n,
 	n->branch->link = branch;
 	n->branch = branch;
 	n->branch_count++;
+	n->version++;
 	assert(n->used >= i->used);
 	n->used -= i->used;
 	vy_quota_op(env->quota, VINYL_QREMOVE, i->used);
@@ -5778,6 +6412,7 @@ si_redistribute_set(struct vinyl_index *index, uint64_t now, struct svref *v)
 	(void) rc;
 	node->update_time = index->update_time;
 	node->used += vinyl_tuple_size(v->v);
+	node->version++;
 	/* schedule node */
 	vy_planner_update_range(&index->p, node);
 }
@@ -5863,7 +6498,8 @@ si_split(struct vinyl_index *index, struct sdc *c, struct vy_buf *result,
 
 		if ((rc = vy_branch_write(&n->file, &iwrite,
 				          index->conf.compression_if,
-				          size_stream, &id, &sdindex)))
+				          size_stream, &id, index->key_def,
+				          &sdindex)))
 			goto error;
 
 		rc = vy_buf_add(result, &n, sizeof(struct vy_range*));
@@ -6066,6 +6702,7 @@ vy_range_new(struct key_def *key_def)
 	n->branch_count = 0;
 	n->temperature = 0;
 	n->temperature_reads = 0;
+	n->version = 0;
 	n->refs = 0;
 	tt_pthread_mutex_init(&n->reflock, NULL);
 	vy_file_init(&n->file);
@@ -6611,9 +7248,14 @@ si_readopen(struct siread *q, struct vinyl_index *index, struct sicache *c,
 	q->vlsn = vlsn;
 	q->index = index;
 	q->cache = c;
+	q->state = NULL;
 	q->has = 0;
 	q->upsert_v = NULL;
 	q->upsert_eq = 0;
+	q->bloom_check = 0;
+	q->bloom_hash = 0;
+	q->bloom_skip = 0;
+	q->bloom_false_positive = 0;
 	q->cache_only = 0;
 	q->read_disk = 0;
 	q->read_cache = 0;
@@ -6677,6 +7319,12 @@ si_rangebranch(struct siread *q, struct vy_range *n,
 {
 	struct sicachebranch *c = si_cachefollow(q->cache, b);
 	assert(c->branch == b);
+	/* point lookup of a key which is definitely not in the run */
+	if (q->bloom_check &&
+	    ! vy_bloom_maybe_has(&b->index.bloom, q->bloom_hash)) {
+		q->bloom_skip++;
+		return 0;
+	}
 	/* iterate cache */
 	if (sd_read_has(&c->i)) {
 		struct svmergesrc *s = sv_mergeadd(m, &c->i);
@@ -6710,13 +7358,19 @@ si_rangebranch(struct siread *q, struct vy_range *n,
 		.has_vlsn        = 0,
 		.o               = q->order,
 		.file            = &n->file,
-		.key_def          = q->merge.key_def
+		.key_def          = q->merge.key_def,
+		.cache           = q->index->env->page_cache
 	};
 	int rc = sd_read_open(&c->i, &arg, q->key, q->keysize);
 	int reads = sd_read_stat(&c->i);
 	si_readstat(q, 0, n, reads);
 	if (unlikely(rc == -1))
 		return -1;
+	if (q->bloom_check && vy_buf_used(&b->index.bloom) != 0 &&
+	    (! sd_read_has(&c->i) ||
+	     vy_tuple_compare(sv_pointer(sd_read_get(&c->i)), q->key,
+			      q->merge.key_def) != 0))
+		q->bloom_false_positive++;
 	if (unlikely(! sd_read_has(&c->i)))
 		return 0;
 	struct svmergesrc *s = sv_mergeadd(m, &c->i);
@@ -6769,17 +7423,45 @@ static inline int
 si_range(struct siread *q)
 {
 	assert(q->has == 0);
+	struct sireadstate *state = q->state;
+	assert(state == NULL || (q->upsert_v == NULL && q->upsert_eq == 0));
 
 	struct vy_rangeiter ii;
 	vy_rangeiter_open(&ii, q->index, q->order, q->key, q->keysize);
-	struct vy_range *node;
+	struct vy_range *node = vy_rangeiter_get(&ii);
+	if (state != NULL && node != NULL && si_readstate_valid(state, node)) {
+		/*
+		 * The range has not changed since the previous
+		 * read: continue the merge from where it stopped.
+		 * Advancing a run source may read the next page,
+		 * so a cache only read of a range with runs has to
+		 * be retried with disk access, keeping the state.
+		 */
+		if (q->cache_only && node->branch != NULL)
+			return 2;
+		sv_readiter_next(&state->ri);
+		struct sv *v = sv_readiter_get(&state->ri);
+		if (likely(v != NULL)) {
+			si_readstat(q, 1, node, 1);
+			if (unlikely(si_readdup(q, v) == -1)) {
+				si_readstate_close(state);
+				return -1;
+			}
+			sv_readiter_forward(&state->ri);
+			return 1;
+		}
+		/* the range is exhausted */
+		vy_rangeiter_next(&ii);
+	}
+	if (state != NULL)
+		si_readstate_close(state);
 next_node:
 	node = vy_rangeiter_get(&ii);
 	if (unlikely(node == NULL))
 		return 0;
 
 	/* prepare sources */
-	struct svmerge *m = &q->merge;
+	struct svmerge *m = state != NULL ? &state->merge : &q->merge;
 	int count = node->branch_count + 2 + 1;
 	int rc = sv_mergeprepare(m, count);
 	if (unlikely(rc == -1)) {
@@ -6823,15 +7505,17 @@ next_node:
 	}
 
 	/* merge and filter data stream */
-	struct svmergeiter im;
-	sv_mergeiter_open(&im, m, q->order);
-	struct svreaditer ri;
-	sv_readiter_open(&ri, &im, q->vlsn, q->upsert_eq);
-	struct sv *v = sv_readiter_get(&ri);
+	struct svmergeiter merge_iter;
+	struct svreaditer read_iter;
+	struct svmergeiter *im = state != NULL ? &state->im : &merge_iter;
+	struct svreaditer *ri = state != NULL ? &state->ri : &read_iter;
+	sv_mergeiter_open(im, m, q->order);
+	sv_readiter_open(ri, im, q->vlsn, q->upsert_eq);
+	struct sv *v = sv_readiter_get(ri);
 	if (unlikely(v == NULL)) {
-		sv_mergereset(&q->merge);
+		sv_mergereset(m);
 		vy_rangeiter_next(&ii);
-		sv_readiter_close(&ri);
+		sv_readiter_close(ri);
 		goto next_node;
 	}
 
@@ -6849,14 +7533,24 @@ next_node:
 	}
 	if (likely(rc == 1)) {
 		if (unlikely(si_readdup(q, v) == -1)) {
-			sv_readiter_close(&ri);
+			sv_readiter_close(ri);
+			if (state != NULL)
+				sv_mergereset(m);
 			return -1;
 		}
 	}
 
 	/* skip a possible duplicates from data sources */
-	sv_readiter_forward(&ri);
-	sv_readiter_close(&ri);
+	sv_readiter_forward(ri);
+	if (state != NULL) {
+		/* keep the merge open for the next read */
+		state->range = node;
+		state->range_id = node->self.id.id;
+		state->range_version = node->version;
+		state->open = 1;
+		return rc;
+	}
+	sv_readiter_close(ri);
 	return rc;
 }
 
@@ -6947,7 +7641,7 @@ si_bootstrap(struct vinyl_index *index, uint64_t parent)
 	struct vy_page_index sdindex;
 	vy_page_index_init(&sdindex);
 	vy_branch_write(&n->file, NULL, index->conf.compression_if, 0, &id,
-			&sdindex);
+			index->key_def, &sdindex);
 
 	vy_run_set(&n->self, &sdindex);
 
@@ -7340,6 +8034,9 @@ vy_index_conf_free(struct vy_index_conf *s)
 	}
 }
 
+static void
+vy_scheduler_wakeup(struct scheduler *s);
+
 static void
 si_write(struct txlogindex *li, uint64_t time,
 	 enum vinyl_status status, uint64_t lsn)
@@ -7349,6 +8046,8 @@ si_write(struct txlogindex *li, uint64_t time,
 	struct rlist rangelist;
 	size_t quota = 0;
 	rlist_create(&rangelist);
+	uint32_t branch_wm = sr_zoneof(env)->branch_wm;
+	bool wakeup = false;
 
 	vy_index_lock(index);
 	index->update_time = time;
@@ -7378,8 +8077,12 @@ si_write(struct txlogindex *li, uint64_t time,
 		assert(rc == 0); /* TODO: handle BPS tree errors properly */
 		(void) rc;
 		/* update node */
+		uint32_t used = range->used;
 		range->used += vinyl_tuple_size(tuple);
+		range->version++;
 		quota += vinyl_tuple_size(tuple);
+		if (used < branch_wm && range->used >= branch_wm)
+			wakeup = true; /* the range is ready to be dumped */
 		if (rlist_empty(&range->commit))
 			rlist_add(&rangelist, &range->commit);
 	}
@@ -7391,13 +8094,36 @@ si_write(struct txlogindex *li, uint64_t time,
 		vy_planner_update_range(&index->p, range);
 	}
 	vy_index_unlock(index);
+	/*
+	 * Wake up workers before taking quota: if the quota
+	 * is exhausted, only a dump can release it.
+	 */
+	if (wakeup || vy_quota_crosses_zone(env->quota, quota))
+		vy_scheduler_wakeup(env->scheduler);
 	/* Take quota after having unlocked the index mutex. */
 	vy_quota_op(env->quota, VINYL_QADD, quota);
 	return;
 }
 
+enum {
+	/**
+	 * How long an idle worker sleeps if nobody wakes it up,
+	 * in microseconds. Bounds the latency of periodic
+	 * tasks (aging and garbage collection).
+	 */
+	VY_SCHEDULER_IDLE_TIMEOUT = 1000000,
+};
+
 struct scheduler {
 	pthread_mutex_t        lock;
+	/** Signalled when workers may have something to do. */
+	pthread_cond_t cond;
+	/**
+	 * Set by vy_scheduler_wakeup(), cleared when a worker
+	 * starts planning. Prevents lost wakeups between
+	 * planning and going to sleep.
+	 */
+	bool wakeup;
 	uint64_t       checkpoint_lsn_last;
 	uint64_t       checkpoint_lsn;
 	bool checkpoint_in_progress;
@@ -7433,6 +8159,8 @@ scheduler_new(struct vinyl_env *env)
 	}
 	uint64_t now = clock_monotonic64();
 	tt_pthread_mutex_init(&s->lock, NULL);
+	tt_pthread_cond_init(&s->cond, NULL);
+	s->wakeup                   = false;
 	s->checkpoint_lsn           = 0;
 	s->checkpoint_lsn_last      = 0;
 	s->checkpoint_in_progress   = false;
@@ -7453,9 +8181,46 @@ scheduler_delete(struct scheduler *s)
 {
 	if (s->count > 0)
 		free(s->indexes);
+	tt_pthread_cond_destroy(&s->cond);
+	tt_pthread_mutex_destroy(&s->lock);
 	free(s);
 }
 
+/**
+ * Wake up all idle workers: a checkpoint was requested,
+ * an index was added or removed or write watermarks
+ * were crossed.
+ */
+static void
+vy_scheduler_wakeup(struct scheduler *s)
+{
+	tt_pthread_mutex_lock(&s->lock);
+	s->wakeup = true;
+	tt_pthread_cond_broadcast(&s->cond);
+	tt_pthread_mutex_unlock(&s->lock);
+}
+
+/**
+ * Put a worker to sleep until it is woken up or
+ * VY_SCHEDULER_IDLE_TIMEOUT expires.
+ */
+static void
+vy_scheduler_wait(struct scheduler *s, struct vinyl_env *env)
+{
+	struct timeval now;
+	gettimeofday(&now, NULL);
+	uint64_t deadline = now.tv_sec * 1000000ULL + now.tv_usec +
+			    VY_SCHEDULER_IDLE_TIMEOUT;
+	struct timespec ts;
+	ts.tv_sec = deadline / 1000000;
+	ts.tv_nsec = (deadline % 1000000) * 1000;
+	tt_pthread_mutex_lock(&s->lock);
+	if (!s->wakeup && pm_atomic_load_explicit(&env->worker_pool_run,
+						  pm_memory_order_relaxed))
+		tt_pthread_cond_timedwait(&s->cond, &s->lock, &ts);
+	tt_pthread_mutex_unlock(&s->lock);
+}
+
 static int
 vy_scheduler_add_index(struct scheduler *s, struct vinyl_index *index)
 {
@@ -7471,6 +8236,8 @@ vy_scheduler_add_index(struct scheduler *s, struct vinyl_index *index)
 	s->indexes = indexes;
 	s->indexes[s->count++] = index;
 	vinyl_index_ref(index);
+	s->wakeup = true;
+	tt_pthread_cond_broadcast(&s->cond);
 	tt_pthread_mutex_unlock(&s->lock);
 	return 0;
 }
@@ -7488,10 +8255,13 @@ vy_scheduler_del_index(struct scheduler *s, struct vinyl_index *index)
 	s->count--;
 	if (unlikely(s->rr >= s->count))
 		s->rr = 0;
-	vinyl_index_unref(index);
 	/* add index to `shutdown` list */
 	rlist_add(&s->shutdown, &index->link);
+	s->wakeup = true;
+	tt_pthread_cond_broadcast(&s->cond);
 	tt_pthread_mutex_unlock(&s->lock);
+	/* may wake up the scheduler, so the lock must be released */
+	vinyl_index_unref(index);
 	return 0;
 }
 
@@ -7515,6 +8285,8 @@ static int sc_ctl_checkpoint(struct scheduler *s)
 	for (int i = 0; i < s->count; i++) {
 		s->indexes[i]->checkpoint_in_progress = true;
 	}
+	s->wakeup = true;
+	tt_pthread_cond_broadcast(&s->cond);
 	tt_pthread_mutex_unlock(&s->lock);
 	return 0;
 }
@@ -7530,15 +8302,14 @@ vy_plan_index(struct scheduler *s, struct srzone *zone, uint64_t vlsn,
 	if (rc != 0)
 		return rc; /* found or error */
 
-	/* checkpoint */
-	if (s->checkpoint_in_progress) {
-		rc = vy_planner_peek_checkpoint(index, s->checkpoint_lsn, task);
-		if (rc != 0)
-			return rc; /* found or error */
-	}
+	/*
+	 * Checkpoint dumps are planned by vy_plan() before any
+	 * other task. Until the checkpoint is complete, keep
+	 * workers free of long compaction and gc tasks.
+	 */
 
 	/* garbage-collection */
-	if (s->gc_in_progress) {
+	if (s->gc_in_progress && !s->checkpoint_in_progress) {
 		rc = vy_planner_peek_gc(index, vlsn, zone->gc_wm, task);
 		if (rc != 0)
 			return rc; /* found or error */
@@ -7559,9 +8330,11 @@ vy_plan_index(struct scheduler *s, struct srzone *zone, uint64_t vlsn,
 		return rc; /* found or error */
 
 	/* compaction */
-	rc = vy_planner_peek_compact(index, zone->compact_wm, task);
-	if (rc != 0)
-		return rc; /* found or error */
+	if (!s->checkpoint_in_progress) {
+		rc = vy_planner_peek_compact(index, zone->compact_wm, task);
+		if (rc != 0)
+			return rc; /* found or error */
+	}
 
 	return 0; /* nothing to do */
 }
@@ -7583,15 +8356,31 @@ vy_plan(struct scheduler *s, struct srzone *zone, uint64_t vlsn,
 		return 1;
 	}
 
-	/* peek an index */
-	index = vy_scheduler_peek_index(s);
-	if (index == NULL)
-		return 0; /* nothing to do */
+	int rc;
+	/* checkpoint dumps have the highest priority */
+	if (s->checkpoint_in_progress) {
+		for (int i = 0; i < s->count; i++) {
+			index = s->indexes[i];
+			vy_index_lock(index);
+			rc = vy_planner_peek_checkpoint(index,
+							s->checkpoint_lsn, task);
+			vy_index_unlock(index);
+			if (rc != 0)
+				return rc; /* found or error */
+		}
+	}
 
-	vy_index_lock(index);
-	int rc = vy_plan_index(s, zone, vlsn, index, task);
-	vy_index_unlock(index);
-	return rc;
+	/* visit all indexes round robin until a task is found */
+	for (int i = 0; i < s->count; i++) {
+		index = vy_scheduler_peek_index(s);
+		assert(index != NULL);
+		vy_index_lock(index);
+		rc = vy_plan_index(s, zone, vlsn, index, task);
+		vy_index_unlock(index);
+		if (rc != 0)
+			return rc; /* found or error */
+	}
+	return 0; /* nothing to do */
 }
 
 static int
@@ -7602,6 +8391,8 @@ sc_schedule(struct vinyl_env *env, struct sdc *sdc, int64_t vlsn)
 	struct srzone *zone = sr_zoneof(env);
 	int rc;
 	tt_pthread_mutex_lock(&sc->lock);
+	/* all events so far are taken into account by this run */
+	sc->wakeup = false;
 
 	if (sc->age_in_progress) {
 		/* Stop periodic aging */
@@ -7682,6 +8473,13 @@ sc_schedule(struct vinyl_env *env, struct sdc *sdc, int64_t vlsn)
 
 	if (unlikely(rc == -1))
 		return -1; /* error */
+	/*
+	 * A completed task may enable new ones (e.g. compaction
+	 * after a dump): let one more idle worker look around.
+	 */
+	tt_pthread_mutex_lock(&sc->lock);
+	tt_pthread_cond_signal(&sc->cond);
+	tt_pthread_mutex_unlock(&sc->lock);
 	return 1; /* success */
 }
 
@@ -7695,6 +8493,12 @@ struct vy_conf {
 	struct srzonemap zones;
 	/* memory */
 	uint64_t memory_limit;
+	/* max number of tuples a cursor reads in one worker task */
+	uint32_t cursor_batch;
+	/* size of the decompressed page cache, 0 to disable */
+	uint64_t page_cache;
+	/* number of threads executing index reads */
+	uint32_t read_threads;
 };
 
 static struct vy_conf *
@@ -7716,6 +8520,19 @@ vy_conf_new()
 		goto error_2;
 	}
 	conf->memory_limit = cfg_getd("vinyl.memory_limit")*1024*1024*1024;
+	int cursor_batch = cfg_geti("vinyl.cursor_batch");
+	if (cursor_batch <= 0) {
+		vy_error("bad cursor_batch value: %d", cursor_batch);
+		goto error_2;
+	}
+	conf->cursor_batch = cursor_batch;
+	conf->page_cache = cfg_getd("vinyl.page_cache")*1024*1024*1024;
+	int read_threads = cfg_geti("vinyl.read_threads");
+	if (read_threads <= 0) {
+		vy_error("bad read_threads value: %d", read_threads);
+		goto error_2;
+	}
+	conf->read_threads = read_threads;
 	struct srzone def = {
 		.enable            = 1,
 		.compact_wm        = 2,
@@ -7786,11 +8603,209 @@ sr_zoneof(struct vinyl_env *env)
 int
 vinyl_index_read(struct vinyl_index*, struct vinyl_tuple*, enum vinyl_order order,
 		struct vinyl_tuple **, struct vinyl_tx*, struct sicache*,
-		bool cache_only, struct vy_stat_get *);
+		struct sireadstate *, bool cache_only, struct vy_stat_get *);
 static int vinyl_index_visible(struct vinyl_index*, uint64_t);
 static int vinyl_index_recoverbegin(struct vinyl_index*);
 static int vinyl_index_recoverend(struct vinyl_index*);
 
+/** {{{ vy_read_pool - dedicated threads for index reads */
+
+/**
+ * A pool of threads executing index reads. Reads are not run
+ * in the coeio pool, since it is shared with fio, getaddrinfo
+ * and others, and a slow request of any kind would delay
+ * vinyl lookups behind it. Tasks are executed in FIFO order,
+ * complete tasks are handed back to the tx thread with an
+ * ev_async, which wakes up the waiting fibers.
+ */
+struct vy_read_pool {
+	pthread_mutex_t mutex;
+	/* signalled when a task is queued or the pool stops */
+	pthread_cond_t cond;
+	/* tasks waiting for a thread */
+	struct rlist input;
+	/* complete tasks waiting for the tx thread */
+	struct rlist output;
+	bool run;
+	struct cord *threads;
+	int thread_count;
+	struct ev_async async;
+	struct ev_loop *loop;
+	/* number of queued and running tasks, tx thread only */
+	uint32_t queue;
+	/* max queue depth observed, tx thread only */
+	uint32_t queue_max;
+	/* number of complete tasks, tx thread only */
+	uint64_t tasks;
+};
+
+struct vy_read_pool_task;
+
+typedef ssize_t (*vy_read_pool_f)(struct vy_read_pool_task *);
+
+struct vy_read_pool_task {
+	/* link in vy_read_pool->input or vy_read_pool->output */
+	struct rlist in_pool;
+	/* the waiting fiber, NULL if it has been cancelled */
+	struct fiber *fiber;
+	/* executed in a reader thread */
+	vy_read_pool_f func;
+	/* frees the task if the waiter has been cancelled */
+	vy_read_pool_f free_cb;
+	ssize_t rc;
+	bool complete;
+	struct diag diag;
+};
+
+static void *
+vy_read_thread_f(void *arg)
+{
+	struct vy_read_pool *pool = (struct vy_read_pool *) arg;
+	tt_pthread_mutex_lock(&pool->mutex);
+	while (pool->run) {
+		if (rlist_empty(&pool->input)) {
+			tt_pthread_cond_wait(&pool->cond, &pool->mutex);
+			continue;
+		}
+		struct vy_read_pool_task *task =
+			rlist_shift_entry(&pool->input,
+					  struct vy_read_pool_task, in_pool);
+		tt_pthread_mutex_unlock(&pool->mutex);
+		task->rc = task->func(task);
+		if (task->rc != 0)
+			diag_move(diag_get(), &task->diag);
+		tt_pthread_mutex_lock(&pool->mutex);
+		rlist_add_tail_entry(&pool->output, task, in_pool);
+		ev_async_send(pool->loop, &pool->async);
+	}
+	tt_pthread_mutex_unlock(&pool->mutex);
+	return NULL;
+}
+
+static void
+vy_read_pool_async_cb(ev_loop *loop, struct ev_async *watcher, int events)
+{
+	(void) loop;
+	(void) events;
+	struct vy_read_pool *pool = (struct vy_read_pool *) watcher->data;
+	while (true) {
+		tt_pthread_mutex_lock(&pool->mutex);
+		if (rlist_empty(&pool->output)) {
+			tt_pthread_mutex_unlock(&pool->mutex);
+			break;
+		}
+		struct vy_read_pool_task *task =
+			rlist_shift_entry(&pool->output,
+					  struct vy_read_pool_task, in_pool);
+		tt_pthread_mutex_unlock(&pool->mutex);
+		assert(pool->queue > 0);
+		pool->queue--;
+		pool->tasks++;
+		if (task->fiber == NULL) {
+			/* the waiter is gone */
+			diag_destroy(&task->diag);
+			task->free_cb(task);
+			continue;
+		}
+		task->complete = true;
+		fiber_wakeup(task->fiber);
+	}
+}
+
+static void
+vy_read_pool_delete(struct vy_read_pool *pool)
+{
+	tt_pthread_mutex_lock(&pool->mutex);
+	pool->run = false;
+	tt_pthread_cond_broadcast(&pool->cond);
+	tt_pthread_mutex_unlock(&pool->mutex);
+	for (int i = 0; i < pool->thread_count; i++)
+		cord_join(&pool->threads[i]);
+	ev_async_stop(pool->loop, &pool->async);
+	tt_pthread_cond_destroy(&pool->cond);
+	tt_pthread_mutex_destroy(&pool->mutex);
+	free(pool->threads);
+	free(pool);
+}
+
+static struct vy_read_pool *
+vy_read_pool_new(int thread_count)
+{
+	assert(thread_count > 0);
+	struct vy_read_pool *pool = calloc(1, sizeof(*pool));
+	if (pool == NULL) {
+		diag_set(OutOfMemory, sizeof(*pool), "read pool", "struct");
+		return NULL;
+	}
+	pool->threads = calloc(thread_count, sizeof(struct cord));
+	if (pool->threads == NULL) {
+		diag_set(OutOfMemory, thread_count * sizeof(struct cord),
+			 "read pool", "threads");
+		free(pool);
+		return NULL;
+	}
+	tt_pthread_mutex_init(&pool->mutex, NULL);
+	tt_pthread_cond_init(&pool->cond, NULL);
+	rlist_create(&pool->input);
+	rlist_create(&pool->output);
+	pool->run = true;
+	pool->loop = loop();
+	ev_async_init(&pool->async, vy_read_pool_async_cb);
+	pool->async.data = pool;
+	ev_async_start(pool->loop, &pool->async);
+	for (int i = 0; i < thread_count; i++) {
+		if (cord_start(&pool->threads[i], "vinyl.reader",
+			       vy_read_thread_f, pool) != 0) {
+			vy_read_pool_delete(pool);
+			vy_error("%s", "failed to start vinyl reader thread");
+			return NULL;
+		}
+		pool->thread_count++;
+	}
+	return pool;
+}
+
+/**
+ * Execute func in a reader thread and wait for it to complete.
+ * @retval 0 the task is complete, its result is in task->rc
+ *           and the error, if any, is moved to the fiber diag.
+ * @retval -1 the fiber was cancelled while waiting; the task
+ *            is still in progress and will be freed by free_cb
+ *            on completion, so the caller must not touch it.
+ */
+static int
+vy_read_pool_exec(struct vy_read_pool *pool, struct vy_read_pool_task *task,
+		  vy_read_pool_f func, vy_read_pool_f free_cb)
+{
+	task->fiber = fiber();
+	task->func = func;
+	task->free_cb = free_cb;
+	task->rc = 0;
+	task->complete = false;
+	diag_create(&task->diag);
+	if (++pool->queue > pool->queue_max)
+		pool->queue_max = pool->queue;
+
+	tt_pthread_mutex_lock(&pool->mutex);
+	rlist_add_tail_entry(&pool->input, task, in_pool);
+	tt_pthread_cond_signal(&pool->cond);
+	tt_pthread_mutex_unlock(&pool->mutex);
+
+	while (!task->complete) {
+		fiber_yield();
+		if (!task->complete && fiber_is_cancelled()) {
+			task->fiber = NULL;
+			diag_set(FiberIsCancelled);
+			return -1;
+		}
+	}
+	if (task->rc != 0)
+		diag_move(&task->diag, &fiber()->diag);
+	return 0;
+}
+
+/** }}} vy_read_pool */
+
 /** {{{ Introspection */
 
 static inline struct vy_info_node *
@@ -7869,6 +8884,45 @@ vy_info_append_memory(struct vy_info *info, struct vy_info_node *root)
 	return 0;
 }
 
+static inline int
+vy_info_append_page_cache(struct vy_info *info, struct vy_info_node *root)
+{
+	struct vy_info_node *node = vy_info_append(root, "cache");
+	if (vy_info_reserve(info, node, 5) != 0)
+		return 1;
+	struct vy_page_cache *c = info->env->page_cache;
+	if (c == NULL) {
+		vy_info_append_u64(node, "limit", 0);
+		vy_info_append_u64(node, "used", 0);
+		vy_info_append_u64(node, "hit", 0);
+		vy_info_append_u64(node, "miss", 0);
+		vy_info_append_u64(node, "evict", 0);
+		return 0;
+	}
+	tt_pthread_mutex_lock(&c->mutex);
+	vy_info_append_u64(node, "limit", c->limit);
+	vy_info_append_u64(node, "used", c->used);
+	vy_info_append_u64(node, "hit", c->hit);
+	vy_info_append_u64(node, "miss", c->miss);
+	vy_info_append_u64(node, "evict", c->evict);
+	tt_pthread_mutex_unlock(&c->mutex);
+	return 0;
+}
+
+static inline int
+vy_info_append_read_pool(struct vy_info *info, struct vy_info_node *root)
+{
+	struct vy_info_node *node = vy_info_append(root, "read_pool");
+	if (vy_info_reserve(info, node, 4) != 0)
+		return 1;
+	struct vy_read_pool *pool = info->env->read_pool;
+	vy_info_append_u32(node, "threads", pool->thread_count);
+	vy_info_append_u32(node, "queue", pool->queue);
+	vy_info_append_u32(node, "queue_max", pool->queue_max);
+	vy_info_append_u64(node, "tasks", pool->tasks);
+	return 0;
+}
+
 static inline int
 vy_info_append_compaction(struct vy_info *info, struct vy_info_node *root)
 {
@@ -7927,7 +8981,7 @@ static inline int
 vy_info_append_performance(struct vy_info *info, struct vy_info_node *root)
 {
 	struct vy_info_node *node = vy_info_append(root, "performance");
-	if (vy_info_reserve(info, node, 26) != 0)
+	if (vy_info_reserve(info, node, 30) != 0)
 		return 1;
 
 	struct vinyl_env *env = info->env;
@@ -7948,6 +9002,8 @@ vy_info_append_performance(struct vy_info *info, struct vy_info_node *root)
 	vy_info_append_str(node, "set_latency", stat->set_latency.sz);
 	vy_info_append_u64(node, "tx_rollback", stat->tx_rlb);
 	vy_info_append_u64(node, "tx_conflict", stat->tx_conflict);
+	vy_info_append_u64(node, "throttled", stat->throttled);
+	vy_info_append_str(node, "throttle_time", stat->throttle_time.sz);
 	vy_info_append_u32(node, "tx_gc_queue", env->xm->count_gc);
 	vy_info_append_u32(node, "tx_active_rw", env->xm->count_rw);
 	vy_info_append_u32(node, "tx_active_ro", env->xm->count_rd);
@@ -7959,6 +9015,9 @@ vy_info_append_performance(struct vy_info *info, struct vy_info_node *root)
 	vy_info_append_str(node, "cursor_latency", stat->cursor_latency.sz);
 	vy_info_append_str(node, "cursor_read_disk", stat->cursor_read_disk.sz);
 	vy_info_append_str(node, "cursor_read_cache", stat->cursor_read_cache.sz);
+	vy_info_append_u64(node, "bloom_skip", stat->bloom_skip);
+	vy_info_append_u64(node, "bloom_false_positive",
+			   stat->bloom_false_positive);
 	tt_pthread_mutex_unlock(&stat->lock);
 	return 0;
 }
@@ -8024,10 +9083,12 @@ vy_info_create(struct vy_info *info, struct vinyl_env *e)
 	info->env = e;
 	region_create(&info->allocator, cord_slab_cache());
 	struct vy_info_node *root = &info->root;
-	if (vy_info_reserve(info, root, 7) != 0 ||
+	if (vy_info_reserve(info, root, 9) != 0 ||
 	    vy_info_append_indices(info, root) != 0 ||
 	    vy_info_append_global(info, root) != 0 ||
 	    vy_info_append_memory(info, root) != 0 ||
+	    vy_info_append_page_cache(info, root) != 0 ||
+	    vy_info_append_read_pool(info, root) != 0 ||
 	    vy_info_append_metric(info, root) != 0 ||
 	    vy_info_append_scheduler(info, root) != 0 ||
 	    vy_info_append_compaction(info, root) != 0 ||
@@ -8058,6 +9119,22 @@ struct vinyl_cursor {
 	int read_disk;
 	int read_cache;
 	struct sicache *cache;
+	/* merge iterator kept open between reads */
+	struct sireadstate state;
+	/*
+	 * Tuples read ahead by a worker thread and not yet
+	 * returned, see vy_cursor_batch_cb().
+	 */
+	struct vinyl_tuple **batch;
+	uint32_t batch_pos;
+	uint32_t batch_count;
+	/* tuples to read in the next task, grows up to cursor_batch */
+	uint32_t batch_size;
+	/*
+	 * The error which stopped the last batch, raised once
+	 * the tuples read before it are returned.
+	 */
+	struct diag batch_diag;
 };
 
 struct vinyl_cursor *
@@ -8082,10 +9159,23 @@ vinyl_cursor_new(struct vinyl_index *index, const char *key,
 	c->cache = vy_cachepool_pop(e->cachepool);
 	if (unlikely(c->cache == NULL))
 		goto error_2;
+	c->batch = malloc(sizeof(*c->batch) * e->conf->cursor_batch);
+	if (c->batch == NULL) {
+		diag_set(OutOfMemory, sizeof(*c->batch) * e->conf->cursor_batch,
+			 "cursor", "batch");
+		goto error_3;
+	}
+	c->batch_pos = 0;
+	c->batch_count = 0;
+	c->batch_size = 1;
+	diag_create(&c->batch_diag);
+	si_readstate_init(&c->state, index);
 
 	tx_begin(e->xm, &c->tx, VINYL_TX_RO);
 	return c;
 
+error_3:
+	vy_cachepool_push(c->cache);
 error_2:
 	vinyl_tuple_unref(index, c->key);
 error_1:
@@ -8099,6 +9189,11 @@ vinyl_cursor_delete(struct vinyl_cursor *c)
 {
 	struct vinyl_env *e = c->index->env;
 	tx_rollback(&c->tx);
+	si_readstate_free(&c->state);
+	for (uint32_t i = c->batch_pos; i < c->batch_count; i++)
+		vinyl_tuple_unref(c->index, c->batch[i]);
+	free(c->batch);
+	diag_destroy(&c->batch_diag);
 	if (c->cache)
 		vy_cachepool_push(c->cache);
 	if (c->key)
@@ -8122,7 +9217,7 @@ vinyl_cursor_next(struct vinyl_cursor *c, struct vinyl_tuple **result,
 	struct vy_stat_get statget;
 	assert(c->key != NULL);
 	if (vinyl_index_read(index, c->key, c->order, result, tx, c->cache,
-			    cache_only, &statget) != 0) {
+			    &c->state, cache_only, &statget) != 0) {
 		return -1;
 	}
 
@@ -8238,12 +9333,20 @@ vinyl_index_ref(struct vinyl_index *index)
 static void
 vinyl_index_unref(struct vinyl_index *index)
 {
+	/*
+	 * The index may be deleted as soon as the reference
+	 * is dropped, so don't touch it afterwards.
+	 */
+	struct scheduler *scheduler = index->env->scheduler;
+	bool active = vy_status_is_active(vy_status(&index->status));
 	/* reduce reference counter */
 	tt_pthread_mutex_lock(&index->ref_lock);
 	assert(index->refs > 0);
-	--index->refs;
+	bool unused = --index->refs == 0;
 	tt_pthread_mutex_unlock(&index->ref_lock);
 	/* index will be deleted by scheduler if ref == 0 */
+	if (unused && !active)
+		vy_scheduler_wakeup(scheduler);
 }
 
 int
@@ -8289,8 +9392,8 @@ int
 vinyl_index_read(struct vinyl_index *index, struct vinyl_tuple *key,
 		 enum vinyl_order order,
 		 struct vinyl_tuple **result, struct vinyl_tx *tx,
-		 struct sicache *cache, bool cache_only,
-		 struct vy_stat_get *statget)
+		 struct sicache *cache, struct sireadstate *state,
+		 bool cache_only, struct vy_stat_get *statget)
 {
 	struct vinyl_env *e = index->env;
 	uint64_t start  = clock_monotonic64();
@@ -8360,9 +9463,20 @@ vinyl_index_read(struct vinyl_index *index, struct vinyl_tuple *key,
 	}
 	q.upsert_eq = upsert_eq;
 	q.cache_only = cache_only;
+	/* the saved merge can't be reused for point lookups */
+	if (! upsert_eq)
+		q.state = state;
+	if (upsert_eq && q.key != NULL &&
+	    vy_bloom_key_is_full(q.key, index->key_def)) {
+		q.bloom_check = 1;
+		q.bloom_hash = vy_bloom_hash(q.key, index->key_def);
+	}
 	assert(q.order != VINYL_EQ);
 	int rc = si_range(&q);
 	si_readclose(&q);
+	/* on cache miss the lookup is repeated and accounted again */
+	if (rc != 2 && (q.bloom_skip != 0 || q.bloom_false_positive != 0))
+		vy_stat_bloom(e->stat, q.bloom_skip, q.bloom_false_positive);
 
 	if (vup != NULL) {
 		vinyl_tuple_unref(index, vup);
@@ -9053,7 +10167,7 @@ vy_get(struct vinyl_tx *tx, struct vinyl_index *index, struct vinyl_tuple *key,
 {
 	struct vy_stat_get statget;
 	memset(&statget, 0, sizeof(statget));
-	if (vinyl_index_read(index, key, VINYL_EQ, result, tx, NULL,
+	if (vinyl_index_read(index, key, VINYL_EQ, result, tx, NULL, NULL,
 			    cache_only, &statget) != 0) {
 		return -1;
 	}
@@ -9073,6 +10187,18 @@ vinyl_rollback(struct vinyl_env *e, struct vinyl_tx *tx)
 	return 0;
 }
 
+static inline int64_t
+vy_tx_write_size(struct vinyl_tx *tx)
+{
+	int64_t size = 0;
+	struct txv *v;
+	stailq_foreach_entry(v, &tx->log, next_in_log) {
+		if ((v->tuple->flags & SVGET) == 0)
+			size += vinyl_tuple_size(v->tuple);
+	}
+	return size;
+}
+
 int
 vinyl_prepare(struct vinyl_env *e, struct vinyl_tx *tx)
 {
@@ -9082,6 +10208,19 @@ vinyl_prepare(struct vinyl_env *e, struct vinyl_tx *tx)
 	/* prepare transaction */
 	assert(tx->state == VINYL_TX_READY);
 
+	/*
+	 * Wait for memory before checking for conflicts:
+	 * other transactions may commit while we sleep.
+	 */
+	int64_t size = vy_tx_write_size(tx);
+	if (size != 0) {
+		double throttled;
+		if (vy_quota_throttle(e->quota, size, &throttled) != 0)
+			return -1;
+		if (e->quota->enable)
+			vy_stat_throttle(e->stat, throttled);
+	}
+
 	enum tx_state s = tx_prepare(tx);
 
 	if (s == VINYL_TX_ROLLBACK) {
@@ -9159,13 +10298,13 @@ vinyl_begin(struct vinyl_env *e)
 
 /* }}} Public API of transaction control */
 
-/** {{{ vy_read_task - Asynchronous get/cursor I/O using eio pool */
+/** {{{ vy_read_task - Asynchronous get/cursor I/O using the read pool */
 
 /**
  * A context of asynchronous index get or cursor read.
  */
 struct vy_read_task {
-	struct coio_task base;
+	struct vy_read_pool_task base;
 	struct vinyl_index *index;
 	struct vinyl_cursor *cursor;
 	struct vinyl_tx *tx;
@@ -9174,21 +10313,47 @@ struct vy_read_task {
 };
 
 static ssize_t
-vy_get_cb(struct coio_task *ptr)
+vy_get_cb(struct vy_read_pool_task *ptr)
 {
 	struct vy_read_task *task = (struct vy_read_task *) ptr;
 	return vy_get(task->tx, task->index, task->key, &task->result, false);
 }
 
+/**
+ * Read up to batch_size tuples from a cursor into its batch
+ * in one go, to pay for the thread switch once per batch
+ * rather than once per tuple.
+ */
 static ssize_t
-vy_cursor_next_cb(struct coio_task *ptr)
+vy_cursor_batch_cb(struct vy_read_pool_task *ptr)
 {
 	struct vy_read_task *task = (struct vy_read_task *) ptr;
-	return vinyl_cursor_next(task->cursor, &task->result, false);
+	struct vinyl_cursor *c = task->cursor;
+	assert(c->batch_pos == c->batch_count);
+	c->batch_pos = 0;
+	c->batch_count = 0;
+	while (c->batch_count < c->batch_size && c->key != NULL) {
+		struct vinyl_tuple *result;
+		if (vinyl_cursor_next(c, &result, false) != 0) {
+			if (c->batch_count == 0)
+				return -1;
+			/*
+			 * Return what has been read so far,
+			 * the error is raised when the batch
+			 * is exhausted.
+			 */
+			diag_move(diag_get(), &c->batch_diag);
+			break;
+		}
+		if (result == NULL)
+			break;
+		c->batch[c->batch_count++] = result;
+	}
+	return 0;
 }
 
 static ssize_t
-vy_read_task_free_cb(struct coio_task *ptr)
+vy_read_task_free_cb(struct vy_read_pool_task *ptr)
 {
 	struct vy_read_task *task = (struct vy_read_task *) ptr;
 	struct vinyl_env *env = task->index->env;
@@ -9208,7 +10373,7 @@ static inline int
 vy_read_task(struct vinyl_index *index, struct vinyl_tx *tx,
 	     struct vinyl_cursor *cursor, struct vinyl_tuple *key,
 	     struct vinyl_tuple **result,
-	     coio_task_cb func)
+	     vy_read_pool_f func)
 {
 	assert(index != NULL);
 	struct vinyl_env *env = index->env;
@@ -9224,13 +10389,13 @@ vy_read_task(struct vinyl_index *index, struct vinyl_tx *tx,
 	task->cursor = cursor;
 	task->key = key;
 	task->result = NULL;
-	if (coio_task(&task->base, func, vy_read_task_free_cb,
-	              TIMEOUT_INFINITY) == -1) {
+	if (vy_read_pool_exec(env->read_pool, &task->base, func,
+			      vy_read_task_free_cb) != 0) {
 		return -1;
 	}
 	vinyl_index_unref(index);
 	*result = task->result;
-	int rc = task->base.base.result; /* save original error code */
+	int rc = task->base.rc;
 	mempool_free(&env->read_task_pool, task);
 	assert(rc == 0 || !diag_is_empty(&fiber()->diag));
 	return rc;
@@ -9271,19 +10436,41 @@ vinyl_coget(struct vinyl_tx *tx, struct vinyl_index *index, const char *key,
 }
 
 /**
- * Read the next value from a cursor in a thread pool thread.
+ * Read the next value from a cursor. Tuples are read by
+ * a thread pool thread in batches, which grow twice on each
+ * task up to vinyl.cursor_batch, so that short scans do not
+ * read more than they need.
  */
 int
 vinyl_cursor_conext(struct vinyl_cursor *cursor, struct tuple **result)
 {
-	struct vinyl_tuple *vyresult;
-	int rc = vinyl_cursor_next(cursor, &vyresult, true);
-	if (rc == 0 && vyresult == NULL) { /* cache miss or not found */
-		rc = vy_read_task(cursor->index, NULL, cursor, NULL, &vyresult,
-				  vy_cursor_next_cb);
+	struct vinyl_tuple *vyresult = NULL;
+	int rc = 0;
+	if (cursor->batch_pos == cursor->batch_count) {
+		if (! diag_is_empty(&cursor->batch_diag)) {
+			/* the previous batch was cut short by an error */
+			diag_move(&cursor->batch_diag, &fiber()->diag);
+			return -1;
+		}
+		if (cursor->key == NULL) {
+			/* the previous batch reached the end */
+			*result = NULL;
+			return 0;
+		}
+		rc = vinyl_cursor_next(cursor, &vyresult, true);
+		if (rc == 0 && vyresult == NULL) { /* cache miss or not found */
+			rc = vy_read_task(cursor->index, NULL, cursor, NULL,
+					  &vyresult, vy_cursor_batch_cb);
+			uint32_t batch_max = cursor->index->env->conf->cursor_batch;
+			if (cursor->batch_size < batch_max)
+				cursor->batch_size = MIN(cursor->batch_size * 2,
+							 batch_max);
+		}
 	}
 	if (rc != 0)
 		return -1;
+	if (vyresult == NULL && cursor->batch_pos < cursor->batch_count)
+		vyresult = cursor->batch[cursor->batch_pos++];
 
 	if (vyresult == NULL) { /* not found */
 		*result = NULL;
@@ -9323,25 +10510,38 @@ vinyl_env_new(void)
 	e->cachepool = vy_cachepool_new(e);
 	if (e->cachepool == NULL)
 		goto error_4;
+	if (e->conf->page_cache != 0) {
+		e->page_cache = vy_page_cache_new(e->conf->page_cache);
+		if (e->page_cache == NULL)
+			goto error_5;
+	}
 	e->xm = tx_manager_new(e);
 	if (e->xm == NULL)
-		goto error_5;
+		goto error_6;
 	e->scheduler = scheduler_new(e);
 	if (e->scheduler == NULL)
-		goto error_6;
+		goto error_7;
 	e->stat = vy_stat_new();
 	if (e->stat == NULL)
-		goto error_7;
+		goto error_8;
+	e->read_pool = vy_read_pool_new(e->conf->read_threads);
+	if (e->read_pool == NULL)
+		goto error_9;
 
 	mempool_create(&e->read_task_pool, cord_slab_cache(),
 	               sizeof(struct vy_read_task));
 	mempool_create(&e->cursor_pool, cord_slab_cache(),
 	               sizeof(struct vinyl_cursor));
 	return e;
-error_7:
+error_9:
+	vy_stat_delete(e->stat);
+error_8:
 	scheduler_delete(e->scheduler);
-error_6:
+error_7:
 	tx_manager_delete(e->xm);
+error_6:
+	if (e->page_cache != NULL)
+		vy_page_cache_delete(e->page_cache);
 error_5:
 	vy_cachepool_delete(e->cachepool);
 error_4:
@@ -9360,6 +10560,7 @@ vinyl_env_delete(struct vinyl_env *e)
 {
 	int rcret = 0;
 	e->status = VINYL_SHUTDOWN;
+	vy_read_pool_delete(e->read_pool);
 	vy_workers_stop(e);
 	/* TODO: tarantool doesn't delete indexes during shutdown */
 	//assert(rlist_empty(&e->db));
@@ -9372,6 +10573,8 @@ vinyl_env_delete(struct vinyl_env *e)
 	}
 	tx_manager_delete(e->xm);
 	vy_cachepool_delete(e->cachepool);
+	if (e->page_cache != NULL)
+		vy_page_cache_delete(e->page_cache);
 	vy_conf_delete(e->conf);
 	vy_quota_delete(e->quota);
 	vy_stat_delete(e->stat);
@@ -9517,7 +10720,7 @@ vinyl_worker(void *arg)
 		if (rc == -1)
 			break;
 		if (rc == 0)
-			usleep(10000); /* 10ms */
+			vy_scheduler_wait(env->scheduler, env);
 	}
 	sd_cfree(&sdc);
 	return NULL;
@@ -9549,6 +10752,7 @@ vy_workers_stop(struct vinyl_env *env)
 		return;
 	pm_atomic_store_explicit(&env->worker_pool_run, 0,
 				 pm_memory_order_relaxed);
+	vy_scheduler_wakeup(env->scheduler);
 	for (int i = 0; i < env->worker_pool_size; i++)
 		cord_join(&env->worker_pool[i]);
 	free(env->worker_pool);
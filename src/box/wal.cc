@@ -30,6 +30,8 @@
  */
 #include "wal.h"
 
+#include <fcntl.h>
+
 #include "vclock.h"
 #include "fiber.h"
 #include "fio.h"
@@ -39,9 +41,46 @@
 #include "xrow.h"
 #include "cbus.h"
 #include "coeio.h"
+#include "clock.h"
+#include "histogram.h"
+#include "iproto_constants.h"
 
 const char *wal_mode_STRS[] = { "none", "write", "fsync", NULL };
 
+/** State of the spare file the next WAL is created from. */
+enum wal_spare_state {
+	/** There is no spare file. */
+	WAL_SPARE_NONE,
+	/** The spare file is being preallocated. */
+	WAL_SPARE_PREPARING,
+	/** The spare file is ready to become the next WAL. */
+	WAL_SPARE_READY,
+};
+
+/**
+ * The in-memory tail of the WAL: the rows written last, kept
+ * encoded in a ring buffer of a fixed size. Relays which have
+ * caught up with the WAL read new rows from here instead of
+ * re-reading the current xlog file.
+ */
+struct wal_tail {
+	/** The ring buffer, NULL if the tail is disabled. */
+	char *buf;
+	/** The size of the ring buffer. */
+	size_t size;
+	/**
+	 * Positions of the first row and of the end of the
+	 * last row. They only grow, the offset of a position
+	 * in the ring buffer is pos % size.
+	 */
+	int64_t start;
+	int64_t end;
+	/** The WAL vclock before the first row of the tail. */
+	struct vclock vclock;
+	/** The lock protecting the tail, taken by relays. */
+	pthread_mutex_t mutex;
+};
+
 /*
  * WAL writer - maintain a Write Ahead Log for every change
  * in the data state.
@@ -64,11 +103,38 @@ struct wal_writer
 	struct stailq rollback;
 	/** A pipe from 'tx' thread to 'wal' */
 	struct cpipe wal_pipe;
+	/**
+	 * A setting from server configuration -
+	 * wal_group_commit_delay. If set, requests are held
+	 * in the pipe for this long to let more transactions
+	 * join the batch.
+	 */
+	double group_commit_delay;
+	/** Flushes the pipe when the group commit delay expires. */
+	struct ev_timer group_commit_timer;
 	/* ----------------- wal ------------------- */
 	/** A setting from server configuration - rows_per_wal */
 	int64_t rows_per_wal;
 	/** Another one - wal_mode */
 	enum wal_mode wal_mode;
+	/** wal_max_size: rotate the WAL once it grows this big. */
+	int64_t max_size;
+	/**
+	 * wal_prealloc: keep a spare file of max_size bytes
+	 * allocated in background, so that WAL rotation is a
+	 * rename of the spare file rather than a create.
+	 */
+	bool prealloc;
+	/** The spare file. */
+	char spare_path[PATH_MAX];
+	/**
+	 * An old xlog given away for recycling, it becomes
+	 * the next spare file instead of a new one.
+	 */
+	char recycle_path[PATH_MAX];
+	enum wal_spare_state spare_state;
+	/** The fiber preparing the spare file. */
+	struct fiber *spare_f;
 	/** wal_dir, from the configuration file. */
 	struct xdir wal_dir;
 	/** 'wal' thread doing the writes. */
@@ -107,6 +173,18 @@ struct wal_writer
 	struct rlist watchers;
 	/** The lock protecting the watchers list. */
 	pthread_mutex_t watchers_mutex;
+	/** Number of rows written per batch. */
+	struct histogram *batch_hist;
+	/** Latency of a batch fdatasync(), in microseconds. */
+	struct histogram *sync_hist;
+	/**
+	 * Latency of wal_write(), in microseconds, by the type
+	 * of the first row of a transaction: the wait in the
+	 * queue to the WAL thread, write and fdatasync().
+	 */
+	struct histogram *latency[IPROTO_TYPE_STAT_MAX];
+	/** Rows written last, for relays. */
+	struct wal_tail tail;
 };
 
 struct wal_msg: public cmsg {
@@ -123,6 +201,9 @@ static struct wal_writer wal_writer_singleton;
 
 struct wal_writer *wal = NULL;
 struct rmean *rmean_tx_wal_bus;
+struct histogram *wal_batch_hist;
+struct histogram *wal_sync_hist;
+struct histogram **wal_latency;
 
 static void
 wal_write_to_disk(struct cmsg *msg);
@@ -209,6 +290,15 @@ tx_schedule_rollback(struct cmsg *msg)
 	stailq_create(&writer->rollback);
 }
 
+static void
+wal_group_commit_timer_cb(ev_loop *loop, ev_timer *timer, int events)
+{
+	(void) loop;
+	(void) events;
+	struct wal_writer *writer = (struct wal_writer *) timer->data;
+	cpipe_flush_input(&writer->wal_pipe);
+}
+
 /**
  * Initialize WAL writer context. Even though it's a singleton,
  * encapsulate the details just in case we may use
@@ -217,25 +307,64 @@ tx_schedule_rollback(struct cmsg *msg)
 static void
 wal_writer_create(struct wal_writer *writer, enum wal_mode wal_mode,
 		  const char *wal_dirname, const struct tt_uuid *server_uuid,
-		  struct vclock *vclock, int64_t rows_per_wal)
+		  struct vclock *vclock, int64_t rows_per_wal,
+		  int64_t max_size, bool prealloc, int64_t tail_size,
+		  enum xlog_compression compression)
 {
 	writer->wal_mode = wal_mode;
 	writer->rows_per_wal = rows_per_wal;
+	writer->max_size = max_size;
+	writer->prealloc = prealloc;
+	snprintf(writer->spare_path, sizeof(writer->spare_path),
+		 "%s/xlog.spare", wal_dirname);
+	snprintf(writer->recycle_path, sizeof(writer->recycle_path),
+		 "%s/xlog.recycle", wal_dirname);
+	writer->spare_state = WAL_SPARE_NONE;
+	writer->spare_f = NULL;
 
 	xdir_create(&writer->wal_dir, wal_dirname, XLOG, server_uuid);
+	writer->wal_dir.compression = compression;
 	writer->current_wal = NULL;
-	if (wal_mode == WAL_FSYNC)
-		(void) strcat(writer->wal_dir.open_wflags, "s");
+	/*
+	 * In fsync mode the file is not opened with O_SYNC:
+	 * the whole batch is synced with a single fdatasync()
+	 * instead, see wal_write_to_disk().
+	 */
 	cbus_create(&writer->tx_wal_bus);
 
 	cpipe_create(&writer->tx_pipe);
 	cpipe_create(&writer->wal_pipe);
 	cpipe_set_max_input(&writer->wal_pipe, IOV_MAX);
 
+	writer->group_commit_delay = 0;
+	ev_timer_init(&writer->group_commit_timer,
+		      wal_group_commit_timer_cb, 0, 0);
+	writer->group_commit_timer.data = writer;
+
 	writer->batch = fio_batch_new();
 	if (writer->batch == NULL)
 		panic_syserror("fio_batch_alloc");
 
+	static const int64_t batch_buckets[] = {
+		1, 2, 4, 8, 16, 32, 64, 128, 256, 512, 1024, 2048, 4096,
+	};
+	static const int64_t sync_buckets[] = {
+		10, 20, 50, 100, 200, 500, 1000, 2000, 5000, 10000,
+		20000, 50000, 100000, 200000, 500000, 1000000,
+	};
+	writer->batch_hist = histogram_new(batch_buckets,
+					   lengthof(batch_buckets));
+	writer->sync_hist = histogram_new(sync_buckets,
+					  lengthof(sync_buckets));
+	if (writer->batch_hist == NULL || writer->sync_hist == NULL)
+		panic("failed to allocate WAL histograms");
+	for (int type = 0; type < IPROTO_TYPE_STAT_MAX; type++) {
+		writer->latency[type] = histogram_new(sync_buckets,
+						      lengthof(sync_buckets));
+		if (writer->latency[type] == NULL)
+			panic("failed to allocate WAL histograms");
+	}
+
 	stailq_create(&writer->rollback);
 	cmsg_init(&writer->in_rollback, NULL);
 
@@ -245,6 +374,18 @@ wal_writer_create(struct wal_writer *writer, enum wal_mode wal_mode,
 
 	tt_pthread_mutex_init(&writer->watchers_mutex, NULL);
 	rlist_create(&writer->watchers);
+
+	struct wal_tail *tail = &writer->tail;
+	tail->buf = NULL;
+	tail->size = tail_size;
+	if (tail_size > 0) {
+		tail->buf = (char *) malloc(tail_size);
+		if (tail->buf == NULL)
+			panic("failed to allocate WAL tail");
+	}
+	tail->start = tail->end = 0;
+	vclock_copy(&tail->vclock, vclock);
+	tt_pthread_mutex_init(&tail->mutex, NULL);
 }
 
 /** Destroy a WAL writer structure. */
@@ -254,7 +395,13 @@ wal_writer_destroy(struct wal_writer *writer)
 	xdir_destroy(&writer->wal_dir);
 	cbus_destroy(&writer->tx_wal_bus);
 	fio_batch_delete(writer->batch);
+	histogram_delete(writer->batch_hist);
+	histogram_delete(writer->sync_hist);
+	for (int type = 0; type < IPROTO_TYPE_STAT_MAX; type++)
+		histogram_delete(writer->latency[type]);
 	tt_pthread_mutex_destroy(&writer->watchers_mutex);
+	free(writer->tail.buf);
+	tt_pthread_mutex_destroy(&writer->tail.mutex);
 }
 
 /** WAL writer thread routine. */
@@ -280,17 +427,23 @@ wal_opt_rotate(struct wal_writer *writer);
 void
 wal_writer_start(enum wal_mode wal_mode, const char *wal_dirname,
 		 const struct tt_uuid *server_uuid, struct vclock *vclock,
-		 int64_t rows_per_wal)
+		 int64_t rows_per_wal, int64_t max_size, bool prealloc,
+		 int64_t tail_size, enum xlog_compression compression)
 {
 	assert(rows_per_wal > 1);
+	assert(max_size > 0);
 
 	struct wal_writer *writer = &wal_writer_singleton;
 
 	/* I. Initialize the state. */
 	wal_writer_create(writer, wal_mode, wal_dirname, server_uuid,
-			vclock, rows_per_wal);
+			vclock, rows_per_wal, max_size, prealloc,
+			tail_size, compression);
 
 	rmean_tx_wal_bus = writer->tx_wal_bus.stats;
+	wal_batch_hist = writer->batch_hist;
+	wal_sync_hist = writer->sync_hist;
+	wal_latency = writer->latency;
 
 	/* II. Start the thread. */
 
@@ -316,6 +469,8 @@ wal_writer_stop()
 {
 	struct wal_writer *writer = wal;
 
+	ev_timer_stop(loop(), &writer->group_commit_timer);
+
 	/* Stop the worker thread. */
 	struct cmsg wakeup;
 	struct cmsg_hop route[1] = {
@@ -335,6 +490,9 @@ wal_writer_stop()
 	wal_writer_destroy(writer);
 
 	rmean_tx_wal_bus = NULL;
+	wal_batch_hist = NULL;
+	wal_sync_hist = NULL;
+	wal_latency = NULL;
 	wal = NULL;
 }
 
@@ -393,6 +551,142 @@ wal_checkpoint(struct wal_writer *writer, struct vclock *vclock, bool rotate)
 	fiber_set_cancellable(true);
 }
 
+/** Zero out a file keeping its blocks allocated, if supported. */
+static int
+wal_zero_range(int fd, off_t size)
+{
+#if defined(HAVE_FALLOCATE) && defined(FALLOC_FL_ZERO_RANGE)
+	return fallocate(fd, FALLOC_FL_ZERO_RANGE, 0, size);
+#else
+	(void) fd;
+	(void) size;
+	errno = ENOTSUP;
+	return -1;
+#endif
+}
+
+/** Allocate space for a file, if supported. */
+static int
+wal_fallocate(int fd, off_t size)
+{
+#if defined(HAVE_FALLOCATE)
+	if (fallocate(fd, 0, 0, size) == 0 || errno == EOPNOTSUPP)
+		return 0;
+	return -1;
+#else
+	(void) fd;
+	(void) size;
+	return 0;
+#endif
+}
+
+/**
+ * Check that nobody has the file open, e.g. a relay still
+ * sending it to a replica: a recycled xlog is zeroed out in
+ * place, under the feet of its readers. A write lease can only
+ * be taken on a file with no other open descriptors.
+ */
+static bool
+wal_file_is_unused(int fd)
+{
+#if defined(F_SETLEASE)
+	if (fcntl(fd, F_SETLEASE, F_WRLCK) != 0)
+		return false;
+	(void) fcntl(fd, F_SETLEASE, F_UNLCK);
+	return true;
+#else
+	(void) fd;
+	return false;
+#endif
+}
+
+/**
+ * Prepare the spare file: take an xlog given away for
+ * recycling, if nobody reads it any more, or create a new
+ * file, zero it out and allocate max_size bytes for it.
+ * Runs in a coeio thread.
+ */
+static ssize_t
+wal_prepare_spare_cb(va_list ap)
+{
+	struct wal_writer *writer = va_arg(ap, struct wal_writer *);
+	const char *spare = writer->spare_path;
+	int fd = -1;
+	if (rename(writer->recycle_path, spare) == 0) {
+		fd = open(spare, O_RDWR);
+		if (fd >= 0 && !wal_file_is_unused(fd)) {
+			/*
+			 * Leave the file to its readers, they
+			 * keep it until they are done with it.
+			 */
+			say_info("`%s' is in use, not recycling it",
+				 writer->recycle_path);
+			close(fd);
+			fd = -1;
+			unlink(spare);
+		}
+	}
+	if (fd < 0)
+		fd = open(spare, O_RDWR | O_CREAT, writer->wal_dir.mode);
+	if (fd < 0)
+		return -1;
+	off_t size = lseek(fd, 0, SEEK_END);
+	int rc = size < 0 ? -1 : 0;
+	/*
+	 * A recycled file or a spare left from the previous
+	 * run must not show old rows to readers of the log.
+	 */
+	if (rc == 0 && size > 0 && wal_zero_range(fd, size) != 0)
+		rc = ftruncate(fd, 0);
+	if (rc == 0)
+		rc = wal_fallocate(fd, writer->max_size);
+	/* Make the allocation durable before it's written to. */
+	if (rc == 0)
+		rc = fsync(fd);
+	int save_errno = errno;
+	close(fd);
+	errno = save_errno;
+	return rc;
+}
+
+static int
+wal_spare_f(va_list ap)
+{
+	struct wal_writer *writer = va_arg(ap, struct wal_writer *);
+	if (coio_call(wal_prepare_spare_cb, writer) == 0) {
+		writer->spare_state = WAL_SPARE_READY;
+	} else {
+		say_syserror("failed to prepare `%s'", writer->spare_path);
+		writer->spare_state = WAL_SPARE_NONE;
+	}
+	return 0;
+}
+
+/**
+ * Start preparing the spare file in background, unless
+ * it's already there.
+ */
+static void
+wal_prepare_spare(struct wal_writer *writer)
+{
+	if (! writer->prealloc || writer->spare_state != WAL_SPARE_NONE)
+		return;
+	if (writer->spare_f != NULL) {
+		/* The previous fiber is finished, collect it. */
+		fiber_join(writer->spare_f);
+		writer->spare_f = NULL;
+	}
+	struct fiber *f = fiber_new("wal_spare", wal_spare_f);
+	if (f == NULL) {
+		error_log(diag_last_error(&fiber()->diag));
+		return;
+	}
+	fiber_set_joinable(f, true);
+	writer->spare_state = WAL_SPARE_PREPARING;
+	writer->spare_f = f;
+	fiber_start(f, writer);
+}
+
 /**
  * If there is no current WAL, try to open it, and close the
  * previous WAL. We close the previous WAL only after opening
@@ -410,7 +704,9 @@ wal_opt_rotate(struct wal_writer *writer)
 
 	ERROR_INJECT_RETURN(ERRINJ_WAL_ROTATE);
 
-	if (l != NULL && l->rows >= writer->rows_per_wal) {
+	if (l != NULL && (l->rows >= writer->rows_per_wal ||
+			  fio_lseek(fileno(l->f), 0, SEEK_CUR) >=
+			  writer->max_size)) {
 		wal_to_close = l;
 		l = NULL;
 	}
@@ -432,7 +728,15 @@ wal_opt_rotate(struct wal_writer *writer)
 			wal_to_close = NULL;
 		}
 		/* Open WAL with '.inprogress' suffix. */
-		l = xlog_create(&writer->wal_dir, &writer->vclock);
+		if (writer->spare_state == WAL_SPARE_READY) {
+			writer->spare_state = WAL_SPARE_NONE;
+			l = xlog_create_from_spare(&writer->wal_dir,
+						   &writer->vclock,
+						   writer->spare_path);
+		}
+		if (l == NULL)
+			l = xlog_create(&writer->wal_dir, &writer->vclock);
+		wal_prepare_spare(writer);
 	}
 	assert(wal_to_close == NULL);
 	writer->current_wal = l;
@@ -501,6 +805,271 @@ wal_writer_begin_rollback(struct wal_writer *writer)
 static void
 wal_notify_watchers(struct wal_writer *writer);
 
+/* {{{ In-memory WAL tail */
+
+static void
+wal_tail_copy_in(struct wal_tail *tail, int64_t pos,
+		 const void *data, size_t len)
+{
+	size_t offset = pos % tail->size;
+	size_t chunk = MIN(len, tail->size - offset);
+	memcpy(tail->buf + offset, data, chunk);
+	memcpy(tail->buf, (const char *) data + chunk, len - chunk);
+}
+
+static void
+wal_tail_copy_out(struct wal_tail *tail, int64_t pos,
+		  void *data, size_t len)
+{
+	size_t offset = pos % tail->size;
+	size_t chunk = MIN(len, tail->size - offset);
+	memcpy(data, tail->buf + offset, chunk);
+	memcpy((char *) data + chunk, tail->buf, len - chunk);
+}
+
+/** Drop the oldest rows until there are @len free bytes. */
+static void
+wal_tail_evict(struct wal_tail *tail, size_t len)
+{
+	while ((size_t) (tail->end - tail->start) + len > tail->size) {
+		struct wal_tail_row hdr;
+		wal_tail_copy_out(tail, tail->start, &hdr, sizeof(hdr));
+		vclock_follow(&tail->vclock, hdr.server_id, hdr.lsn);
+		tail->start += sizeof(hdr) + hdr.len;
+	}
+}
+
+/** A row encoded for the tail before the lock is taken. */
+struct wal_tail_entry {
+	struct xrow_header *row;
+	struct iovec iov[XROW_IOVMAX];
+	int iovcnt;
+};
+
+/**
+ * Skip a row which isn't in the tail: drop the whole tail,
+ * relays will read the row from the file. Readers at the end
+ * of the tail fall behind the new start, so they notice.
+ * Called with the lock held.
+ */
+static void
+wal_tail_skip(struct wal_tail *tail, struct xrow_header *row, size_t len)
+{
+	wal_tail_evict(tail, tail->size);
+	vclock_follow(&tail->vclock, row->server_id, row->lsn);
+	tail->end += len;
+	tail->start = tail->end;
+}
+
+/** Append an encoded row to the tail. Called with the lock held. */
+static void
+wal_tail_append(struct wal_tail *tail, struct wal_tail_entry *entry)
+{
+	struct wal_tail_row hdr;
+	hdr.server_id = entry->row->server_id;
+	hdr.lsn = entry->row->lsn;
+	hdr.len = 0;
+	for (int i = 0; i < entry->iovcnt; i++)
+		hdr.len += entry->iov[i].iov_len;
+	size_t len = sizeof(hdr) + hdr.len;
+	if (len > tail->size) {
+		/* The row doesn't fit. */
+		wal_tail_skip(tail, entry->row, len);
+		return;
+	}
+	wal_tail_evict(tail, len);
+	wal_tail_copy_in(tail, tail->end, &hdr, sizeof(hdr));
+	int64_t pos = tail->end + sizeof(hdr);
+	for (int i = 0; i < entry->iovcnt; i++) {
+		struct iovec *iov = &entry->iov[i];
+		wal_tail_copy_in(tail, pos, iov->iov_base, iov->iov_len);
+		pos += iov->iov_len;
+	}
+	tail->end = pos;
+}
+
+/**
+ * Make the rows of the written requests available to relays.
+ * The rows are encoded before the lock is taken, since the
+ * encoding allocates memory on the fiber region and may throw.
+ * If it fails, the rows are skipped and relays read them from
+ * the file.
+ */
+static void
+wal_tail_append_batch(struct wal_tail *tail, struct stailq *commit)
+{
+	if (tail->buf == NULL)
+		return;
+	struct wal_request *req;
+	int row_count = 0;
+	stailq_foreach_entry(req, commit, fifo)
+		row_count += req->n_rows;
+	if (row_count == 0)
+		return;
+	struct wal_tail_entry *entries;
+	try {
+		size_t size = row_count * sizeof(*entries);
+		entries = (struct wal_tail_entry *)
+			region_alloc_xc(&fiber()->gc, size);
+		struct wal_tail_entry *entry = entries;
+		stailq_foreach_entry(req, commit, fifo) {
+			for (int i = 0; i < req->n_rows; i++, entry++) {
+				entry->row = req->rows[i];
+				entry->iovcnt = xrow_header_encode(entry->row,
+								   entry->iov, 0);
+			}
+		}
+	} catch (Exception *e) {
+		e->log();
+		entries = NULL;
+	}
+	tt_pthread_mutex_lock(&tail->mutex);
+	if (entries != NULL) {
+		for (int i = 0; i < row_count; i++)
+			wal_tail_append(tail, &entries[i]);
+	} else {
+		stailq_foreach_entry(req, commit, fifo) {
+			for (int i = 0; i < req->n_rows; i++)
+				wal_tail_skip(tail, req->rows[i], 1);
+		}
+	}
+	tt_pthread_mutex_unlock(&tail->mutex);
+}
+
+int
+wal_tail_start(struct wal_writer *writer, const struct vclock *vclock,
+	       int64_t *pos)
+{
+	if (writer == NULL || writer->tail.buf == NULL)
+		return -1;
+	struct wal_tail *tail = &writer->tail;
+	int rc = -1;
+	tt_pthread_mutex_lock(&tail->mutex);
+	if (vclock_compare(&tail->vclock, vclock) <= 0) {
+		*pos = tail->start;
+		rc = 0;
+	}
+	tt_pthread_mutex_unlock(&tail->mutex);
+	return rc;
+}
+
+ssize_t
+wal_tail_read(struct wal_writer *writer, int64_t *pos, char **data)
+{
+	if (writer == NULL || writer->tail.buf == NULL)
+		return -1;
+	struct wal_tail *tail = &writer->tail;
+	ssize_t size = -1;
+	tt_pthread_mutex_lock(&tail->mutex);
+	if (*pos >= tail->start) {
+		size = tail->end - *pos;
+		*data = NULL;
+		if (size > 0) {
+			*data = (char *) region_alloc(&fiber()->gc, size);
+			if (*data != NULL)
+				wal_tail_copy_out(tail, *pos, *data, size);
+			else
+				size = -1;
+		}
+		if (size >= 0)
+			*pos = tail->end;
+	}
+	tt_pthread_mutex_unlock(&tail->mutex);
+	return size;
+}
+
+/* }}} */
+
+/**
+ * Write a block of a compressed xlog. A partially written
+ * block is cut off, so that the file ends at a block boundary.
+ */
+static int
+wal_xlog_flush(struct xlog *l)
+{
+	int fd = fileno(l->f);
+	off_t block_start = fio_lseek(fd, 0, SEEK_CUR);
+	if (block_start < 0)
+		panic_syserror("failed to get xlog position");
+	ERROR_INJECT(ERRINJ_WAL_WRITE, { xlog_discard(l); return -1; });
+	if (xlog_flush(l) >= 0)
+		return 0;
+	error_log(diag_last_error(&fiber()->diag));
+	clearerr(l->f);
+	if (ftruncate(fd, block_start) != 0 ||
+	    fio_lseek(fd, block_start, SEEK_SET) != block_start)
+		panic_syserror("failed to rollback xlog");
+	return -1;
+}
+
+/**
+ * Write requests to a compressed xlog. Rows of the requests
+ * are grouped in blocks, and a block is only cut at a request
+ * boundary, so a failed block write rolls back whole requests.
+ * Offsets of requests are calculated in uncompressed bytes.
+ *
+ * @return the number of uncompressed bytes written.
+ */
+static off_t
+wal_write_blocks(struct xlog *l, struct stailq *commit)
+{
+	off_t batched_bytes = 0;
+	off_t written_bytes = 0;
+	struct wal_request *req;
+	stailq_foreach_entry(req, commit, fifo)
+		req->end_offset = -1;
+
+	stailq_foreach_entry(req, commit, fifo) {
+		req->start_offset = batched_bytes;
+		struct xrow_header **row = req->rows;
+		for (; row < req->rows + req->n_rows; row++) {
+			ssize_t size = xlog_add_row(l, *row);
+			if (size < 0) {
+				error_log(diag_last_error(&fiber()->diag));
+				xlog_discard(l);
+				return written_bytes;
+			}
+			batched_bytes += size;
+		}
+		req->end_offset = batched_bytes;
+		if (l->wbuf_used >= XLOG_BLOCK_SIZE) {
+			if (wal_xlog_flush(l) != 0)
+				return written_bytes;
+			written_bytes = batched_bytes;
+		}
+	}
+	if (wal_xlog_flush(l) == 0)
+		written_bytes = batched_bytes;
+	return written_bytes;
+}
+
+/**
+ * Sync a batch of requests written to the WAL to disk with a
+ * single fdatasync(). If the sync fails, nothing of the batch
+ * can be considered durable, so it's cut off the file.
+ *
+ * @param batch_start  absolute position of the batch in the file
+ * @param written_bytes  the size of the written batch
+ * @return the number of bytes of the batch which are on disk.
+ */
+static off_t
+wal_sync_batch(struct wal_writer *writer, struct xlog *l,
+	       off_t batch_start, off_t written_bytes)
+{
+	int fd = fileno(l->f);
+	uint64_t start = clock_monotonic64();
+	if (fdatasync(fd) == 0) {
+		histogram_collect(writer->sync_hist,
+				  (clock_monotonic64() - start) / 1000);
+		return written_bytes;
+	}
+	say_syserror("failed to sync xlog");
+	if (ftruncate(fd, batch_start) != 0 ||
+	    fio_lseek(fd, batch_start, SEEK_SET) != batch_start)
+		panic_syserror("failed to rollback xlog");
+	return 0;
+}
+
 static void
 wal_write_to_disk(struct cmsg *msg)
 {
@@ -541,6 +1110,13 @@ wal_write_to_disk(struct cmsg *msg)
 	 */
 
 	struct xlog *l = writer->current_wal;
+	/* Absolute position of the batch, used if fdatasync() fails */
+	off_t batch_start = 0;
+	if (writer->wal_mode == WAL_FSYNC) {
+		batch_start = fio_lseek(fileno(l->f), 0, SEEK_CUR);
+		if (batch_start < 0)
+			panic_syserror("failed to get xlog position");
+	}
 	/* The size of batched data */
 	off_t batched_bytes = 0;
 	/* The size of written data */
@@ -553,6 +1129,11 @@ wal_write_to_disk(struct cmsg *msg)
 	 * Iterate over requests (transactions)
 	 */
 	struct wal_request *req;
+	if (l->is_compressed) {
+		written_bytes = wal_write_blocks(l, &wal_msg->commit);
+		req = NULL;
+		goto done;
+	}
 	stailq_foreach_entry(req, &wal_msg->commit, fifo) {
 		/* Save relative offset of request start */
 		req->start_offset = batched_bytes;
@@ -601,11 +1182,20 @@ wal_write_to_disk(struct cmsg *msg)
 	}
 
 done:
+	/*
+	 * In fsync mode committers are only woken up after the
+	 * whole batch is on disk, so a single sync is shared by
+	 * all transactions of the batch (group commit).
+	 */
+	if (writer->wal_mode == WAL_FSYNC && written_bytes > 0)
+		written_bytes = wal_sync_batch(writer, l, batch_start,
+					       written_bytes);
 	/*
 	 * Iterate over `input` queue and add all processed requests to
 	 * `commit` queue and all other to `rollback` queue.
 	 */
 	struct wal_request *reqend = req;
+	int64_t batch_rows = 0;
 	for (req = stailq_first_entry(&wal_msg->commit, struct wal_request, fifo);
 	     req != reqend;
 	     req = stailq_next_entry(req, fifo)) {
@@ -647,10 +1237,15 @@ done:
 			      req->rows[req->n_rows - 1]->lsn);
 		/* Update row counter for wal_opt_rotate() */
 		l->rows += req->n_rows;
+		batch_rows += req->n_rows;
 		/* Mark request as successful for tx thread */
 		req->res = vclock_sum(&writer->vclock);
 	}
+	/* The requests which failed are moved to `rollback`. */
+	wal_tail_append_batch(&writer->tail, &wal_msg->commit);
 
+	if (batch_rows > 0)
+		histogram_collect(writer->batch_hist, batch_rows);
 	fiber_gc();
 	wal_notify_watchers(writer);
 }
@@ -665,9 +1260,13 @@ wal_writer_f(va_list ap)
 
 	writer->main_f = fiber();
 	cbus_join(&writer->tx_wal_bus, &writer->wal_pipe);
+	wal_prepare_spare(writer);
 
 	fiber_yield();
 
+	if (writer->spare_f != NULL)
+		fiber_join(writer->spare_f);
+
 	if (writer->current_wal != NULL) {
 		xlog_close(writer->current_wal);
 		writer->current_wal = NULL;
@@ -697,6 +1296,7 @@ wal_write(struct wal_writer *writer, struct wal_request *req)
 
 	req->fiber = fiber();
 	req->res = -1;
+	uint64_t start = clock_monotonic64();
 
 	struct wal_msg *batch;
 	if (!stailq_empty(&writer->wal_pipe.input) &&
@@ -711,14 +1311,27 @@ wal_write(struct wal_writer *writer, struct wal_request *req)
 		wal_msg_create(batch);
 		/*
 		 * Sic: first add a request, then push the batch,
-		 * since cpipe_push() may pass the batch to WAL
+		 * since cpipe_push_input() may pass the batch to WAL
 		 * thread right away.
 		 */
 		stailq_add_tail_entry(&batch->commit, req, fifo);
-		cpipe_push(&writer->wal_pipe, batch);
+		cpipe_push_input(&writer->wal_pipe, batch);
 	}
 	writer->wal_pipe.n_input += req->n_rows * XROW_IOVMAX;
-	cpipe_flush_input(&writer->wal_pipe);
+	if (writer->group_commit_delay > 0 &&
+	    writer->wal_pipe.n_input < writer->wal_pipe.max_input) {
+		/*
+		 * Hold the batch in the pipe to let more
+		 * transactions join it, unless it's full.
+		 */
+		if (! ev_is_active(&writer->group_commit_timer)) {
+			ev_timer_set(&writer->group_commit_timer,
+				     writer->group_commit_delay, 0);
+			ev_timer_start(loop(), &writer->group_commit_timer);
+		}
+	} else {
+		cpipe_flush_input(&writer->wal_pipe);
+	}
 	/**
 	 * It's not safe to spuriously wakeup this fiber
 	 * since in that case it will ignore a possible
@@ -728,9 +1341,24 @@ wal_write(struct wal_writer *writer, struct wal_request *req)
 	bool cancellable = fiber_set_cancellable(false);
 	fiber_yield(); /* Request was inserted. */
 	fiber_set_cancellable(cancellable);
+	uint32_t type = req->n_rows > 0 ? req->rows[0]->type : 0;
+	if (type < IPROTO_TYPE_STAT_MAX) {
+		histogram_collect(writer->latency[type],
+				  (clock_monotonic64() - start) / 1000);
+	}
 	return req->res;
 }
 
+void
+wal_set_group_commit_delay(struct wal_writer *writer, double delay)
+{
+	writer->group_commit_delay = delay;
+	if (delay == 0) {
+		ev_timer_stop(loop(), &writer->group_commit_timer);
+		cpipe_flush_input(&writer->wal_pipe);
+	}
+}
+
 int
 wal_set_watcher(struct wal_writer *writer, struct wal_watcher *watcher,
 		struct ev_async *async)
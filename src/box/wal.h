@@ -34,6 +34,7 @@
 #include <sys/types.h>
 #include "small/rlist.h"
 #include "salad/stailq.h"
+#include "xlog.h"
 
 struct fiber;
 struct wal_writer;
@@ -45,6 +46,11 @@ extern const char *wal_mode_STRS[];
 
 extern struct wal_writer *wal;
 extern struct rmean *rmean_tx_wal_bus;
+/** Rows per WAL batch and batch fdatasync() latency (usec). */
+extern struct histogram *wal_batch_hist;
+extern struct histogram *wal_sync_hist;
+/** wal_write() latency (usec), by request type, see wal.cc. */
+extern struct histogram **wal_latency;
 
 #if defined(__cplusplus)
 
@@ -71,11 +77,19 @@ wal_write(struct wal_writer *writer, struct wal_request *req);
 void
 wal_writer_start(enum wal_mode wal_mode, const char *wal_dirname,
 		 const struct tt_uuid *server_uuid, struct vclock *vclock,
-		 int64_t rows_per_wal);
+		 int64_t rows_per_wal, int64_t max_size, bool prealloc,
+		 int64_t tail_size, enum xlog_compression compression);
 
 void
 wal_writer_stop();
 
+/**
+ * Set the time a WAL write request may wait in tx thread for
+ * other requests to join its batch. 0 means no waiting.
+ */
+void
+wal_set_group_commit_delay(struct wal_writer *writer, double delay);
+
 struct wal_watcher
 {
 	struct rlist next;
@@ -95,6 +109,40 @@ wal_set_watcher(struct wal_writer *, struct wal_watcher *,
 void
 wal_clear_watcher(struct wal_writer *, struct wal_watcher *);
 
+/**
+ * A row in the in-memory WAL tail, followed by @len bytes
+ * of the row encoded with xrow_header_encode().
+ */
+struct wal_tail_row {
+	uint32_t server_id;
+	uint32_t len;
+	int64_t lsn;
+};
+
+/**
+ * Find the first row of the in-memory WAL tail, if the tail
+ * has all rows newer than @vclock, i.e. if a reader at
+ * @vclock can follow the WAL from memory.
+ *
+ * @retval 0 *pos is set to the position of the first row
+ * @retval -1 the rows are not in memory any more
+ */
+int
+wal_tail_start(struct wal_writer *writer, const struct vclock *vclock,
+	       int64_t *pos);
+
+/**
+ * Copy rows written to the WAL after @pos from the in-memory
+ * WAL tail to the fiber region, as a sequence of struct
+ * wal_tail_row, and advance @pos to the end of the tail.
+ *
+ * @return the size of the copied rows, or -1 if the rows at
+ *         @pos have been overwritten or there is not enough
+ *         memory to copy them.
+ */
+ssize_t
+wal_tail_read(struct wal_writer *writer, int64_t *pos, char **data);
+
 void
 wal_atfork();
 
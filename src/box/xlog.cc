@@ -34,11 +34,14 @@
 #include <ctype.h>
 
 #include "fiber.h"
+#include "clock.h"
 #include "crc32.h"
 #include "fio.h"
 #include "fiob.h"
 #include "third_party/tarantool_eio.h"
 #include <msgpuck.h>
+#include <lz4.h>
+#include <zstd_static.h>
 #include "scoped_guard.h"
 
 #include "error.h"
@@ -55,8 +58,20 @@ typedef uint32_t log_magic_t;
 
 static const log_magic_t row_marker = mp_bswap_u32(0xd5ba0bab); /* host byte order */
 static const log_magic_t eof_marker = mp_bswap_u32(0xd510aded); /* host byte order */
+static const log_magic_t block_marker = mp_bswap_u32(0xd5b10cc5); /* host byte order */
 static const char inprogress_suffix[] = ".inprogress";
 static const char v12[] = "0.12\n";
+/** Rows are grouped in compressed blocks. */
+static const char v13[] = "0.13\n";
+
+const char *xlog_compression_STRS[] = { "none", "lz4", "zstd", NULL };
+
+enum {
+	/** Block marker, compression, sizes, crc32 and padding. */
+	XLOG_BLOCK_FIXHEADER_SIZE = 24,
+	/** A fast ZSTD compression level. */
+	XLOG_ZSTD_LEVEL = 3,
+};
 
 const struct type type_XlogError = make_type("XlogError", &type_Exception);
 XlogError::XlogError(const char *file, unsigned line,
@@ -385,87 +400,373 @@ format_filename(struct xdir *dir, int64_t signature,
 
 /* {{{ struct xlog_cursor */
 
+enum {
+	/** Size of a block read from an xlog file at once. */
+	XLOG_READ_BLOCK = 1024 * 1024,
+	/** Block reads end on this boundary when possible. */
+	XLOG_READ_ALIGN = 4096,
+	/** How often to report recovery progress, in rows. */
+	XLOG_STAT_ROWS = 100000,
+};
+
+/** File offset of the current read position of a cursor. */
+static inline off_t
+xlog_cursor_pos(struct xlog_cursor *i)
+{
+	return i->read_offset - (i->rend - i->rpos);
+}
+
+/**
+ * Read up to @a count bytes at @a offset. Regular files are
+ * read with pread(), other streams (e.g. bootstrap.snap, which
+ * is an fmemopen() stream) through stdio.
+ */
+static ssize_t
+xlog_pread(struct xlog *l, char *buf, size_t count, off_t offset)
+{
+	int fd = fileno(l->f);
+	if (fd < 0) {
+		if (fseeko(l->f, offset, SEEK_SET) != 0)
+			return -1;
+		size_t n = fread(buf, 1, count, l->f);
+		return n == 0 && ferror(l->f) ? -1 : (ssize_t) n;
+	}
+	ssize_t n;
+	do {
+		n = pread(fd, buf, count, offset);
+	} while (n < 0 && errno == EINTR);
+	return n;
+}
+
 /**
+ * Make sure at least @a size bytes are available in the read
+ * buffer, reading the file in large blocks. Moves the unread
+ * data to the beginning of the buffer, so all pointers to the
+ * buffer are invalidated.
+ *
  * @retval -1 error
  * @retval 0 success
- * @retval 1 EOF
+ * @retval 1 EOF: the file has less data
  */
 static int
-row_reader(FILE *f, struct xrow_header *row)
+xlog_cursor_ensure(struct xlog_cursor *i, size_t size)
 {
-	const char *data;
+	size_t unread = i->rend - i->rpos;
+	if (unread >= size)
+		return 0;
 
-	/* Read fixed header */
-	char fixheader[XLOG_FIXHEADER_SIZE - sizeof(log_magic_t)];
-	if (fread(fixheader, sizeof(fixheader), 1, f) != 1) {
-		if (feof(f))
+	size_t rbuf_size = MAX(i->rbuf_size, (size_t) XLOG_READ_BLOCK);
+	while (rbuf_size < size)
+		rbuf_size *= 2;
+	if (rbuf_size > i->rbuf_size) {
+		char *rbuf = (char *) malloc(rbuf_size);
+		if (rbuf == NULL) {
+			tnt_error(OutOfMemory, rbuf_size, "malloc",
+				  "xlog read buffer");
+			return -1;
+		}
+		memcpy(rbuf, i->rpos, unread);
+		free(i->rbuf);
+		i->rbuf = rbuf;
+		i->rbuf_size = rbuf_size;
+	} else {
+		memmove(i->rbuf, i->rpos, unread);
+	}
+	i->rpos = i->rbuf;
+	i->rend = i->rbuf + unread;
+
+	while ((size_t) (i->rend - i->rpos) < size) {
+		size_t count = i->rbuf + i->rbuf_size - i->rend;
+		size_t need = size - (i->rend - i->rpos);
+		/* Keep subsequent reads aligned. */
+		size_t tail = (i->read_offset + count) % XLOG_READ_ALIGN;
+		if (tail < count && count - tail >= need)
+			count -= tail;
+		ssize_t n = xlog_pread(i->log, i->rend, count,
+				       i->read_offset);
+		if (n < 0) {
+			tnt_error(SystemError, "%s: failed to read file",
+				  i->log->filename);
+			return -1;
+		}
+		if (n == 0)
 			return 1;
-error:
-		char buf[PATH_MAX];
-		snprintf(buf, sizeof(buf), "%s: failed to read or parse row "
-			 "header at offset %" PRIu64, fio_filename(fileno(f)),
-			 (uint64_t) ftello(f));
-		tnt_error(ClientError, ER_INVALID_MSGPACK, buf);
+		i->rend += n;
+		i->read_offset += n;
+	}
+#if defined(HAVE_POSIX_FADVISE)
+	int fd = fileno(i->log->f);
+	if (fd >= 0) {
+		posix_fadvise(fd, i->read_offset, XLOG_READ_BLOCK,
+			      POSIX_FADV_WILLNEED);
+	}
+#endif /* HAVE_POSIX_FADVISE */
+	return 0;
+}
+
+/**
+ * Check if the cursor is at the preallocated tail of a log:
+ * the rest of the read buffer, at least a page or up to the
+ * end of the file, is zeros. A few zero bytes followed by data
+ * are garbage to skip rather than the end of the log.
+ *
+ * @retval -1 error
+ * @retval 0 there is data past the read position
+ * @retval 1 only zeros follow
+ */
+static int
+xlog_cursor_at_zero_tail(struct xlog_cursor *i)
+{
+	if (xlog_cursor_ensure(i, XLOG_READ_ALIGN) < 0)
 		return -1;
+	for (const char *pos = i->rpos; pos < i->rend; pos++) {
+		if (*pos != 0)
+			return 0;
 	}
+	return 1;
+}
 
-	/* Decode len, previous crc32 and row crc32 */
-	data = fixheader;
-	if (mp_check(&data, data + sizeof(fixheader)) != 0)
-		goto error;
-	data = fixheader;
+/**
+ * Set a parse error of the log at the given offset.
+ */
+static void
+xlog_cursor_error(struct xlog_cursor *i, off_t offset, const char *what)
+{
+	char buf[PATH_MAX];
+	snprintf(buf, sizeof(buf), "%s: %s at offset %" PRIu64,
+		 i->log->filename, what, (uint64_t) offset);
+	tnt_error(ClientError, ER_INVALID_MSGPACK, buf);
+}
 
-	/* Read length */
-	if (mp_typeof(*data) != MP_UINT)
-		goto error;
-	uint32_t len = mp_decode_uint(&data);
+/**
+ * Decode @a count MP_UINT fields of a fixed header which
+ * follows a row or block marker.
+ */
+static int
+xlog_decode_fixheader(const char *data, const char *end,
+		      uint32_t *fields, int count)
+{
+	for (int k = 0; k < count; k++) {
+		const char *field = data;
+		if (data >= end || mp_typeof(*data) != MP_UINT ||
+		    mp_check(&field, end) != 0)
+			return -1;
+		uint64_t value = mp_decode_uint(&data);
+		if (value > UINT32_MAX)
+			return -1;
+		fields[k] = value;
+	}
+	return 0;
+}
+
+/**
+ * Decode a row located in memory at @a data, which must point
+ * at a row marker. The row body is not copied.
+ *
+ * @retval -1 error
+ * @retval 0 success, @a data is advanced past the row
+ * @retval 1 the row is incomplete, @a size is set to its size
+ */
+static int
+xlog_cursor_decode_row(struct xlog_cursor *i, const char **data,
+		       const char *end, off_t offset, size_t *size,
+		       struct xrow_header *row)
+{
+	if (end - *data < XLOG_FIXHEADER_SIZE) {
+		*size = XLOG_FIXHEADER_SIZE;
+		return 1;
+	}
+	/* Decode len, previous crc32 and row crc32 */
+	uint32_t fixheader[3];
+	if (xlog_decode_fixheader(*data + sizeof(log_magic_t),
+				  *data + XLOG_FIXHEADER_SIZE,
+				  fixheader, 3) != 0) {
+		xlog_cursor_error(i, offset, "failed to read or parse "
+				  "row header");
+		return -1;
+	}
+	uint32_t len = fixheader[0];
+	uint32_t crc32c = fixheader[2];
 	if (len > IPROTO_BODY_LEN_MAX) {
-		char buf[PATH_MAX];
-		snprintf(buf, sizeof(buf),
-			 "%s: row is too big at offset %" PRIu64,
-			 fio_filename(fileno(f)), (uint64_t) ftello(f));
-		tnt_error(ClientError, ER_INVALID_MSGPACK, buf);
+		xlog_cursor_error(i, offset, "row is too big");
 		return -1;
 	}
+	if ((size_t) (end - *data) < XLOG_FIXHEADER_SIZE + len) {
+		*size = XLOG_FIXHEADER_SIZE + len;
+		return 1;
+	}
+	const char *body = *data + XLOG_FIXHEADER_SIZE;
 
-	/* Read previous crc32 */
-	if (mp_typeof(*data) != MP_UINT)
-		goto error;
-
-	/* Read current crc32 */
-	uint32_t crc32p = mp_decode_uint(&data);
-	if (mp_typeof(*data) != MP_UINT)
-		goto error;
-	uint32_t crc32c = mp_decode_uint(&data);
-	assert(data <= fixheader + sizeof(fixheader));
-	(void) crc32p;
-
-	/* Allocate memory for body */
-	char *bodybuf = (char *) region_alloc(&fiber()->gc, len);
-	if (bodybuf == NULL) {
-		tnt_error(OutOfMemory, len, "region", "new slab");
+	/* Validate checksum */
+	if (crc32_calc(0, body, len) != crc32c) {
+		char what[64];
+		snprintf(what, sizeof(what), "row checksum mismatch "
+			 "(expected %u)", (unsigned) crc32c);
+		xlog_cursor_error(i, offset, what);
 		return -1;
 	}
 
-	/* Read header and body */
-	if (fread(bodybuf, len, 1, f) != 1)
-		return 1;
+	const char *pos = body;
+	xrow_header_decode(row, &pos, body + len);
+	*data = body + len;
+	return 0;
+}
 
-	/* Validate checksum */
-	if (crc32_calc(0, bodybuf, len) != crc32c) {
-		char buf[PATH_MAX];
-
-		snprintf(buf, sizeof(buf), "%s: row checksum mismatch (expected %u)"
-			 " at offset %" PRIu64,
-			 fio_filename(fileno(f)), (unsigned) crc32c,
-			 (uint64_t) ftello(f));
-		tnt_error(ClientError, ER_INVALID_MSGPACK, buf);
+/**
+ * Decode the row at the current read position of a log
+ * without compression. The read position must point at
+ * a row marker.
+ *
+ * @retval -1 error
+ * @retval 0 success
+ * @retval 1 EOF
+ */
+static int
+xlog_cursor_read_row(struct xlog_cursor *i, struct xrow_header *row)
+{
+	off_t offset = xlog_cursor_pos(i);
+	size_t size = XLOG_FIXHEADER_SIZE;
+	for (;;) {
+		int rc = xlog_cursor_ensure(i, size);
+		if (rc != 0)
+			return rc;
+		const char *data = i->rpos;
+		rc = xlog_cursor_decode_row(i, &data, i->rend, offset,
+					    &size, row);
+		if (rc <= 0) {
+			if (rc == 0)
+				i->rpos = (char *) data;
+			return rc;
+		}
+	}
+}
+
+static size_t
+xlog_compress_bound(enum xlog_compression compression, size_t size)
+{
+	switch (compression) {
+	case XLOG_COMPRESSION_LZ4:
+		return LZ4_compressBound(size);
+	case XLOG_COMPRESSION_ZSTD:
+		return ZSTD_compressBound(size);
+	default:
+		return size;
+	}
+}
+
+/**
+ * @return the size of compressed data, -1 on error.
+ */
+static ssize_t
+xlog_compress(enum xlog_compression compression, const char *src,
+	      size_t src_size, char *dst, size_t dst_size)
+{
+	switch (compression) {
+	case XLOG_COMPRESSION_LZ4: {
+		int size = LZ4_compress_default(src, dst, src_size,
+						dst_size);
+		return size > 0 ? size : -1;
+	}
+	case XLOG_COMPRESSION_ZSTD: {
+		size_t size = ZSTD_compress(dst, dst_size, src, src_size,
+					    XLOG_ZSTD_LEVEL);
+		return ZSTD_isError(size) ? -1 : (ssize_t) size;
+	}
+	default:
+		unreachable();
+	}
+	return -1;
+}
+
+/**
+ * @return the size of decompressed data, -1 on error.
+ */
+static ssize_t
+xlog_decompress(enum xlog_compression compression, const char *src,
+		size_t src_size, char *dst, size_t dst_size)
+{
+	switch (compression) {
+	case XLOG_COMPRESSION_NONE:
+		if (src_size > dst_size)
+			return -1;
+		memcpy(dst, src, src_size);
+		return src_size;
+	case XLOG_COMPRESSION_LZ4: {
+		int size = LZ4_decompress_safe(src, dst, src_size, dst_size);
+		return size >= 0 ? size : -1;
+	}
+	case XLOG_COMPRESSION_ZSTD: {
+		size_t size = ZSTD_decompress(dst, dst_size, src, src_size);
+		return ZSTD_isError(size) ? -1 : (ssize_t) size;
+	}
+	default:
+		return -1;
+	}
+}
+
+/**
+ * Read and decompress the block at the current read position,
+ * which must point at a block marker.
+ *
+ * @retval -1 error
+ * @retval 0 success
+ * @retval 1 EOF
+ */
+static int
+xlog_cursor_read_block(struct xlog_cursor *i)
+{
+	off_t offset = xlog_cursor_pos(i);
+	int rc = xlog_cursor_ensure(i, XLOG_BLOCK_FIXHEADER_SIZE);
+	if (rc != 0)
+		return rc;
+
+	/* Decode compression, compressed and raw size and crc32 */
+	uint32_t fixheader[4];
+	if (xlog_decode_fixheader(i->rpos + sizeof(log_magic_t),
+				  i->rpos + XLOG_BLOCK_FIXHEADER_SIZE,
+				  fixheader, 4) != 0) {
+		xlog_cursor_error(i, offset, "failed to read or parse "
+				  "block header");
+		return -1;
+	}
+	uint32_t compression = fixheader[0];
+	uint32_t zlen = fixheader[1];
+	uint32_t len = fixheader[2];
+	uint32_t crc32c = fixheader[3];
+	if (compression >= XLOG_COMPRESSION_MAX ||
+	    zlen > IPROTO_BODY_LEN_MAX || len > IPROTO_BODY_LEN_MAX) {
+		xlog_cursor_error(i, offset, "invalid block header");
 		return -1;
 	}
 
-	data = bodybuf;
-	xrow_header_decode(row, &data, bodybuf + len);
+	rc = xlog_cursor_ensure(i, XLOG_BLOCK_FIXHEADER_SIZE + zlen);
+	if (rc != 0)
+		return rc;
+	const char *payload = i->rpos + XLOG_BLOCK_FIXHEADER_SIZE;
+	if (crc32_calc(0, payload, zlen) != crc32c) {
+		xlog_cursor_error(i, offset, "block checksum mismatch");
+		return -1;
+	}
 
+	if (i->zbuf_size < len) {
+		char *zbuf = (char *) realloc(i->zbuf, len);
+		if (zbuf == NULL) {
+			tnt_error(OutOfMemory, len, "realloc",
+				  "xlog block");
+			return -1;
+		}
+		i->zbuf = zbuf;
+		i->zbuf_size = len;
+	}
+	if (xlog_decompress((enum xlog_compression) compression,
+			    payload, zlen, i->zbuf, len) != (ssize_t) len) {
+		xlog_cursor_error(i, offset, "failed to decompress block");
+		return -1;
+	}
+	i->zpos = i->zbuf;
+	i->zend = i->zbuf + len;
+	i->rpos = (char *) payload + zlen;
+	i->block_end = xlog_cursor_pos(i);
 	return 0;
 }
 
@@ -501,6 +802,196 @@ xlog_encode_row(const struct xrow_header *row, struct iovec *iov)
 	return iovcnt;
 }
 
+/**
+ * Append an encoded row to a growing buffer.
+ *
+ * @return the size of the row, -1 in case of error.
+ */
+static ssize_t
+xlog_buf_add_row(char **buf, size_t *buf_size, size_t *buf_used,
+		 const struct xrow_header *row)
+{
+	struct iovec iov[XROW_IOVMAX];
+	int iovcnt = xlog_encode_row(row, iov);
+	size_t size = 0;
+	for (int k = 0; k < iovcnt; k++)
+		size += iov[k].iov_len;
+
+	if (*buf_used + size > *buf_size) {
+		size_t new_size = MAX(*buf_size, (size_t) XLOG_BLOCK_SIZE);
+		while (new_size < *buf_used + size)
+			new_size *= 2;
+		char *new_buf = (char *) realloc(*buf, new_size);
+		if (new_buf == NULL) {
+			tnt_error(OutOfMemory, new_size, "realloc",
+				  "xlog block");
+			return -1;
+		}
+		*buf = new_buf;
+		*buf_size = new_size;
+	}
+	for (int k = 0; k < iovcnt; k++) {
+		memcpy(*buf + *buf_used, iov[k].iov_base, iov[k].iov_len);
+		*buf_used += iov[k].iov_len;
+	}
+	return size;
+}
+
+/**
+ * Pack @a len bytes of encoded rows into a block, compressed
+ * if it makes the block smaller. The block is built in
+ * @a zbuf, which is grown as necessary.
+ *
+ * @return the size of the block, -1 in case of error.
+ */
+static ssize_t
+xlog_encode_block(enum xlog_compression compression, const char *src,
+		  size_t len, char **zbuf, size_t *zbuf_size)
+{
+	size_t bound = MAX(xlog_compress_bound(compression, len), len);
+	size_t size = XLOG_BLOCK_FIXHEADER_SIZE + bound;
+	if (*zbuf_size < size) {
+		char *new_zbuf = (char *) realloc(*zbuf, size);
+		if (new_zbuf == NULL) {
+			tnt_error(OutOfMemory, size, "realloc", "xlog block");
+			return -1;
+		}
+		*zbuf = new_zbuf;
+		*zbuf_size = size;
+	}
+	char *payload = *zbuf + XLOG_BLOCK_FIXHEADER_SIZE;
+	ssize_t zlen = -1;
+	if (compression != XLOG_COMPRESSION_NONE)
+		zlen = xlog_compress(compression, src, len, payload, bound);
+	if (zlen < 0 || (size_t) zlen >= len) {
+		/* Store incompressible data as is. */
+		compression = XLOG_COMPRESSION_NONE;
+		memcpy(payload, src, len);
+		zlen = len;
+	}
+
+	char *data = *zbuf;
+	*(log_magic_t *) data = block_marker;
+	data += sizeof(block_marker);
+	data = mp_encode_uint(data, compression);
+	data = mp_encode_uint(data, zlen);
+	data = mp_encode_uint(data, len);
+	data = mp_encode_uint(data, crc32_calc(0, payload, zlen));
+	/* Encode padding */
+	ssize_t padding = XLOG_BLOCK_FIXHEADER_SIZE - (data - *zbuf);
+	assert(padding > 0);
+	data = mp_encode_strl(data, padding - 1) + padding - 1;
+	assert(data == payload);
+	return XLOG_BLOCK_FIXHEADER_SIZE + zlen;
+}
+
+ssize_t
+xlog_add_row(struct xlog *l, const struct xrow_header *row)
+{
+	assert(l->is_compressed);
+	return xlog_buf_add_row(&l->wbuf, &l->wbuf_size, &l->wbuf_used, row);
+}
+
+ssize_t
+xlog_flush(struct xlog *l)
+{
+	if (!l->is_compressed || l->wbuf_used == 0)
+		return 0;
+
+	ssize_t size = xlog_encode_block(l->compression, l->wbuf,
+					 l->wbuf_used, &l->zbuf,
+					 &l->zbuf_size);
+	xlog_discard(l);
+	if (size < 0)
+		return -1;
+	if (fwrite(l->zbuf, size, 1, l->f) != 1) {
+		tnt_error(SystemError, "%s: failed to write block",
+			  l->filename);
+		return -1;
+	}
+	return size;
+}
+
+void
+xlog_batch_destroy(struct xlog_batch *batch)
+{
+	free(batch->data);
+	free(batch->zbuf);
+}
+
+ssize_t
+xlog_batch_add_row(struct xlog_batch *batch, const struct xrow_header *row)
+{
+	assert(batch->zused == 0);
+	ssize_t size = xlog_buf_add_row(&batch->data, &batch->size,
+					&batch->used, row);
+	if (size >= 0)
+		batch->rows++;
+	return size;
+}
+
+int
+xlog_batch_seal(struct xlog_batch *batch, enum xlog_compression compression)
+{
+	if (compression == XLOG_COMPRESSION_NONE || batch->used == 0)
+		return 0;
+	ssize_t size = xlog_encode_block(compression, batch->data,
+					 batch->used, &batch->zbuf,
+					 &batch->zbuf_size);
+	if (size < 0)
+		return -1;
+	batch->zused = size;
+	return 0;
+}
+
+ssize_t
+xlog_write_batch(struct xlog *l, struct xlog_batch *batch)
+{
+	if (xlog_flush(l) < 0)
+		return -1;
+	const char *data = batch->data;
+	size_t size = batch->used;
+	if (l->is_compressed && size > 0) {
+		assert(batch->zused > 0);
+		data = batch->zbuf;
+		size = batch->zused;
+	}
+	if (size > 0 && fwrite(data, size, 1, l->f) != 1) {
+		tnt_error(SystemError, "%s: failed to write %zu bytes",
+			  l->filename, size);
+		return -1;
+	}
+	l->rows += batch->rows;
+	return size;
+}
+
+ssize_t
+xlog_write_row(struct xlog *l, const struct xrow_header *row)
+{
+	if (l->is_compressed) {
+		if (xlog_add_row(l, row) < 0)
+			return -1;
+		if (l->wbuf_used < XLOG_BLOCK_SIZE)
+			return 0;
+		return xlog_flush(l);
+	}
+
+	struct iovec iov[XROW_IOVMAX];
+	int iovcnt = xlog_encode_row(row, iov);
+	ssize_t size = 0;
+	/* TODO: use writev here */
+	for (int k = 0; k < iovcnt; k++) {
+		if (fwrite(iov[k].iov_base, iov[k].iov_len, 1, l->f) != 1) {
+			tnt_error(SystemError, "%s: failed to write row "
+				  "(%zu bytes)", l->filename,
+				  iov[k].iov_len);
+			return -1;
+		}
+		size += iov[k].iov_len;
+	}
+	return size;
+}
+
 void
 xlog_cursor_open(struct xlog_cursor *i, struct xlog *l)
 {
@@ -508,6 +999,21 @@ xlog_cursor_open(struct xlog_cursor *i, struct xlog *l)
 	i->row_count = 0;
 	i->good_offset = ftello(l->f);
 	i->eof_read  = false;
+	i->rbuf = NULL;
+	i->rbuf_size = 0;
+	i->rpos = i->rend = NULL;
+	i->read_offset = i->good_offset;
+	i->zbuf = NULL;
+	i->zbuf_size = 0;
+	i->zpos = i->zend = NULL;
+	i->block_end = i->good_offset;
+	i->start_offset = i->good_offset;
+	i->start_time = clock_monotonic();
+#if defined(HAVE_POSIX_FADVISE)
+	int fd = fileno(l->f);
+	if (fd >= 0)
+		posix_fadvise(fd, i->good_offset, 0, POSIX_FADV_SEQUENTIAL);
+#endif /* HAVE_POSIX_FADVISE */
 }
 
 void
@@ -516,16 +1022,67 @@ xlog_cursor_close(struct xlog_cursor *i)
 	struct xlog *l = i->log;
 	l->rows += i->row_count;
 	l->eof_read = i->eof_read;
+	if (i->row_count >= XLOG_STAT_ROWS) {
+		double elapsed = clock_monotonic() - i->start_time;
+		double mb = (i->good_offset - i->start_offset) /
+			    (1024. * 1024.);
+		if (elapsed <= 0)
+			elapsed = 1e-6;
+		say_info("%s: read %d rows, %.1f MB in %.3f sec "
+			 "(%.0f rows/s, %.1f MB/s)", l->filename,
+			 i->row_count, mb, elapsed,
+			 i->row_count / elapsed, mb / elapsed);
+	}
 	/*
 	 * Since we don't close the xlog
 	 * we must rewind it to the last known
 	 * good position if there was an error.
 	 * Seek back to last known good offset.
+	 * If a block of a compressed log has not been
+	 * read till the end, this is the block start,
+	 * so the next cursor will return its first rows
+	 * again: recovery skips them by LSN.
 	 */
 	fseeko(l->f, i->good_offset, SEEK_SET);
+	free(i->rbuf);
+	i->rbuf = i->rpos = i->rend = NULL;
+	free(i->zbuf);
+	i->zbuf = i->zpos = i->zend = NULL;
 	region_free(&fiber()->gc);
 }
 
+/**
+ * Return the next row of the current block of a compressed
+ * log.
+ *
+ * @retval -1 error
+ * @retval 0 success
+ */
+static int
+xlog_cursor_next_in_block(struct xlog_cursor *i, struct xrow_header *row)
+{
+	const char *data = i->zpos;
+	log_magic_t magic;
+	size_t size;
+	if (i->zend - data < (ssize_t) sizeof(magic)) {
+invalid:
+		xlog_cursor_error(i, i->good_offset, "invalid row in block");
+		return -1;
+	}
+	memcpy(&magic, data, sizeof(magic));
+	if (magic != row_marker)
+		goto invalid;
+	int rc = xlog_cursor_decode_row(i, &data, i->zend, i->good_offset,
+					&size, row);
+	if (rc > 0) {
+		xlog_cursor_error(i, i->good_offset, "truncated row in block");
+		return -1;
+	}
+	if (rc == 0)
+		i->zpos = (char *) data;
+	return rc;
+}
+
 /**
  * Read logfile contents using designated format, panic if
  * the log is corrupted/unreadable.
@@ -539,13 +1096,15 @@ int
 xlog_cursor_next(struct xlog_cursor *i, struct xrow_header *row)
 {
 	struct xlog *l = i->log;
+	log_magic_t marker = l->is_compressed ? block_marker : row_marker;
 	log_magic_t magic;
-	off_t marker_offset = 0;
+	off_t marker_offset;
+	int rc;
 
 	assert(i->eof_read == false);
 
 	say_debug("xlog_cursor_next: marker:0x%016X/%zu",
-		  row_marker, sizeof(row_marker));
+		  marker, sizeof(marker));
 
 	/*
 	 * Don't let gc pool grow too much. Yet to
@@ -555,22 +1114,54 @@ xlog_cursor_next(struct xlog_cursor *i, struct xrow_header *row)
 	region_free_after(&fiber()->gc, 128 * 1024);
 
 restart:
-	if (marker_offset > 0)
-		fseeko(l->f, marker_offset + 1, SEEK_SET);
-
-	if (fread(&magic, sizeof(magic), 1, l->f) != 1)
-		goto eof;
+	if (i->zpos < i->zend) {
+		/* Rows of the current block go first. */
+		try {
+			rc = xlog_cursor_next_in_block(i, row);
+		} catch (ClientError *e) {
+			if (l->dir->panic_if_error)
+				throw;
+			rc = -1;
+		}
+		if (rc != 0) {
+			if (l->dir->panic_if_error)
+				return -1;
+			say_warn("failed to read row");
+			/* Skip the rest of the block. */
+			i->zpos = i->zend;
+			i->good_offset = i->block_end;
+			goto restart;
+		}
+		if (i->zpos == i->zend)
+			i->good_offset = i->block_end;
+		goto done;
+	}
 
-	while (magic != row_marker) {
-		int c = fgetc(l->f);
-		if (c == EOF) {
+	for (;;) {
+		rc = xlog_cursor_ensure(i, sizeof(magic));
+		if (rc < 0)
+			return -1;
+		if (rc > 0) {
 			say_debug("eof while looking for magic");
 			goto eof;
 		}
-		magic = magic >> 8 |
-			((log_magic_t) c & 0xff) << (sizeof(magic)*8 - 8);
+		memcpy(&magic, i->rpos, sizeof(magic));
+		if (magic == marker)
+			break;
+		if (magic == 0 && xlog_cursor_pos(i) == i->good_offset) {
+			/*
+			 * Zeros right after the last row: may be
+			 * the preallocated tail of a log.
+			 */
+			rc = xlog_cursor_at_zero_tail(i);
+			if (rc < 0)
+				return -1;
+			if (rc > 0)
+				goto eof;
+		}
+		i->rpos++;
 	}
-	marker_offset = ftello(l->f) - sizeof(row_marker);
+	marker_offset = xlog_cursor_pos(i);
 	if (i->good_offset != marker_offset)
 		say_warn("skipped %jd bytes after 0x%08jx offset",
 			(intmax_t)(marker_offset - i->good_offset),
@@ -578,7 +1169,11 @@ restart:
 	say_debug("magic found at 0x%08jx", (uintmax_t)marker_offset);
 
 	try {
-		if (row_reader(l->f, row) != 0)
+		if (l->is_compressed)
+			rc = xlog_cursor_read_block(i);
+		else
+			rc = xlog_cursor_read_row(i, row);
+		if (rc != 0)
 			goto eof;
 	} catch (ClientError *e) {
 		if (l->dir->panic_if_error)
@@ -591,23 +1186,31 @@ restart:
 		 * written WAL.
 		 */
 		say_warn("failed to read row");
+		/* Look for the next marker past this one. */
+		i->rpos++;
 		goto restart;
 	}
 
-	i->good_offset = ftello(l->f);
+	if (l->is_compressed) {
+		/*
+		 * Until the block is fully read, the last good
+		 * position is its start.
+		 */
+		i->good_offset = i->zpos < i->zend ?
+				 marker_offset : i->block_end;
+		goto restart;
+	}
+	i->good_offset = xlog_cursor_pos(i);
+done:
 	i->row_count++;
 
-	if (i->row_count % 100000 == 0)
+	if (i->row_count % XLOG_STAT_ROWS == 0)
 		say_info("%.1fM rows processed", i->row_count / 1000000.);
 
 	return 0;
 eof:
 	/*
-	 * According to POSIX, if a partial element is read, value
-	 * of the file position indicator for the stream is
-	 * unspecified.
-	 *
-	 * Thus don't trust the current file position, seek to the
+	 * Don't trust the current read position, rewind to the
 	 * last good position first.
 	 *
 	 * The only case of a fully read file is when eof_marker
@@ -615,12 +1218,16 @@ eof:
 	 * eof_marker is missing, the caller must make the
 	 * decision whether to switch to the next file or not.
 	 */
-	fseeko(l->f, i->good_offset, SEEK_SET);
-	if (fread(&magic, sizeof(magic), 1, l->f) == 1) {
+	i->rpos = i->rend = i->rbuf;
+	i->read_offset = i->good_offset;
+	rc = xlog_cursor_ensure(i, sizeof(magic));
+	if (rc == 0) {
+		memcpy(&magic, i->rpos, sizeof(magic));
 		if (magic == eof_marker) {
-			i->good_offset = ftello(l->f);
+			i->rpos += sizeof(magic);
+			i->good_offset = xlog_cursor_pos(i);
 			i->eof_read = true;
-		} else if (magic == row_marker) {
+		} else if (magic == marker) {
 			/*
 			 * Row marker at the end of a file: a sign
 			 * of a corrupt log file in case of
@@ -629,6 +1236,11 @@ eof:
 			 * (i.e. data is being written to the
 			 * file.
 			 */
+		} else if (magic == 0) {
+			/*
+			 * Zeros past the last row: the file is
+			 * preallocated and is being written to.
+			 */
 		} else {
 			say_error("EOF marker is corrupt: %lu",
 				  (unsigned long) magic);
@@ -648,7 +1260,17 @@ xlog_close(struct xlog *l)
 	int r;
 
 	if (l->mode == LOG_WRITE) {
+		if (xlog_flush(l) < 0)
+			error_log(diag_last_error(&fiber()->diag));
 		fwrite(&eof_marker, 1, sizeof(log_magic_t), l->f);
+		if (l->is_preallocated) {
+			/* Cut off the preallocated tail. */
+			int fd = fileno(l->f);
+			off_t size = fio_lseek(fd, 0, SEEK_CUR);
+			if (size < 0 || ftruncate(fd, size) != 0)
+				say_syserror("%s: failed to truncate",
+					     l->filename);
+		}
 		/*
 		 * Sync the file before closing, since
 		 * otherwise we can end up with a partially
@@ -662,6 +1284,8 @@ xlog_close(struct xlog *l)
 	r = fclose(l->f);
 	if (r < 0)
 		say_syserror("%s: close() failed", l->filename);
+	free(l->wbuf);
+	free(l->zbuf);
 	free(l);
 	return r;
 }
@@ -723,7 +1347,8 @@ static int
 xlog_write_meta(struct xlog *l)
 {
 	char *vstr = NULL;
-	if (fprintf(l->f, "%s%s", l->dir->filetype, v12) < 0 ||
+	const char *version = l->is_compressed ? v13 : v12;
+	if (fprintf(l->f, "%s%s", l->dir->filetype, version) < 0 ||
 	    fprintf(l->f, SERVER_UUID_KEY ": %s\n",
 		    tt_uuid_str(l->dir->server_uuid)) < 0 ||
 	    (vstr = vclock_to_string(&l->vclock)) == NULL ||
@@ -761,7 +1386,9 @@ xlog_read_meta(struct xlog *l, int64_t signature)
 		return -1;
 	}
 
-	if (strcmp(v12, version) != 0) {
+	if (strcmp(v13, version) == 0) {
+		l->is_compressed = true;
+	} else if (strcmp(v12, version) != 0) {
 		tnt_error(XlogError, "%s: unsupported file format version",
 			  l->filename);
 		return -1;
@@ -905,12 +1532,14 @@ xlog_rename(struct xlog *l)
  * In case of error, writes a message to the server log
  * and sets errno.
  */
-struct xlog *
-xlog_create(struct xdir *dir, const struct vclock *vclock)
+static struct xlog *
+xlog_create_file(struct xdir *dir, const struct vclock *vclock,
+		 const char *spare)
 {
 	char *filename;
 	FILE *f = NULL;
 	struct xlog *l = NULL;
+	bool is_created = false;
 
 	int64_t signature = vclock_sum(vclock);
 	assert(signature >= 0);
@@ -937,9 +1566,26 @@ xlog_create(struct xdir *dir, const struct vclock *vclock)
 	 * replication.
 	 */
 	filename = format_filename(dir, signature, INPROGRESS);
-	f = fiob_open(filename, dir->open_wflags);
+	if (spare != NULL) {
+		/*
+		 * rename() would silently replace an existing
+		 * file, check it first.
+		 */
+		if (access(filename, F_OK) == 0) {
+			errno = EEXIST;
+			goto error;
+		}
+		if (rename(spare, filename) != 0)
+			goto error;
+		is_created = true;
+		/* Write over the zeros, keeping the space. */
+		f = fiob_open(filename, "r+");
+	} else {
+		f = fiob_open(filename, dir->open_wflags);
+	}
 	if (!f)
 		goto error;
+	is_created = true;
 	say_info("creating `%s'", filename);
 	l = (struct xlog *) calloc(1, sizeof(*l));
 	if (l == NULL)
@@ -949,6 +1595,9 @@ xlog_create(struct xdir *dir, const struct vclock *vclock)
 	l->mode = LOG_WRITE;
 	l->dir = dir;
 	l->is_inprogress = true;
+	l->is_preallocated = spare != NULL;
+	l->compression = dir->compression;
+	l->is_compressed = l->compression != XLOG_COMPRESSION_NONE;
 	/*  Makes no sense, but well. */
 	l->eof_read = false;
 	vclock_copy(&l->vclock, vclock);
@@ -962,14 +1611,27 @@ xlog_create(struct xdir *dir, const struct vclock *vclock)
 error:
 	int save_errno = errno;
 	say_syserror("%s: failed to open", filename);
-	if (f != NULL) {
+	if (f != NULL)
 		fclose(f);
+	if (is_created)
 		unlink(filename); /* try to remove incomplete file */
-	}
 	free(l);
 	errno = save_errno;
 	return NULL;
 }
 
+struct xlog *
+xlog_create(struct xdir *dir, const struct vclock *vclock)
+{
+	return xlog_create_file(dir, vclock, NULL);
+}
+
+struct xlog *
+xlog_create_from_spare(struct xdir *dir, const struct vclock *vclock,
+		       const char *spare)
+{
+	return xlog_create_file(dir, vclock, spare);
+}
+
 /* }}} */
 
@@ -59,6 +59,28 @@ enum xdir_type { SNAP, XLOG };
  */
 enum log_suffix { NONE, INPROGRESS };
 
+/**
+ * Compression of rows in newly created log files. With any
+ * compression but NONE, rows are grouped in blocks of about
+ * XLOG_BLOCK_SIZE bytes, each compressed and checksummed as a
+ * whole (file format version 0.13). Logs of both formats
+ * can be read regardless of this setting.
+ */
+enum xlog_compression {
+	XLOG_COMPRESSION_NONE = 0,
+	XLOG_COMPRESSION_LZ4,
+	XLOG_COMPRESSION_ZSTD,
+	XLOG_COMPRESSION_MAX
+};
+
+/** String constants for the supported compression types. */
+extern const char *xlog_compression_STRS[];
+
+enum {
+	/** Uncompressed size of a block of rows. */
+	XLOG_BLOCK_SIZE = 128 * 1024,
+};
+
 /**
  * A handle for a data directory with write ahead logs or snapshots.
  * Can be used to find the last log in the directory, scan
@@ -109,6 +131,8 @@ struct xdir {
 	const char *filename_ext;
 	/** File create mode in this directory. */
 	mode_t mode;
+	/** Compression of rows in new files. */
+	enum xlog_compression compression;
 	/*
 	 * Index of files present in the directory. Initially
 	 * empty, must be initialized with xdir_scan().
@@ -182,6 +206,25 @@ struct xlog {
 	bool is_inprogress;
 	/** True if eof has been read when reading the log. */
 	bool eof_read;
+	/**
+	 * True if the file was created from a preallocated
+	 * spare file and has a tail of zeros to cut off.
+	 */
+	bool is_preallocated;
+	/**
+	 * True if rows are grouped in compressed blocks
+	 * (format version 0.13).
+	 */
+	bool is_compressed;
+	/** Compression of blocks written to this file. */
+	enum xlog_compression compression;
+	/** Rows not yet written to a block, see xlog_flush(). */
+	char *wbuf;
+	size_t wbuf_size;
+	size_t wbuf_used;
+	/** Buffer for a compressed block. */
+	char *zbuf;
+	size_t zbuf_size;
 	/**
 	 * Text file header: server uuid. We read
 	 * only logs with our own uuid, to avoid situations
@@ -240,6 +283,18 @@ xlog_open_stream(struct xdir *dir, int64_t signature,
 struct xlog *
 xlog_create(struct xdir *dir, const struct vclock *vclock);
 
+/**
+ * Create a new file by renaming a spare file, which may have
+ * its space preallocated, instead of creating one. The spare
+ * file must contain only zeros, the log is written over them
+ * and the rest of the file is cut off on close.
+ *
+ * @return  xlog object or NULL in case of error.
+ */
+struct xlog *
+xlog_create_from_spare(struct xdir *dir, const struct vclock *vclock,
+		       const char *spare);
+
 /**
  * Sync a log file. The exact action is defined
  * by xdir flags.
@@ -274,6 +329,32 @@ struct xlog_cursor
 	int row_count;
 	off_t good_offset;
 	bool eof_read;
+	/**
+	 * Read buffer. The file is read in large blocks and
+	 * rows are decoded right in the buffer, so a row
+	 * returned by xlog_cursor_next() is only valid until
+	 * the next call.
+	 */
+	char *rbuf;
+	size_t rbuf_size;
+	/** Unread data in rbuf. */
+	char *rpos;
+	char *rend;
+	/** File offset corresponding to rend. */
+	off_t read_offset;
+	/**
+	 * Decompressed rows of the current block of a compressed
+	 * log. The block is done when zpos reaches zend.
+	 */
+	char *zbuf;
+	size_t zbuf_size;
+	char *zpos;
+	char *zend;
+	/** File offset of the end of the current block. */
+	off_t block_end;
+	/** Offset and time the cursor was opened at, for stats. */
+	off_t start_offset;
+	double start_time;
 };
 
 void
@@ -302,6 +383,99 @@ format_filename(struct xdir *dir, int64_t signature, enum log_suffix suffix);
 int
 xlog_encode_row(const struct xrow_header *packet, struct iovec *iov);
 
+/**
+ * Write a row to a log opened for writing. Rows of a
+ * compressed log are buffered and written in blocks of
+ * XLOG_BLOCK_SIZE, see xlog_flush().
+ *
+ * @return the number of bytes written to the file, which is 0
+ *         if the row has been buffered, -1 in case of error.
+ */
+ssize_t
+xlog_write_row(struct xlog *l, const struct xrow_header *row);
+
+/**
+ * Append a row to the block being collected in a compressed
+ * log, without writing anything. Allows to cut blocks at
+ * transaction boundaries.
+ *
+ * @return the size of the encoded row, -1 in case of error.
+ */
+ssize_t
+xlog_add_row(struct xlog *l, const struct xrow_header *row);
+
+/**
+ * Compress the rows collected in a compressed log and write
+ * them as a single block. The buffered rows are dropped even
+ * if the write fails. A no-op for a log without compression.
+ *
+ * @return the number of bytes written, -1 in case of error.
+ */
+ssize_t
+xlog_flush(struct xlog *l);
+
+/** Drop the rows collected for the next block. */
+static inline void
+xlog_discard(struct xlog *l)
+{
+	l->wbuf_used = 0;
+}
+
+/**
+ * Rows encoded in memory, to be written to a log in one piece
+ * with xlog_write_batch(). Lets a thread other than the log
+ * writer do the encoding and compression.
+ */
+struct xlog_batch {
+	/** Encoded rows. */
+	char *data;
+	size_t size;
+	size_t used;
+	/** The number of rows in the batch. */
+	int64_t rows;
+	/** The compressed block, see xlog_batch_seal(). */
+	char *zbuf;
+	size_t zbuf_size;
+	size_t zused;
+};
+
+static inline void
+xlog_batch_create(struct xlog_batch *batch)
+{
+	memset(batch, 0, sizeof(*batch));
+}
+
+void
+xlog_batch_destroy(struct xlog_batch *batch);
+
+/**
+ * Encode a row and append it to the batch.
+ *
+ * @return the size of the encoded row, -1 in case of error.
+ */
+ssize_t
+xlog_batch_add_row(struct xlog_batch *batch, const struct xrow_header *row);
+
+/**
+ * Prepare the batch for writing: for a compressed log, pack
+ * the collected rows into a block with the given compression.
+ * No rows can be added to a sealed batch.
+ *
+ * @return 0 on success, -1 in case of error.
+ */
+int
+xlog_batch_seal(struct xlog_batch *batch, enum xlog_compression compression);
+
+/**
+ * Write a batch sealed with the compression of the log.
+ * Rows buffered in the log by xlog_write_row() are flushed
+ * first, so that the order of rows is preserved.
+ *
+ * @return the number of bytes written, -1 in case of error.
+ */
+ssize_t
+xlog_write_batch(struct xlog *l, struct xlog_batch *batch);
+
 /** }}} */
 
 #if defined(__cplusplus)
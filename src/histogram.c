@@ -0,0 +1,111 @@
+/*
+ * Copyright 2010-2016, Tarantool AUTHORS, please see AUTHORS file.
+ *
+ * Redistribution and use in source and binary forms, with or
+ * without modification, are permitted provided that the following
+ * conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above
+ *    copyright notice, this list of conditions and the
+ *    following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials
+ *    provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY <COPYRIGHT HOLDER> ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * <COPYRIGHT HOLDER> OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+#include "histogram.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+struct histogram *
+histogram_new(const int64_t *buckets, size_t n_buckets)
+{
+	assert(n_buckets > 0);
+	struct histogram *hist = (struct histogram *)
+		malloc(sizeof(*hist) + 2 * n_buckets * sizeof(int64_t));
+	if (hist == NULL)
+		return NULL;
+	hist->n_buckets = n_buckets;
+	hist->buckets = (int64_t *) (hist + 1);
+	hist->counts = hist->buckets + n_buckets;
+	memcpy(hist->buckets, buckets, n_buckets * sizeof(*buckets));
+	histogram_reset(hist);
+	return hist;
+}
+
+void
+histogram_delete(struct histogram *hist)
+{
+	free(hist);
+}
+
+void
+histogram_reset(struct histogram *hist)
+{
+	hist->total = 0;
+	hist->max = 0;
+	memset(hist->counts, 0, hist->n_buckets * sizeof(*hist->counts));
+}
+
+void
+histogram_collect(struct histogram *hist, int64_t val)
+{
+	/* Binary search for the first bound >= val. */
+	size_t begin = 0, end = hist->n_buckets;
+	while (begin != end) {
+		size_t mid = begin + (end - begin) / 2;
+		if (hist->buckets[mid] < val)
+			begin = mid + 1;
+		else
+			end = mid;
+	}
+	if (begin < hist->n_buckets)
+		hist->counts[begin]++;
+	if (hist->total == 0 || val > hist->max)
+		hist->max = val;
+	hist->total++;
+}
+
+void
+histogram_add(struct histogram *hist, const struct histogram *src)
+{
+	assert(hist->n_buckets == src->n_buckets);
+	for (size_t i = 0; i < hist->n_buckets; i++) {
+		assert(hist->buckets[i] == src->buckets[i]);
+		hist->counts[i] += src->counts[i];
+	}
+	if (src->total > 0 && (hist->total == 0 || src->max > hist->max))
+		hist->max = src->max;
+	hist->total += src->total;
+}
+
+int64_t
+histogram_percentile(const struct histogram *hist, double pct)
+{
+	if (hist->total == 0)
+		return 0;
+	int64_t count = 0;
+	for (size_t i = 0; i < hist->n_buckets; i++) {
+		count += hist->counts[i];
+		if (count * 100 >= hist->total * pct)
+			return hist->buckets[i];
+	}
+	return hist->max;
+}
@@ -0,0 +1,98 @@
+#ifndef TARANTOOL_HISTOGRAM_H_INCLUDED
+#define TARANTOOL_HISTOGRAM_H_INCLUDED
+/*
+ * Copyright 2010-2016, Tarantool AUTHORS, please see AUTHORS file.
+ *
+ * Redistribution and use in source and binary forms, with or
+ * without modification, are permitted provided that the following
+ * conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above
+ *    copyright notice, this list of conditions and the
+ *    following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials
+ *    provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY <COPYRIGHT HOLDER> ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * <COPYRIGHT HOLDER> OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(__cplusplus)
+extern "C" {
+#endif /* defined(__cplusplus) */
+
+/**
+ * A histogram with fixed bucket bounds. Bucket i counts values
+ * in (buckets[i - 1], buckets[i]], values above the last bound
+ * are only accounted in the total and the maximum.
+ *
+ * Collecting a value takes no locks, so a histogram may be
+ * updated in one thread and read in another, at the cost of
+ * an occasional stale read.
+ */
+struct histogram {
+	/** Number of collected values. */
+	int64_t total;
+	/** The maximal collected value. */
+	int64_t max;
+	/** Number of buckets. */
+	size_t n_buckets;
+	/** Upper bounds of buckets, sorted in ascending order. */
+	int64_t *buckets;
+	/** Number of values in each bucket. */
+	int64_t *counts;
+};
+
+/**
+ * Create a histogram with the given bucket bounds.
+ * Returns NULL on memory allocation error.
+ */
+struct histogram *
+histogram_new(const int64_t *buckets, size_t n_buckets);
+
+void
+histogram_delete(struct histogram *hist);
+
+void
+histogram_collect(struct histogram *hist, int64_t val);
+
+/** Forget all collected values. */
+void
+histogram_reset(struct histogram *hist);
+
+/**
+ * Add the values collected in @a src to @a hist. Both
+ * histograms must have the same bucket bounds.
+ */
+void
+histogram_add(struct histogram *hist, const struct histogram *src);
+
+/**
+ * Return the upper bound of the bucket the given percentile of
+ * collected values falls into, or the maximal collected value
+ * if it is above all buckets.
+ */
+int64_t
+histogram_percentile(const struct histogram *hist, double pct);
+
+#if defined(__cplusplus)
+} /* extern "C" */
+#endif /* defined(__cplusplus) */
+
+#endif /* TARANTOOL_HISTOGRAM_H_INCLUDED */
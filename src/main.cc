@@ -437,6 +437,12 @@ load_cfg()
 	if (background)
 		daemonize();
 
+	/* The logger thread must be started after fork. */
+	if (cfg_geti("logger_async")) {
+		say_logger_async_init(strcmp(cfg_gets("logger_overflow"),
+					     "drop") == 0);
+	}
+
 	/*
 	 * after (optional) daemonising to avoid confusing messages with
 	 * different pids
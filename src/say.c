@@ -41,6 +41,7 @@
 #include <sys/param.h>
 #endif
 #include <syslog.h>
+#include <pthread.h>
 
 #include "fiber.h"
 
@@ -59,6 +60,52 @@ static int logger_nonblock;
 static int log_fd = STDERR_FILENO;
 static char *log_path; /* iff logger_type == SAY_LOGGER_FILE */
 
+enum {
+	/** Size of the buffer of messages not yet written. */
+	SAY_ASYNC_BUF_SIZE = 1024 * 1024,
+	/** Max size of a single write of the logger thread. */
+	SAY_ASYNC_BATCH_SIZE = 64 * 1024,
+};
+
+/** A message header in the buffer of the async logger. */
+struct say_record {
+	/** Message size, including the trailing newline. */
+	uint32_t size;
+	int32_t level;
+};
+
+/**
+ * The async logger: say() puts formatted messages into a ring
+ * buffer and a separate thread writes them to the log in
+ * batches, so that a slow log device doesn't stall the
+ * threads doing the logging. The mutex is held only to copy
+ * a message, never while writing it.
+ */
+static struct say_async {
+	pthread_t thread;
+	pthread_mutex_t mutex;
+	/** Signalled when a message is added. */
+	pthread_cond_t not_empty;
+	/** Signalled when the logger thread takes or writes a batch. */
+	pthread_cond_t not_full;
+	char *buf;
+	/**
+	 * Read and write positions in the ring. They only grow,
+	 * wpos - rpos is the number of bytes in use.
+	 */
+	size_t rpos;
+	size_t wpos;
+	/** True while the logger thread writes a batch. */
+	bool is_writing;
+	/** Drop messages rather than wait when the ring is full. */
+	bool drop_on_full;
+	/** Messages dropped since the last report. */
+	size_t dropped;
+} say_async;
+
+/** Set if messages go through the async logger thread. */
+static bool say_async_is_enabled = false;
+
 static void
 sayf(int level, const char *filename, int line, const char *error,
      const char *format, ...);
@@ -333,6 +380,178 @@ say_logger_init(const char *init_str, int level, int nonblock, int background)
 	booting = false;
 }
 
+/* {{{ Async logger */
+
+static void
+say_ring_write(struct say_async *a, const void *data, size_t size)
+{
+	size_t pos = a->wpos % SAY_ASYNC_BUF_SIZE;
+	size_t n = MIN(size, SAY_ASYNC_BUF_SIZE - pos);
+	memcpy(a->buf + pos, data, n);
+	memcpy(a->buf, (const char *) data + n, size - n);
+	a->wpos += size;
+}
+
+static void
+say_ring_read(struct say_async *a, void *data, size_t size)
+{
+	size_t pos = a->rpos % SAY_ASYNC_BUF_SIZE;
+	size_t n = MIN(size, SAY_ASYNC_BUF_SIZE - pos);
+	memcpy(data, a->buf + pos, n);
+	memcpy((char *) data + n, a->buf, size - n);
+	a->rpos += size;
+}
+
+/** Queue a formatted message for the logger thread. */
+static void
+say_async_push(int level, const char *msg, size_t size)
+{
+	struct say_async *a = &say_async;
+	struct say_record record = { (uint32_t) size, level };
+	size_t total = sizeof(record) + size;
+
+	pthread_mutex_lock(&a->mutex);
+	while (a->wpos - a->rpos + total > SAY_ASYNC_BUF_SIZE) {
+		if (a->drop_on_full) {
+			a->dropped++;
+			pthread_mutex_unlock(&a->mutex);
+			return;
+		}
+		pthread_cond_wait(&a->not_full, &a->mutex);
+	}
+	bool was_empty = a->wpos == a->rpos;
+	say_ring_write(a, &record, sizeof(record));
+	say_ring_write(a, msg, size);
+	pthread_mutex_unlock(&a->mutex);
+	if (was_empty)
+		pthread_cond_signal(&a->not_empty);
+}
+
+/**
+ * Write a batch of records taken from the ring: one by one to
+ * syslog, or compacted into a single write() otherwise.
+ */
+static void
+say_async_write(char *batch, size_t size)
+{
+	char *end = batch + size;
+	char *out = batch;
+	struct say_record record;
+	for (char *pos = batch; pos < end; pos += record.size) {
+		memcpy(&record, pos, sizeof(record));
+		pos += sizeof(record);
+		if (logger_type == SAY_LOGGER_SYSLOG) {
+			/* Replace the newline with a terminating zero */
+			pos[record.size - 1] = '\0';
+			syslog(level_to_syslog_priority(record.level),
+			       "%s", pos);
+		} else {
+			memmove(out, pos, record.size);
+			out += record.size;
+		}
+	}
+	if (out > batch) {
+		ssize_t r = write(log_fd, batch, out - batch);
+		(void) r;
+	}
+}
+
+static void *
+say_async_f(void *arg)
+{
+	(void) arg;
+	struct say_async *a = &say_async;
+	static char batch[SAY_ASYNC_BATCH_SIZE + sizeof(struct say_record) +
+			  PIPE_BUF];
+
+	pthread_mutex_lock(&a->mutex);
+	while (true) {
+		while (a->rpos == a->wpos && a->dropped == 0)
+			pthread_cond_wait(&a->not_empty, &a->mutex);
+
+		/* Take whole records, up to the batch size. */
+		size_t size = 0;
+		while (a->rpos != a->wpos && size < SAY_ASYNC_BATCH_SIZE) {
+			struct say_record record;
+			say_ring_read(a, &record, sizeof(record));
+			memcpy(batch + size, &record, sizeof(record));
+			size += sizeof(record);
+			say_ring_read(a, batch + size, record.size);
+			size += record.size;
+		}
+		size_t dropped = a->dropped;
+		a->dropped = 0;
+		a->is_writing = true;
+		pthread_mutex_unlock(&a->mutex);
+
+		/* There is free space in the ring now. */
+		pthread_cond_broadcast(&a->not_full);
+		say_async_write(batch, size);
+		if (dropped > 0)
+			say_warn("%zu log messages dropped", dropped);
+
+		pthread_mutex_lock(&a->mutex);
+		a->is_writing = false;
+		pthread_cond_broadcast(&a->not_full);
+	}
+	return NULL;
+}
+
+/**
+ * There is no logger thread in a child process,
+ * write to the log directly there.
+ */
+static void
+say_async_atfork_child(void)
+{
+	say_async_is_enabled = false;
+}
+
+void
+say_logger_async_init(bool drop_on_full)
+{
+	struct say_async *a = &say_async;
+	if (say_async_is_enabled)
+		return;
+	a->buf = (char *) malloc(SAY_ASYNC_BUF_SIZE);
+	if (a->buf == NULL) {
+		say_error("can't allocate the log buffer, "
+			  "logging synchronously");
+		return;
+	}
+	a->rpos = a->wpos = 0;
+	a->is_writing = false;
+	a->drop_on_full = drop_on_full;
+	a->dropped = 0;
+	pthread_mutex_init(&a->mutex, NULL);
+	pthread_cond_init(&a->not_empty, NULL);
+	pthread_cond_init(&a->not_full, NULL);
+	if (pthread_create(&a->thread, NULL, say_async_f, NULL) != 0) {
+		say_syserror("can't start the logger thread, "
+			     "logging synchronously");
+		free(a->buf);
+		a->buf = NULL;
+		return;
+	}
+	pthread_atfork(NULL, NULL, say_async_atfork_child);
+	atexit(say_logger_flush);
+	say_async_is_enabled = true;
+}
+
+void
+say_logger_flush(void)
+{
+	struct say_async *a = &say_async;
+	if (!say_async_is_enabled || pthread_equal(pthread_self(), a->thread))
+		return;
+	pthread_mutex_lock(&a->mutex);
+	while (a->rpos != a->wpos || a->is_writing)
+		pthread_cond_wait(&a->not_full, &a->mutex);
+	pthread_mutex_unlock(&a->mutex);
+}
+
+/* }}} */
+
 void
 vsay(int level, const char *filename, int line, const char *error,
      const char *format, va_list ap)
@@ -387,7 +606,18 @@ vsay(int level, const char *filename, int line, const char *error,
 	if (error && p < len - 1)
 		p += snprintf(buf + p, len - p, ": %s", error);
 
-	if (logger_type != SAY_LOGGER_SYSLOG) {
+	if (say_async_is_enabled) {
+		if (p >= len - 1)
+			p = len - 1;
+		*(buf + p) = '\n';
+		/* Skip the leading white space for syslog, see below */
+		if (logger_type != SAY_LOGGER_SYSLOG)
+			say_async_push(level, buf, p + 1);
+		else
+			say_async_push(level, buf + 1, p);
+		if (level == S_FATAL)
+			say_logger_flush();
+	} else if (logger_type != SAY_LOGGER_SYSLOG) {
 		if (p >= len - 1)
 			p = len - 1;
 		*(buf + p) = '\n';
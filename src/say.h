@@ -70,6 +70,20 @@ void say_init(const char *argv0);
 void say_logger_init(const char *init_str,
                      int log_level, int nonblock, int background);
 
+/**
+ * Start a thread writing log messages, so that say() doesn't
+ * wait for a slow log device. Must be called after daemonizing.
+ *
+ * @param drop_on_full  drop messages rather than wait when
+ *                      the log buffer is full
+ */
+void
+say_logger_async_init(bool drop_on_full);
+
+/** Wait until all queued log messages are written. */
+void
+say_logger_flush(void);
+
 void vsay(int level, const char *filename, int line, const char *error,
           const char *format, va_list ap)
           __attribute__ ((format(printf, 5, 0)));
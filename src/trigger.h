@@ -30,6 +30,7 @@
  * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
  * SUCH DAMAGE.
  */
+#include <stdbool.h>
 #include "small/rlist.h"
 
 #if defined(__cplusplus)
@@ -92,15 +93,22 @@ trigger_add(struct rlist *list, struct trigger *trigger)
 	rlist_add_entry(list, trigger, link);
 }
 
-static inline void
+/**
+ * Add a trigger unless there is one with the same function
+ * and data in the list already.
+ *
+ * @retval true the trigger was added
+ */
+static inline bool
 trigger_add_unique(struct rlist *list, struct trigger *trigger)
 {
 	struct trigger *trg;
 	rlist_foreach_entry(trg, list, link) {
 		if (trg->data == trigger->data && trg->run == trigger->run)
-			return;
+			return false;
 	}
 	trigger_add(list, trigger);
+	return true;
 }
 
 static inline void
@@ -158,6 +158,11 @@
 	tt_pthread_error(e__);			\
 })
 
+#define tt_pthread_cond_broadcast(cond)		\
+({	int e__ = pthread_cond_broadcast(cond);	\
+	tt_pthread_error(e__);			\
+})
+
 #define tt_pthread_cond_wait(cond, mutex)	\
 ({	int e__ = pthread_cond_wait(cond, mutex);\
 	tt_pthread_error(e__);			\
@@ -165,7 +170,7 @@
 
 #define tt_pthread_cond_timedwait(cond, mutex, timeout)	\
 ({	int e__ = pthread_cond_timedwait(cond, mutex, timeout);\
-	if (ETIMEDOUT != e__)			\
+	if (e__ != 0 && ETIMEDOUT != e__)	\
 		say_error("%s error %d", __func__, e__);\
 	assert(e__ == 0 || e__ == ETIMEDOUT);	\
 	e__;					\
@@ -181,3 +181,41 @@ for i=1,W do
     ch:get()
 end
 test_run:cmd("setopt delimiter ''");
+
+--
+-- A secondary key of a live space is built in batches, with
+-- yields in between. The changes made meanwhile get into it.
+--
+fiber = require('fiber')
+s = box.schema.space.create('online')
+_ = s:create_index('pk')
+for i = 1, 20000 do s:insert{i, i} end
+test_run:cmd("setopt delimiter ';'")
+done = false
+n = 0
+function worker()
+    local i = 20001
+    while not done do
+        s:replace{i, i}
+        s:delete{i - 20000}
+        s:update({i - 10000}, {{'=', 2, i + 1000000}})
+        i = i + 1
+        n = n + 1
+        fiber.sleep(0)
+    end
+end;
+test_run:cmd("setopt delimiter ''");
+_ = fiber.create(worker)
+n_start = n
+sk = s:create_index('sk', {parts = {2, 'num'}})
+done = true
+n > n_start
+sk:count() == s:count()
+test_run:cmd("setopt delimiter ';'")
+ok = true
+for _, t in s:pairs() do
+    if sk:get{t[2]}[1] ~= t[1] then ok = false end
+end;
+test_run:cmd("setopt delimiter ''");
+ok
+s:drop()
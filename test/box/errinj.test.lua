@@ -151,6 +151,39 @@ tostring(t[1]) .. tostring(t[2]) ..tostring(t[3]) .. tostring(t[4]) .. tostring(
 errinj.set("ERRINJ_TUPLE_FIELD", false)
 tostring(t[1]) .. tostring(t[2]) ..tostring(t[3]) .. tostring(t[4]) .. tostring(t[5]) .. tostring(t[6])
 
+--
+-- A failed online build of a secondary key must not break the
+-- rollback of a concurrent write which is still in the WAL.
+--
+fiber = require('fiber')
+online = box.schema.space.create('online')
+_ = online:create_index('pk')
+for i = 1, 10000 do online:insert{i, i} end
+-- A duplicate in the last batch of the scan.
+online:replace{10000, 1}
+errinj.set("ERRINJ_WAL_WRITE", true)
+test_run:cmd("setopt delimiter ';'")
+done = false;
+n = 0;
+function writer()
+    while not done do
+        pcall(online.replace, online, {1, 1})
+        n = n + 1
+    end
+end;
+test_run:cmd("setopt delimiter ''");
+_ = fiber.create(writer)
+online:create_index('sk', {parts = {2, 'num'}})
+done = true
+n > 0
+errinj.set("ERRINJ_WAL_WRITE", false)
+online:get{1}
+online:count()
+online:replace{10000, 10000}
+sk = online:create_index('sk', {parts = {2, 'num'}})
+sk:count()
+online:drop()
+
 -- Cleanup
 s:drop()
 errinj = nil
@@ -0,0 +1,27 @@
+env = require('test_run')
+test_run = env.new()
+test_run:cmd("create server iproto_threads with script='box/iproto_threads.lua'")
+test_run:cmd("start server iproto_threads")
+test_run:cmd("switch iproto_threads")
+box.cfg.iproto_threads
+#box.stat.net.thread
+box.schema.user.grant('guest', 'read,write,execute', 'universe')
+s = box.schema.space.create('test')
+_ = s:create_index('pk')
+test_run:cmd("switch default")
+net_box = require('net.box')
+test_run:cmd("set variable uri to 'iproto_threads.listen'")
+conns = {}
+for i = 1, 8 do conns[i] = net_box:new(uri) end
+for i = 1, 8 do conns[i].space.test:insert{i} end
+conns[1].space.test:select()
+for i = 1, 8 do conns[i]:close() end
+test_run:cmd("switch iproto_threads")
+-- connections are spread over all threads
+busy = 0
+for _, t in ipairs(box.stat.net.thread) do if t.RECEIVED.total > 0 then busy = busy + 1 end end
+busy
+box.stat.net.RECEIVED.total > 0
+test_run:cmd("switch default")
+test_run:cmd("stop server iproto_threads")
+test_run:cmd("cleanup server iproto_threads")
@@ -405,5 +405,20 @@ c.space.test:upsert({2, 4, 'nothing'}, {{'+', 3, 100500}}) -- wrong operation
 c.space.test:select{}
 box.space.test:drop()
 
+-- large tuples are sent right from the tuple memory
+_ = box.schema.space.create('test')
+_ = box.space.test:create_index('primary', {type = 'TREE', parts = {1,'NUM'}})
+big = string.rep('x', 100000)
+c = net:new(box.cfg.listen)
+#c.space.test:insert{1, big}[2]
+_ = box.space.test:insert{2, 'small'}
+_ = box.space.test:insert{3, big .. 'y'}
+r = c.space.test:select{}
+#r
+#r[1][2], r[2][2], #r[3][2], r[3][2]:sub(-1)
+r[1][2] == big
+c:close()
+box.space.test:drop()
+
 box.schema.user.revoke('guest', 'read,write,execute', 'universe')
 test_run:cmd("clear filter")
@@ -77,6 +77,21 @@ box.schema.user.grant('guest', 'read,write,execute', 'universe')
 a = net.box:new(LISTEN.host, LISTEN.service)
 a:call('dostring', 'return space:get{session.id()}[1] == session.id()')[1][1]
 a:eval('return session.sync() ~= 0')
+-- the number of requests of a session in progress
+a:eval('return session.requests()')
+a:eval('return session.requests(session.id())')
+session.requests()
+session.requests(1234567890)
+-- requests of a connection in flight are counted until complete
+sid = a:eval('return session.id()')
+wait = fiber.channel()
+for i = 1, 3 do fiber.create(function() a:eval('wait:get()') end) end
+while session.requests(sid) < 3 do fiber.sleep(0.001) end
+session.requests(sid)
+for i = 1, 3 do wait:put(true) end
+while session.requests(sid) > 0 do fiber.sleep(0.001) end
+session.requests(sid)
+wait = nil
 a:close()
 
 -- cleanup
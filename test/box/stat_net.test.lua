@@ -20,6 +20,19 @@ box.stat.net.SENT.total > 0
 box.stat.net.RECEIVED.total > 0
 box.stat.net.EVENTS.total > 0
 -- box.stat.net.LOCKS.total > 0
+#box.stat.net.thread
+box.stat.net.thread[1].SENT.total == box.stat.net.SENT.total
+
+-- request latency
+_ = cn.space.tweedledum:insert{1}
+lat = box.stat.latency()
+lat.SELECT.NET.total > 0
+lat.SELECT.TX.total > 0
+lat.SELECT.FLUSH.total > 0
+lat.SELECT.TX.p999 >= lat.SELECT.TX.p50
+lat.INSERT.WAL.total > 0
+box.stat.latency.INSERT.TX.total > 0
+box.stat.latency.PING
 
 space:drop()
 cn:close()
@@ -0,0 +1,23 @@
+s = box.schema.space.create('test')
+-- hints are supported only for NUM, INT and STR first key parts
+_ = s:create_index('primary', {type = 'tree', parts = {1, 'number'}, hint = true})
+_ = s:create_index('primary', {type = 'tree', parts = {1, 'int'}, hint = true})
+_ = s:create_index('sk', {type = 'tree', parts = {2, 'str'}, unique = false, hint = true})
+-- strings sharing the 8-byte hint prefix are compared in full
+data = {{1, 'abcdefgh1'}, {2, 'abcdefgh0'}, {-1, 'abcdefg'}, {-1000000, 'abc'}, {0, ''}, {1000000, 'b'}, {3, 'abcdefgh'}}
+for _, t in ipairs(data) do s:insert(t) end
+s.index.primary:select()
+s.index.primary:select(0, {iterator = 'LT'})
+s.index.primary:get{-1}
+s.index.sk:select()
+s.index.sk:select('abcdefgh', {iterator = 'GT'})
+s.index.sk:select('abcdefgh0')
+s.index.sk:select('abcdefgh', {iterator = 'LE'})
+s:delete{3}
+s:replace{2, 'a'}
+s.index.sk:select()
+-- toggling the option rebuilds the index
+s.index.sk:alter({hint = false})
+s.index.sk:select()
+s.index.sk:select('abcdefgh', {iterator = 'GT'})
+s:drop()
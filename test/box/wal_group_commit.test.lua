@@ -0,0 +1,21 @@
+fiber = require('fiber')
+space = box.schema.space.create('tweedledum')
+index = space:create_index('primary')
+
+box.cfg{wal_group_commit_delay = -1}
+box.cfg{wal_group_commit_delay = 0.01}
+box.cfg.wal_group_commit_delay
+
+-- concurrent transactions are written in one batch
+ch = fiber.channel(10)
+for i = 1, 10 do fiber.create(function() space:insert{i} ch:put(true) end) end
+for i = 1, 10 do ch:get() end
+space:count()
+box.stat.wal.BATCH.max >= 10
+box.stat.wal.BATCH.total > 0
+box.stat.wal().SYNC ~= nil
+
+box.cfg{wal_group_commit_delay = 0}
+space:insert{11}
+space:count()
+space:drop()
@@ -0,0 +1,37 @@
+env = require('test_run')
+test_run = env.new()
+
+box.schema.user.grant('guest', 'replication')
+test_run:cmd("create server replica with rpl_master=default, script='replication/replica.lua'")
+test_run:cmd("start server replica")
+test_run:cmd("switch default")
+test_run:cmd("stop server replica")
+
+-- the replica fetches all these rows at once and applies them
+-- in batches: DDL and engine switches must split the batches
+memtx = box.schema.space.create('memtx')
+_ = memtx:create_index('pk')
+vinyl = box.schema.space.create('vinyl', {engine = 'vinyl'})
+_ = vinyl:create_index('pk')
+for i = 1, 1000 do memtx:insert{i} end
+for i = 1, 100 do memtx:replace{i, 'memtx'} vinyl:replace{i, 'vinyl'} end
+for i = 101, 1000 do vinyl:insert{i} end
+box.space._schema:replace{'batch'}
+for i = 1, 100 do memtx:delete{i} end
+
+test_run:cmd("start server replica")
+test_run:cmd("switch replica")
+fiber = require('fiber')
+while box.space._schema:get{'batch'} == nil or box.space.memtx:count() ~= 900 do fiber.sleep(0.01) end
+box.space.memtx:count()
+box.space.vinyl:count()
+box.space.vinyl:get{1}
+box.space.memtx:get{101}
+
+test_run:cmd("switch default")
+test_run:cmd("stop server replica")
+test_run:cmd("cleanup server replica")
+memtx:drop()
+vinyl:drop()
+box.space._schema:delete{'batch'}
+box.schema.user.revoke('guest', 'replication')
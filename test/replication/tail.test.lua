@@ -0,0 +1,50 @@
+env = require('test_run')
+test_run = env.new()
+
+--
+-- The master keeps a 1KB tail of the WAL in memory. The relay
+-- reads the rows from the ring while it wraps around, and from
+-- xlog files when the rows are evicted or don't fit.
+--
+test_run:cmd("create server tail_master with script='replication/tail_master.lua'")
+test_run:cmd("create server tail_replica with rpl_master=tail_master, script='replication/replica.lua'")
+test_run:cmd("start server tail_master")
+test_run:cmd("switch tail_master")
+box.schema.user.grant('guest', 'replication')
+space = box.schema.space.create('test')
+_ = space:create_index('pk')
+test_run:cmd("switch default")
+test_run:cmd("start server tail_replica")
+
+test_run:cmd("switch tail_master")
+for i = 1, 100 do space:insert{i, string.rep('x', 20)} end
+-- a row bigger than the tail
+_ = space:insert{101, string.rep('x', 2048)}
+for i = 102, 200 do space:insert{i, string.rep('x', 20)} end
+test_run:cmd("switch tail_replica")
+fiber = require('fiber')
+while box.space.test:count() < 200 do fiber.sleep(0.01) end
+box.space.test:count()
+box.space.test:get{101}[2]:len()
+box.space.test:get{200}[1]
+test_run:cmd("switch default")
+test_run:cmd("stop server tail_replica")
+
+-- the rows written while the replica is down are evicted
+test_run:cmd("switch tail_master")
+for i = 201, 400 do space:insert{i, string.rep('x', 20)} end
+test_run:cmd("switch default")
+test_run:cmd("start server tail_replica")
+test_run:cmd("switch tail_master")
+for i = 401, 500 do space:insert{i, string.rep('x', 20)} end
+test_run:cmd("switch tail_replica")
+fiber = require('fiber')
+while box.space.test:count() < 500 do fiber.sleep(0.01) end
+box.space.test:count()
+box.space.test:get{500}[1]
+
+test_run:cmd("switch default")
+test_run:cmd("stop server tail_replica")
+test_run:cmd("cleanup server tail_replica")
+test_run:cmd("stop server tail_master")
+test_run:cmd("cleanup server tail_master")
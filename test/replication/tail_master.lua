@@ -0,0 +1,10 @@
+#!/usr/bin/env tarantool
+os = require('os')
+box.cfg({
+    listen              = os.getenv("LISTEN"),
+    slab_alloc_arena    = 0.1,
+    -- a tiny in-memory WAL tail, overwritten many times
+    wal_tail_size       = 1024,
+})
+
+require('console').listen(os.getenv('ADMIN'))
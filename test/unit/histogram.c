@@ -0,0 +1,46 @@
+#include "histogram.h"
+#include <stdio.h>
+#include "unit.h"
+
+#define PLAN		14
+
+int
+main(void)
+{
+	plan(PLAN);
+
+	int64_t buckets[] = {1, 2, 5, 10, 100};
+	size_t n_buckets = sizeof(buckets) / sizeof(*buckets);
+	struct histogram *hist = histogram_new(buckets, n_buckets);
+	ok(hist != NULL, "histogram_new");
+	is(histogram_percentile(hist, 50), 0, "empty histogram");
+
+	/* 1..100: 1 in <= 1, 1 in (1, 2], 3 in (2, 5] and so on. */
+	for (int64_t val = 1; val <= 100; val++)
+		histogram_collect(hist, val);
+	is(hist->total, 100, "total");
+	is(hist->max, 100, "max");
+	is(histogram_percentile(hist, 1), 1, "1st percentile");
+	is(histogram_percentile(hist, 5), 5, "5th percentile");
+	is(histogram_percentile(hist, 50), 100, "50th percentile");
+
+	histogram_collect(hist, 1000);
+	is(histogram_percentile(hist, 100), 1000,
+	   "percentile above the last bucket");
+	is(histogram_percentile(hist, 99), 100, "99th percentile");
+	is(histogram_percentile(hist, 99.9), 1000, "99.9th percentile");
+
+	struct histogram *other = histogram_new(buckets, n_buckets);
+	histogram_collect(other, 2000);
+	histogram_add(hist, other);
+	histogram_delete(other);
+	is(hist->total, 102, "total after add");
+	is(hist->max, 2000, "max after add");
+
+	histogram_reset(hist);
+	is(hist->total, 0, "total after reset");
+	is(histogram_percentile(hist, 99), 0, "percentile after reset");
+
+	histogram_delete(hist);
+	return check_plan();
+}
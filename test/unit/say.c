@@ -1,4 +1,7 @@
 #include <string.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <limits.h>
 #include "unit.h"
 #include "say.h"
 
@@ -42,12 +45,40 @@ parse_syslog_opts(const char *input)
 	return 0;
 }
 
+/** Write messages through the logger thread and count them. */
+static int
+test_async(int count)
+{
+	char path[] = "/tmp/say.test.XXXXXX";
+	int fd = mkstemp(path);
+	if (fd < 0)
+		return -1;
+	close(fd);
+	say_logger_init(path, S_INFO, 0, 0);
+	say_logger_async_init(false);
+	for (int i = 0; i < count; i++)
+		say_info("async message %d", i);
+	say_logger_flush();
+
+	FILE *f = fopen(path, "r");
+	char line[PIPE_BUF];
+	int lines = 0;
+	while (f != NULL && fgets(line, sizeof(line), f) != NULL) {
+		if (strstr(line, "async message") != NULL)
+			lines++;
+	}
+	if (f != NULL)
+		fclose(f);
+	unlink(path);
+	return lines;
+}
+
 int main()
 {
 	say_init("");
 	say_logger_init("/dev/null", S_INFO, 0, 0);
 
-	plan(20);
+	plan(21);
 
 #define PARSE_LOGGER_TYPE(input, rc) \
 	ok(parse_logger_type(input) == rc, "%s", input)
@@ -77,5 +108,7 @@ int main()
 	PARSE_SYSLOG_OPTS("facility=local1,facility=local2", -1);
 	PARSE_SYSLOG_OPTS("identity=foo,identity=bar", -1);
 
+	ok(test_async(100000) == 100000, "async logger");
+
 	return check_plan();
 }
@@ -0,0 +1,25 @@
+ffi = require('ffi')
+
+--
+-- A key of a NUMBER part passes the bloom filter of a run
+-- whatever MsgPack encoding of the number is used.
+--
+space = box.schema.space.create('test', { engine = 'vinyl' })
+_ = space:create_index('primary', { parts = {1, 'number'} })
+space:replace{1}
+space:replace{ffi.cast('double', 2)}
+space:replace{3.5}
+-- dump the keys to a run
+box.snapshot()
+
+function bloom_skip() return box.info.vinyl().performance.bloom_skip end
+skip = bloom_skip()
+space:get{ffi.cast('double', 1)}
+space:get{2}
+space:get{ffi.cast('float', 3.5)}
+bloom_skip() - skip
+-- a missing key is skipped
+space:get{4}
+bloom_skip() - skip
+
+space:drop()
@@ -153,3 +153,67 @@ s:select()
 s:upsert({1, 'test', 'failed'}, {{'=', 3, 33}, {'=', 4, nil}})
 s:select()
 s:drop()
+
+--
+-- A cursor continues its scan correctly when the range it
+-- reads is modified or dumped between iterations
+--
+s = box.schema.space.create('test', {engine = 'vinyl'})
+_ = s:create_index('pk')
+for i = 1, 100 do s:replace({i}) end
+test_run:cmd("setopt delimiter ';'")
+keys = {};
+for k, v in s:pairs({}, {iterator = 'GE'}) do
+    table.insert(keys, v[1])
+    if v[1] % 10 == 0 then
+        s:replace({v[1] - 1, 'updated'})
+        s:delete({v[1] - 5})
+    end
+    if v[1] == 50 then box.snapshot() end
+end;
+good = #keys == 100;
+for i = 1, 100 do if keys[i] ~= i then good = false end end;
+keys = {};
+for k, v in s:pairs({}, {iterator = 'LE'}) do
+    table.insert(keys, v[1])
+    if v[1] % 10 == 1 then s:replace({v[1] + 1, 'updated'}) end
+end;
+expected = s:select({}, {iterator = 'LE'});
+if #keys ~= #expected then good = false end;
+for i = 1, #expected do
+    if keys[i] ~= expected[i][1] then good = false end
+end;
+test_run:cmd("setopt delimiter ''");
+good
+#keys
+#s:select()
+s:drop()
+
+--
+-- Cursors read tuples from disk in batches
+--
+s = box.schema.space.create('test', {engine = 'vinyl'})
+_ = s:create_index('pk')
+for i = 1, 1000 do s:replace({i, i * 2}) end
+box.snapshot()
+for i = 1, 1000, 7 do s:delete({i}) end
+test_run:cmd("setopt delimiter ';'")
+keys = {};
+for k, v in s:pairs() do table.insert(keys, v[1]) end;
+good = true;
+expected = 0;
+for i = 1, 1000 do
+    if i % 7 ~= 1 then
+        expected = expected + 1
+        if keys[expected] ~= i then good = false end
+    end
+end;
+test_run:cmd("setopt delimiter ''");
+good
+#keys == expected
+-- a cursor closed with tuples left in its batch
+n = 0
+for k, v in s:pairs({500}, {iterator = 'GE'}) do n = n + 1 if n == 10 then break end end
+n
+s:get({501})
+s:drop()
@@ -0,0 +1,45 @@
+env = require('test_run')
+test_run = env.new()
+
+test_run:cmd('create server page_cache with script="vinyl/page_cache.lua"')
+test_run:cmd("start server page_cache")
+test_run:cmd('switch page_cache')
+
+space = box.schema.space.create('test', { engine = 'vinyl' })
+index = space:create_index('primary', { page_size = 4096 })
+pad = string.rep('x', 1024)
+for i = 1, 100 do space:replace{i, pad} end
+-- dump the rows to a run of about 25 pages
+box.snapshot()
+box.info.vinyl().cache.limit
+
+test_run:cmd("setopt delimiter ';'")
+function cache_diff(old)
+    local new = box.info.vinyl().cache
+    return new.hit - old.hit, new.miss - old.miss, new.evict - old.evict
+end;
+test_run:cmd("setopt delimiter ''");
+
+--
+-- A page read from disk is cached and found on the next read.
+--
+cache = box.info.vinyl().cache
+space:get{1}[1]
+cache_diff(cache)
+cache = box.info.vinyl().cache
+space:get{1}[1]
+cache_diff(cache)
+
+--
+-- Reading more pages than fit the cache evicts the least
+-- recently used ones.
+--
+cache = box.info.vinyl().cache
+for i = 1, 100 do space:get{i} end
+select(3, cache_diff(cache)) > 0
+box.info.vinyl().cache.used <= box.info.vinyl().cache.limit
+
+space:drop()
+test_run:cmd('switch default')
+test_run:cmd("stop server page_cache")
+test_run:cmd("cleanup server page_cache")
@@ -0,0 +1,82 @@
+env = require('test_run')
+test_run = env.new()
+
+test_run:cmd('create server throttle with script="vinyl/throttle.lua"')
+test_run:cmd("start server throttle")
+test_run:cmd('switch throttle')
+
+fiber = require('fiber')
+space = box.schema.space.create('test', { engine = 'vinyl' })
+index = space:create_index('primary')
+pad = string.rep('x', 16 * 1024)
+limit = box.info.vinyl().memory.limit
+box.info.vinyl().performance.throttled
+
+--
+-- Fill the quota until writers are delayed: once the dump
+-- rate is known, every write above the watermark sleeps.
+--
+test_run:cmd("setopt delimiter ';'")
+function fill(deadline)
+    local i = 0
+    while box.info.vinyl().performance.throttled == 0 and
+          fiber.time() < deadline do
+        for j = 1, 100 do
+            i = i + 1
+            space:replace{i, pad}
+        end
+    end
+    return box.info.vinyl().performance.throttled > 0
+end;
+test_run:cmd("setopt delimiter ''");
+fill(fiber.time() + 30)
+
+--
+-- Writers many times over the limit wait for memory and are
+-- woken up as dumps free it.
+--
+ch = fiber.channel(10)
+test_run:cmd("setopt delimiter ';'")
+for i = 1, 10 do
+    fiber.create(function()
+        for j = 1, 100 do
+            space:replace{i * 1000 + j, pad}
+        end
+        ch:put(true)
+    end)
+end;
+done = 0;
+for i = 1, 10 do
+    if ch:get(60) then
+        done = done + 1
+    end
+end;
+test_run:cmd("setopt delimiter ''");
+done
+space:get{10100}[1]
+
+-- The memory is released by a checkpoint.
+box.snapshot()
+box.info.vinyl().memory.used < limit
+
+--
+-- A transaction bigger than the limit doesn't wait forever.
+--
+ch = fiber.channel(1)
+test_run:cmd("setopt delimiter ';'")
+_ = fiber.create(function()
+    box.begin()
+    for i = 1, 200 do
+        space:replace{100000 + i, pad}
+    end
+    box.commit()
+    ch:put(true)
+end);
+test_run:cmd("setopt delimiter ''");
+ch:get(60)
+space:get{100200}[1]
+
+space:drop()
+test_run:cmd('switch default')
+test_run:cmd("stop server throttle")
+test_run:cmd("cleanup server throttle")
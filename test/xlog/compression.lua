@@ -0,0 +1,12 @@
+#!/usr/bin/env tarantool
+os = require('os')
+
+box.cfg{
+    listen              = os.getenv("LISTEN"),
+    slab_alloc_arena    = 0.1,
+    pid_file            = "tarantool.pid",
+    snap_compression    = "lz4",
+    wal_compression     = "zstd"
+}
+
+require('console').listen(os.getenv('ADMIN'))
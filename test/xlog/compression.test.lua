@@ -0,0 +1,34 @@
+env = require('test_run')
+test_run = env.new()
+--
+-- Snapshots and xlogs with rows grouped in compressed blocks
+--
+test_run:cmd("create server compression with script='xlog/compression.lua'")
+test_run:cmd("start server compression")
+test_run:cmd("switch compression")
+box.cfg.snap_compression
+box.cfg.wal_compression
+_ = box.schema.space.create('test')
+_ = box.space.test:create_index('pk')
+for i = 1, 1000 do box.space.test:insert{i, string.rep('x', 100)} end
+box.snapshot()
+for i = 1001, 2000 do box.space.test:insert{i, string.rep('y', 100)} end
+fio = require('fio')
+function header(path) local f = fio.open(path) local h = f:read(10) f:close() return h end
+files = fio.glob(fio.pathjoin(box.cfg.snap_dir, '*.snap'))
+header(files[#files]) == 'SNAP\n0.13\n'
+files = fio.glob(fio.pathjoin(box.cfg.wal_dir, '*.xlog'))
+header(files[#files]) == 'XLOG\n0.13\n'
+--
+-- Recover from the compressed snapshot and xlog
+--
+test_run:cmd("switch default")
+test_run:cmd("stop server compression")
+test_run:cmd("start server compression")
+test_run:cmd("switch compression")
+box.space.test:count()
+box.space.test:get{1}[2] == string.rep('x', 100)
+box.space.test:get{2000}[2] == string.rep('y', 100)
+test_run:cmd("switch default")
+test_run:cmd("stop server compression")
+test_run:cmd("cleanup server compression")
@@ -0,0 +1,12 @@
+#!/usr/bin/env tarantool
+os = require('os')
+
+box.cfg{
+    listen              = os.getenv("LISTEN"),
+    slab_alloc_arena    = 0.1,
+    pid_file            = "tarantool.pid",
+    wal_max_size        = 64 * 1024,
+    wal_prealloc        = true
+}
+
+require('console').listen(os.getenv('ADMIN'))
@@ -0,0 +1,27 @@
+env = require('test_run')
+test_run = env.new()
+--
+-- WAL rotation by size, with the next WAL preallocated
+--
+test_run:cmd("create server prealloc with script='xlog/prealloc.lua'")
+test_run:cmd("start server prealloc")
+test_run:cmd("switch prealloc")
+box.cfg.wal_max_size
+box.cfg.wal_prealloc
+fio = require('fio')
+_ = box.schema.space.create('test')
+_ = box.space.test:create_index('pk')
+for i = 1, 2000 do box.space.test:insert{i, string.rep('x', 100)} end
+#fio.glob(fio.pathjoin(box.cfg.wal_dir, '*.xlog')) > 2
+--
+-- Recover from xlogs created from the spare file
+--
+test_run:cmd("switch default")
+test_run:cmd("stop server prealloc")
+test_run:cmd("start server prealloc")
+test_run:cmd("switch prealloc")
+box.space.test:count()
+box.space.test:get{2000}[2] == string.rep('x', 100)
+test_run:cmd("switch default")
+test_run:cmd("stop server prealloc")
+test_run:cmd("cleanup server prealloc")
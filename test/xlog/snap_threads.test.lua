@@ -0,0 +1,18 @@
+env = require('test_run')
+test_run = env.new()
+--
+-- Rows of user spaces are encoded in several threads
+-- when box.cfg.snap_threads > 1
+--
+box.cfg{snap_threads = 0}
+box.cfg{snap_threads = 4}
+box.cfg.snap_threads
+for i = 1, 8 do box.schema.space.create('test' .. i):create_index('pk') end
+for i = 1, 8 do for j = 1, 1000 * i do box.space['test' .. i]:insert{j, string.rep('x', i * 10)} end end
+box.snapshot()
+test_run:cmd('restart server default')
+count = 0
+for i = 1, 8 do count = count + box.space['test' .. i]:count() end
+count
+box.space.test8:get{8000}[2] == string.rep('x', 80)
+for i = 1, 8 do box.space['test' .. i]:drop() end